@@ -0,0 +1,33 @@
+# Create a headless (no GUI) console application.
+TARGET = bipolar-cli
+TEMPLATE = app
+CONFIG += console warn_on
+CONFIG -= app_bundle
+QT += concurrent xml
+QT -= gui
+SOURCES += main.cpp
+
+# QCommandLineParser was added in Qt 5.2.
+lessThan(QT_MAJOR_VERSION,5)|lessThan(QT_MINOR_VERSION,2): error(bipolar-cli requires Qt 5.2 or later)
+
+# Disable automatic ASCII conversions (best practice for internationalization).
+DEFINES += QT_NO_CAST_FROM_ASCII QT_NO_CAST_TO_ASCII
+
+# Define the build user (for TCX).
+win32:DEFINES += $$shell_quote(BUILD_USER=$$(USERNAME))
+else: DEFINES += $$shell_quote(BUILD_USER=$$(USER))
+
+# Neaten the output directories.
+CONFIG(debug,debug|release) DESTDIR = debug
+CONFIG(release,debug|release) DESTDIR = release
+MOC_DIR = $$DESTDIR/tmp
+OBJECTS_DIR = $$DESTDIR/tmp
+RCC_DIR = $$DESTDIR/tmp
+UI_DIR = $$DESTDIR/tmp
+
+# Share the conversion engine (but none of the widgets) with the GUI application.
+INCLUDEPATH += ../src
+include(../src/os/os.pri)
+include(../src/polar/polar.pri)
+include(../src/protobuf/protobuf.pri)
+include(../src/threads/threads.pri)
@@ -0,0 +1,243 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "converterthread.h"
+#include "sessionwatcher.h"
+#include "os/versioninfo.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+
+#include <stdio.h>
+
+// Note, these values match the GUI application's, so that both share the
+// same conversion manifest, and thus skip each other's converted sessions.
+#define APPLICATION_NAME    QLatin1String("Bipolar")
+#define ORGANISATION_NAME   QLatin1String("Paul Colby")
+#define ORGANISATION_DOMAIN QLatin1String("bipolar.colby.id.au")
+
+// Exit codes.
+#define EXIT_OK              0
+#define EXIT_FAILED_SESSIONS 1
+#define EXIT_INVALID_ARGS    2
+
+static void quietMessageHandler(QtMsgType type, const QMessageLogContext &context,
+                                const QString &message)
+{
+    Q_UNUSED(context)
+    if (type != QtDebugMsg) {
+        fprintf(stderr, "%s\n", qPrintable(message));
+    }
+}
+
+static QJsonObject summarise(const ConverterThread &converter)
+{
+    QJsonObject sessions;
+    sessions.insert(QLatin1String("failed"), converter.sessions.failed.load());
+    sessions.insert(QLatin1String("processed"), converter.sessions.processed.load());
+    sessions.insert(QLatin1String("skipped"), converter.sessions.skipped.load());
+    sessions.insert(QLatin1String("total"), converter.sessionBaseNames().size());
+    QJsonObject files;
+    files.insert(QLatin1String("failed"), converter.files.failed.load());
+    files.insert(QLatin1String("written"), converter.files.written.load());
+    QJsonObject summary;
+    summary.insert(QLatin1String("sessions"), sessions);
+    summary.insert(QLatin1String("files"), files);
+    return summary;
+}
+
+/**
+ * @brief Writes a single-line summary of each watch mode conversion to stdout.
+ */
+class SummaryWriter : public QObject {
+    Q_OBJECT
+
+public slots:
+    void conversionFinished(const ConverterThread * converter)
+    {
+        fprintf(stdout, "%s\n", QJsonDocument(summarise(*converter))
+                .toJson(QJsonDocument::Compact).constData());
+        fflush(stdout);
+    }
+};
+
+int main(int argc, char *argv[]) {
+    // Setup the primary Qt application object.
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(APPLICATION_NAME);
+    app.setOrganizationName(ORGANISATION_NAME);
+    app.setOrganizationDomain(ORGANISATION_DOMAIN);
+    VersionInfo versionInfo;
+    if (versionInfo.isValid()) {
+        app.setApplicationVersion(versionInfo.fileVersionString());
+    }
+
+    // Parse the command line.
+    QCommandLineParser parser;
+    parser.setApplicationDescription(app.translate("main",
+        "Convert Polar training sessions to GPX, HRM and/or TCX files."));
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument(QLatin1String("folders"), app.translate("main",
+        "Input folders to search for training sessions."),
+        QLatin1String("folder [folder...]"));
+    const QCommandLineOption outputFolderOption(QStringList()
+        << QLatin1String("o") << QLatin1String("output-folder"), app.translate("main",
+        "Write output files to <folder>, instead of alongside the input files."),
+        QLatin1String("folder"));
+    const QCommandLineOption formatsOption(QStringList()
+        << QLatin1String("f") << QLatin1String("formats"), app.translate("main",
+        "Comma-separated list of output <formats>: gpx, hrm and/or tcx."),
+        QLatin1String("formats"), QLatin1String("gpx,hrm,tcx"));
+    const QCommandLineOption fileNameFormatOption(QStringList()
+        << QLatin1String("n") << QLatin1String("file-name-format"), app.translate("main",
+        "Output file name <format>, eg \"$date $time $sessionName\"."),
+        QLatin1String("format"), QLatin1String("$date $time $sessionName"));
+    const QCommandLineOption threadsOption(QStringList()
+        << QLatin1String("j") << QLatin1String("threads"), app.translate("main",
+        "Convert up to <count> training sessions concurrently."),
+        QLatin1String("count"), QString::number(QThread::idealThreadCount()));
+    const QCommandLineOption noRrFilesOption(QLatin1String("no-hrm-rr-files"),
+        app.translate("main", "Do not write separate HRM files for R-R data."));
+    const QCommandLineOption noLapNamesOption(QLatin1String("no-hrm-lap-names"),
+        app.translate("main", "Do not write the HRM \"LapNames\" extension."));
+    const QCommandLineOption noUtcOnlyOption(QLatin1String("no-tcx-utc-only"),
+        app.translate("main", "Write TCX timestamps in local time, instead of UTC."));
+    const QCommandLineOption watchOption(QStringList()
+        << QLatin1String("w") << QLatin1String("watch"), app.translate("main",
+        "Keep running, converting training sessions as they are added or updated."));
+    const QCommandLineOption debounceOption(QLatin1String("debounce"), app.translate("main",
+        "In watch mode, wait until input folders are unchanged for <msec> milliseconds "
+        "before converting."), QLatin1String("msec"), QLatin1String("5000"));
+    const QCommandLineOption quietOption(QStringList()
+        << QLatin1String("q") << QLatin1String("quiet"), app.translate("main",
+        "Do not log debug messages, such as each file written."));
+    parser.addOption(outputFolderOption);
+    parser.addOption(formatsOption);
+    parser.addOption(fileNameFormatOption);
+    parser.addOption(threadsOption);
+    parser.addOption(noRrFilesOption);
+    parser.addOption(noLapNamesOption);
+    parser.addOption(noUtcOnlyOption);
+    parser.addOption(watchOption);
+    parser.addOption(debounceOption);
+    parser.addOption(quietOption);
+    parser.process(app);
+
+    if (parser.positionalArguments().isEmpty()) {
+        fprintf(stderr, "%s\n", qPrintable(app.translate("main",
+            "At least one input folder is required.")));
+        return EXIT_INVALID_ARGS;
+    }
+
+    bool threadCountOk = false;
+    const int threadCount = parser.value(threadsOption).toInt(&threadCountOk);
+    if ((!threadCountOk) || (threadCount < 1)) {
+        fprintf(stderr, "%s\n", qPrintable(app.translate("main",
+            "Invalid thread count: %1").arg(parser.value(threadsOption))));
+        return EXIT_INVALID_ARGS;
+    }
+
+    bool debounceOk = false;
+    const int debounce = parser.value(debounceOption).toInt(&debounceOk);
+    if ((!debounceOk) || (debounce < 0)) {
+        fprintf(stderr, "%s\n", qPrintable(app.translate("main",
+            "Invalid debounce interval: %1").arg(parser.value(debounceOption))));
+        return EXIT_INVALID_ARGS;
+    }
+
+    QStringList formats = parser.value(formatsOption).toLower().split(
+        QLatin1Char(','), QString::SkipEmptyParts);
+    for (int index = 0; index < formats.size(); ++index) {
+        formats[index] = formats.at(index).trimmed();
+    }
+    foreach (const QString &format, formats) {
+        if ((format != QLatin1String("gpx")) && (format != QLatin1String("hrm")) &&
+            (format != QLatin1String("tcx"))) {
+            fprintf(stderr, "%s\n", qPrintable(app.translate("main",
+                "Unknown output format: %1").arg(format)));
+            return EXIT_INVALID_ARGS;
+        }
+    }
+
+    if (parser.isSet(quietOption)) {
+        qInstallMessageHandler(quietMessageHandler);
+    }
+
+    // Build the conversion options, independent of the GUI's settings.
+    ConversionOptions options;
+    foreach (const QString &folder, parser.positionalArguments()) {
+        options.inputFolders.append(QDir(folder).absolutePath());
+    }
+    if (parser.isSet(outputFolderOption)) {
+        options.outputFolder = QDir(parser.value(outputFolderOption)).absolutePath();
+    }
+    options.outputFileNameFormat = parser.value(fileNameFormatOption);
+    if (formats.contains(QLatin1String("gpx"))) {
+        options.outputFormats |= polar::v2::TrainingSession::GpxOutput;
+    }
+    if (formats.contains(QLatin1String("hrm"))) {
+        options.outputFormats |= polar::v2::TrainingSession::HrmOutput;
+    }
+    if (formats.contains(QLatin1String("tcx"))) {
+        options.outputFormats |= polar::v2::TrainingSession::TcxOutput;
+    }
+    if (parser.isSet(noRrFilesOption)) {
+        options.hrmOptions &= ~polar::v2::TrainingSession::RrFiles;
+    }
+    if (parser.isSet(noLapNamesOption)) {
+        options.hrmOptions &= ~polar::v2::TrainingSession::LapNames;
+    }
+    if (parser.isSet(noUtcOnlyOption)) {
+        options.tcxOptions &= ~polar::v2::TrainingSession::ForceTcxUTC;
+    }
+    options.threadCount = threadCount;
+
+    // In watch mode, convert sessions as they change, until killed.
+    if (parser.isSet(watchOption)) {
+        SessionWatcher watcher(options);
+        SummaryWriter summaryWriter;
+        QObject::connect(&watcher, SIGNAL(conversionFinished(const ConverterThread*)),
+                         &summaryWriter, SLOT(conversionFinished(const ConverterThread*)));
+        watcher.setDebounceInterval(debounce);
+        if (!watcher.start()) {
+            return EXIT_INVALID_ARGS;
+        }
+        return app.exec();
+    }
+
+    // Run the conversion to completion.
+    ConverterThread converter(options);
+    QObject::connect(&converter, SIGNAL(finished()), &app, SLOT(quit()));
+    converter.start();
+    app.exec();
+    converter.wait();
+
+    // Write a machine-readable summary to stdout.
+    fprintf(stdout, "%s", QJsonDocument(summarise(converter)).toJson().constData());
+
+    return ((converter.sessions.failed.load() == 0) &&
+            (converter.files.failed.load() == 0)) ? EXIT_OK : EXIT_FAILED_SESSIONS;
+}
+
+#include "main.moc"
@@ -0,0 +1,155 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "exercisedata.h"
+
+#include <QDebug>
+
+#include <cfloat>
+
+namespace polar {
+namespace v2 {
+
+namespace {
+
+/**
+ * @brief Resolve a list of sensor "offline" ranges to a per-sample bitmap.
+ *
+ * @param list "*-offline" entries, as parsed from a samples file.
+ * @param size Number of samples the resulting mask should cover.
+ *
+ * @return A bitmap with a bit set for every sample index the sensor was
+ *         offline for.
+ */
+QBitArray offlineMask(const QVariantList &list, const int size)
+{
+    QBitArray mask(size);
+    foreach (const QVariant &entry, list) {
+        const QVariantMap map = entry.toMap();
+        const QVariant startIndex = map.value(QLatin1String("start-index")).toList().value(0);
+        const QVariant endIndex = map.value(QLatin1String("stop-index")).toList().value(0);
+        if ((!startIndex.canConvert(QMetaType::Int)) ||
+            (!endIndex.canConvert(QMetaType::Int))) {
+            qWarning() << "Ignoring invalid 'offline' entry" << entry;
+            continue;
+        }
+        const int begin = qMax(startIndex.toInt(), 0);
+        const int end = qMin(endIndex.toInt(), size - 1);
+        if (begin <= end) {
+            mask.fill(true, begin, end + 1);
+        }
+    }
+    return mask;
+}
+
+// Floating point samples are formatted to their types' decimal precisions, as
+// the HRM, GPX and TCX outputs always have been.
+QString formatSample(const double value)  { return QString::number(value, 'g', DBL_DIG); }
+QString formatSample(const float value)   { return QString::number(value, 'g', FLT_DIG); }
+QString formatSample(const qint32 value)  { return QString::number(value); }
+QString formatSample(const quint32 value) { return QString::number(value); }
+
+}
+
+template<typename Type>
+SampleChannel<Type>::SampleChannel()
+{
+
+}
+
+template<typename Type>
+SampleChannel<Type>::SampleChannel(const QVector<Type> &samples,
+                                   const QVariantList &offlineList)
+    : values(samples), offline(offlineMask(offlineList, samples.size()))
+{
+
+}
+
+/**
+ * @brief Build a channel from a list of parsed QVariants.
+ *
+ * This is a convenience for tests and debugging; TrainingSession builds its
+ * channels from typed arrays instead.
+ */
+template<typename Type>
+SampleChannel<Type>::SampleChannel(const QVariantList &list,
+                                   const QVariantList &offlineList)
+    : values(list.size()), offline(offlineMask(offlineList, list.size()))
+{
+    Type * value = values.data();
+    foreach (const QVariant &variant, list) {
+        *value++ = variant.value<Type>();
+    }
+}
+
+template<typename Type>
+QString SampleChannel<Type>::toString(const int index) const
+{
+    return formatSample(values.at(index));
+}
+
+template class SampleChannel<double>;
+template class SampleChannel<float>;
+template class SampleChannel<qint32>;
+template class SampleChannel<quint32>;
+
+ExerciseData::ExerciseData()
+{
+
+}
+
+/**
+ * @brief Build exercise data from a generic (QVariant) parse of its files.
+ *
+ * This is a convenience for tests and debugging; TrainingSession parses
+ * per-sample files directly into ExerciseData instead.
+ *
+ * @param exercise Map of parsed files, keyed by file type (eg "samples").
+ */
+ExerciseData::ExerciseData(const QVariantMap &exercise)
+{
+    const QVariantMap routeMap = exercise.value(QLatin1String("route")).toMap();
+    route.duration   = routeMap.value(QLatin1String("duration")).toList();
+    route.latitude   = routeMap.value(QLatin1String("latitude")).toList();
+    route.longitude  = routeMap.value(QLatin1String("longitude")).toList();
+    route.altitude   = routeMap.value(QLatin1String("altitude")).toList();
+    route.satellites = routeMap.value(QLatin1String("satellites")).toList();
+
+    const QVariantMap samplesMap = exercise.value(QLatin1String("samples")).toMap();
+    #define LOAD_SAMPLES(Type, name, member) \
+        samples.member = SampleChannel<Type>( \
+            samplesMap.value(QLatin1String(name)).toList(), \
+            samplesMap.value(QLatin1String(name "-offline")).toList())
+    LOAD_SAMPLES(float,   "altitude",    altitude);
+    LOAD_SAMPLES(quint32, "cadence",     cadence);
+    LOAD_SAMPLES(float,   "distance",    distance);
+    LOAD_SAMPLES(quint32, "heartrate",   heartrate);
+    LOAD_SAMPLES(float,   "speed",       speed);
+    LOAD_SAMPLES(float,   "temperature", temperature);
+    #undef LOAD_SAMPLES
+
+    const QVariantList rrList = exercise.value(QLatin1String("rrsamples")).toMap()
+        .value(QLatin1String("value")).toList();
+    rrSamples.reserve(rrList.size());
+    foreach (const QVariant &sample, rrList) {
+        rrSamples.append(sample.toUInt());
+    }
+}
+
+}}
@@ -0,0 +1,118 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __POLAR_V2_EXERCISE_DATA_H__
+#define __POLAR_V2_EXERCISE_DATA_H__
+
+#include <QBitArray>
+#include <QVariant>
+#include <QVector>
+
+namespace polar {
+namespace v2 {
+
+/**
+ * @brief A single channel of exercise samples, held as a contiguous column.
+ *
+ * Each channel also carries a bitmap of the sample indexes for which its
+ * sensor was offline, so both value and presence checks are constant time.
+ */
+template<typename Type>
+class SampleChannel {
+
+public:
+    SampleChannel();
+    SampleChannel(const QVector<Type> &samples,
+                  const QVariantList &offlineList = QVariantList());
+    SampleChannel(const QVariantList &list,
+                  const QVariantList &offlineList = QVariantList());
+
+    inline bool isEmpty() const { return values.isEmpty(); }
+    inline int size() const { return values.size(); }
+    inline Type at(const int index) const { return values.at(index); }
+    inline const Type *constData() const { return values.constData(); }
+
+    inline bool isOffline(const int index) const
+    {
+        return ((index < offline.size()) && (offline.testBit(index)));
+    }
+
+    inline bool haveAnyOnline() const
+    {
+        return (offline.count(true) < values.size());
+    }
+
+    QString toString(const int index) const;
+
+protected:
+    QVector<Type> values;
+    QBitArray offline;
+
+};
+
+/**
+ * @brief Typed, columnar store of a single parsed exercise's per-sample data.
+ *
+ * TrainingSession parses per-sample files straight into this, so samples are
+ * never held as QVariants. The per-exercise scalars (start time, laps,
+ * statistics, etc) remain in the parsed QVariantMap, since they are only read
+ * once per exercise.
+ */
+class ExerciseData {
+
+public:
+    ExerciseData();
+    explicit ExerciseData(const QVariantMap &exercise);
+
+    struct Route {
+        SampleChannel<quint32> duration;
+        SampleChannel<double>  latitude;
+        SampleChannel<double>  longitude;
+        SampleChannel<qint32>  altitude;
+        SampleChannel<quint32> satellites;
+
+        inline bool isEmpty() const
+        {
+            return ((duration.isEmpty()) && (latitude.isEmpty()) && (longitude.isEmpty()) &&
+                    (altitude.isEmpty()) && (satellites.isEmpty()));
+        }
+    } route;
+
+    struct Samples {
+        SampleChannel<float>   altitude;
+        SampleChannel<quint32> cadence;
+        SampleChannel<float>   distance;
+        SampleChannel<quint32> heartrate;
+        SampleChannel<float>   speed;
+        SampleChannel<float>   temperature;
+
+        inline bool isEmpty() const
+        {
+            return ((altitude.isEmpty()) && (cadence.isEmpty()) && (distance.isEmpty()) &&
+                    (heartrate.isEmpty()) && (speed.isEmpty()) && (temperature.isEmpty()));
+        }
+    } samples;
+
+    QVector<quint32> rrSamples;
+
+};
+
+}}
+
+#endif // __POLAR_V2_EXERCISE_DATA_H__
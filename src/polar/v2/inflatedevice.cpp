@@ -0,0 +1,260 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "inflatedevice.h"
+
+#include <QDebug>
+
+#include <limits>
+
+namespace polar {
+namespace v2 {
+
+InflateDevice::InflateDevice(QIODevice * const source, QObject * const parent,
+                             const int chunkSize)
+    : QIODevice(parent), source(source), chunkSize(chunkSize), streamEnded(false),
+      inflated(0)
+{
+    Q_CHECK_PTR(source);
+    Q_ASSERT(chunkSize > 0);
+    stream = z_stream();
+}
+
+/**
+ * @brief Construct a device that inflates compressed data already in memory.
+ *
+ * The compressed @a data is inflated in place, so it may be a
+ * QByteArray::fromRawData() wrapper around a memory-mapped file, for example.
+ * The underlying memory must remain valid for the lifetime of this device.
+ */
+InflateDevice::InflateDevice(const QByteArray &data, QObject * const parent)
+    : QIODevice(parent), source(NULL), chunkSize(0), input(data),
+      streamEnded(false), inflated(0)
+{
+    stream = z_stream();
+}
+
+InflateDevice::~InflateDevice()
+{
+    close();
+}
+
+bool InflateDevice::atEnd() const
+{
+    return ((streamEnded) && (QIODevice::atEnd()));
+}
+
+void InflateDevice::close()
+{
+    if (isOpen()) {
+        const int result = inflateEnd(&stream);
+        if (result != Z_OK) {
+            qWarning() << "inflateEnd returned" << result << stream.msg;
+        }
+    }
+    QIODevice::close();
+}
+
+/**
+ * @brief Get the number of bytes inflated since this device was opened.
+ *
+ * This includes any inflated data still buffered by QIODevice, but not yet
+ * read from this device.
+ */
+qint64 InflateDevice::inflatedSize() const
+{
+    return inflated;
+}
+
+bool InflateDevice::isSequential() const
+{
+    return true;
+}
+
+bool InflateDevice::open(OpenMode mode)
+{
+    if ((mode & ReadWrite) != ReadOnly) {
+        qWarning() << "InflateDevice only supports ReadOnly mode";
+        return false;
+    }
+
+    if ((source != NULL) && ((!source->isOpen()) || (!source->isReadable()))) {
+        qWarning() << "InflateDevice source is not open for reading";
+        return false;
+    }
+
+    // Prepare a zlib stream structure, with automatic gzip / zlib detection.
+    stream = z_stream();
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    if (source == NULL) {
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.constData()));
+        stream.avail_in = input.size();
+    } else {
+        input.clear();
+    }
+    streamEnded = false;
+    inflated = 0;
+    const int result = inflateInit2(&stream, 15 + 32);
+    if (result != Z_OK) {
+        qWarning() << "inflateInit2 returned" << result << stream.msg;
+        return false;
+    }
+    return QIODevice::open(mode);
+}
+
+namespace {
+
+qint64 gzipSizeHint(const QByteArray &header, const QByteArray &trailer,
+                    const qint64 compressedSize)
+{
+    // A gzip member is at least a 10 byte header, and an 8 byte trailer.
+    if ((compressedSize < 18) || (!header.startsWith("\x1f\x8b")) ||
+        (trailer.size() != 4)) {
+        return -1;
+    }
+    const uchar * const bytes = reinterpret_cast<const uchar *>(trailer.constData());
+    const quint32 size = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+                         (static_cast<quint32>(bytes[3]) << 24);
+
+    // Deflate cannot compress by more than about 1032:1, so anything larger
+    // than that indicates a corrupt (or otherwise unusable) trailer.
+    return (size <= compressedSize * Q_INT64_C(1032)) ? size : -1;
+}
+
+}
+
+/**
+ * @brief Estimate the size of a gzip stream's data, once uncompressed.
+ *
+ * Gzip streams end with the size of their uncompressed data (modulo 2^32),
+ * so this is exact for single-member streams under 4GB. Multi-member (or
+ * corrupt) streams may give the wrong size, so callers must still cope
+ * with the actual size being larger or smaller than this hint.
+ *
+ * @param data Complete gzip stream.
+ *
+ * @return The uncompressed size, or -1 if it cannot be determined.
+ */
+qint64 InflateDevice::uncompressedSizeHint(const QByteArray &data)
+{
+    return gzipSizeHint(data.left(2), data.right(4), data.size());
+}
+
+/**
+ * @brief Estimate the size of a gzip stream's data, once uncompressed.
+ *
+ * The @a device must be random-access, and positioned at the start of the
+ * gzip stream. The device's position is left unchanged.
+ *
+ * @param device Device containing a complete gzip stream.
+ *
+ * @return The uncompressed size, or -1 if it cannot be determined.
+ *
+ * @see uncompressedSizeHint(const QByteArray &)
+ */
+qint64 InflateDevice::uncompressedSizeHint(QIODevice &device)
+{
+    if (device.isSequential()) {
+        return -1;
+    }
+    const qint64 pos = device.pos();
+    const qint64 compressedSize = device.size() - pos;
+    if (compressedSize < 18) {
+        return -1;
+    }
+    const QByteArray header = device.peek(2);
+    if (!device.seek(device.size() - 4)) {
+        return -1;
+    }
+    const QByteArray trailer = device.read(4);
+    if (!device.seek(pos)) {
+        qWarning() << "Failed to restore device position" << pos;
+        return -1;
+    }
+    return gzipSizeHint(header, trailer, compressedSize);
+}
+
+qint64 InflateDevice::readData(char * data, qint64 maxSize)
+{
+    if (streamEnded) {
+        return -1;
+    }
+
+    stream.next_out = reinterpret_cast<Bytef *>(data);
+    stream.avail_out = static_cast<uInt>(qMin(maxSize,
+        static_cast<qint64>(std::numeric_limits<uInt>::max())));
+    const uInt requested = stream.avail_out;
+
+    while (stream.avail_out > 0) {
+        // Fetch the next chunk of compressed data, if needed.
+        if (stream.avail_in == 0) {
+            if (source != NULL) {
+                input = source->read(chunkSize);
+            }
+            if ((source == NULL) || (input.isEmpty())) {
+                qWarning() << "Compressed data ended before the end of its stream";
+                setErrorString(tr("Truncated compressed data"));
+                break;
+            }
+            stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.constData()));
+            stream.avail_in = input.size();
+        }
+
+        // Inflate as much as we can into the caller's buffer.
+        const int result = inflate(&stream, Z_NO_FLUSH);
+        if (result == Z_STREAM_END) {
+            // Concatenated gzip members form a single stream, so if any input
+            // remains, restart the inflater on the next member.
+            if ((stream.avail_in == 0) && (source != NULL)) {
+                input = source->read(chunkSize);
+                stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.constData()));
+                stream.avail_in = input.size();
+            }
+            if (stream.avail_in == 0) {
+                streamEnded = true;
+                break;
+            }
+            const int resetResult = inflateReset(&stream);
+            if (resetResult != Z_OK) {
+                qWarning() << "inflateReset returned" << resetResult << stream.msg;
+                setErrorString(tr("Failed to reset the inflater"));
+                break;
+            }
+        } else if (result != Z_OK) {
+            qWarning() << "zlib error" << result << stream.msg;
+            setErrorString(QString::fromLatin1(stream.msg ? stream.msg : "zlib error"));
+            break;
+        }
+    }
+
+    const qint64 size = requested - stream.avail_out;
+    inflated += size;
+    return ((size == 0) && (!streamEnded)) ? -1 : size;
+}
+
+qint64 InflateDevice::writeData(const char * data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+}}
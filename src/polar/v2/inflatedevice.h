@@ -0,0 +1,80 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __POLAR_V2_INFLATE_DEVICE_H__
+#define __POLAR_V2_INFLATE_DEVICE_H__
+
+#include <QByteArray>
+#include <QIODevice>
+
+#ifdef Q_OS_WIN
+#include <QtZlib/zlib.h>
+#else
+#include <zlib.h>
+#endif
+
+namespace polar {
+namespace v2 {
+
+/**
+ * @brief A read-only, sequential device that inflates gzip (or zlib) data.
+ *
+ * Compressed data is read from the source device in small chunks (or from
+ * memory, such as a mapped file), and inflated only as the decompressed data
+ * is read from this device, so the compressed data never needs to be copied
+ * into memory in its entirety.
+ *
+ * Multi-member gzip streams (ie concatenated gzip files) are inflated in full;
+ * any data following a member that is not itself a valid member is an error.
+ */
+class InflateDevice : public QIODevice {
+    Q_OBJECT
+
+public:
+    InflateDevice(QIODevice * const source, QObject * const parent = 0,
+                  const int chunkSize = 16384);
+    InflateDevice(const QByteArray &data, QObject * const parent = 0);
+    virtual ~InflateDevice();
+
+    virtual bool atEnd() const;
+    virtual void close();
+    qint64 inflatedSize() const;
+    virtual bool isSequential() const;
+    virtual bool open(OpenMode mode);
+
+    static qint64 uncompressedSizeHint(const QByteArray &data);
+    static qint64 uncompressedSizeHint(QIODevice &device);
+
+protected:
+    virtual qint64 readData(char * data, qint64 maxSize);
+    virtual qint64 writeData(const char * data, qint64 maxSize);
+
+private:
+    QIODevice * const source;
+    const int chunkSize;
+    QByteArray input;
+    z_stream stream;
+    bool streamEnded;
+    qint64 inflated;
+
+};
+
+}}
+
+#endif // __POLAR_V2_INFLATE_DEVICE_H__
@@ -0,0 +1,122 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sessionindex.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QRegExp>
+
+namespace polar {
+namespace v2 {
+
+bool SessionFiles::isEmpty() const
+{
+    return files.isEmpty();
+}
+
+/**
+ * @brief Add a single file to the index.
+ *
+ * @param baseName Base name of the training session the file belongs to.
+ * @param fileInfo The file to add. Exercise files (those named like
+ *                 "<baseName>-exercises-<id>-<type>") are also indexed by
+ *                 their exercise ID and file type.
+ */
+void SessionIndex::addFile(const QString &baseName, const QFileInfo &fileInfo)
+{
+    QHash<QString, SessionFiles>::iterator session = sessions.find(baseName);
+    if (session == sessions.end()) {
+        sessionBaseNames.append(baseName);
+        session = sessions.insert(baseName, SessionFiles());
+    }
+    session->files.append(fileInfo);
+
+    const QStringList nameParts = fileInfo.fileName().split(QLatin1Char('-'));
+    if ((nameParts.size() >= 3) &&
+        (nameParts.at(nameParts.size() - 3) == QLatin1String("exercises"))) {
+        session->exercises[nameParts.at(nameParts.size() - 2)]
+            [nameParts.at(nameParts.size() - 1)] = fileInfo.filePath();
+    }
+}
+
+/**
+ * @brief Add all training session files found in a folder to the index.
+ *
+ * @param folder Folder to list.
+ *
+ * @return The number of files added.
+ */
+int SessionIndex::addFolder(const QString &folder)
+{
+    const QDir dir(folder);
+    if (!dir.exists()) {
+        qWarning() << "Input folder does not exist" << QDir::toNativeSeparators(folder);
+        return 0;
+    }
+
+    int count = 0;
+    QRegExp regex(QLatin1String("(v2-users-[^-]+-training-sessions-[^-]+)-.*"));
+    foreach (const QFileInfo &info, dir.entryInfoList(QDir::Files)) {
+        if (regex.exactMatch(info.fileName())) {
+            addFile(dir.absoluteFilePath(regex.cap(1)), info);
+            ++count;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Get the base names of all indexed sessions, in the order found.
+ */
+const QStringList &SessionIndex::baseNames() const
+{
+    return sessionBaseNames;
+}
+
+bool SessionIndex::contains(const QString &baseName) const
+{
+    return sessions.contains(baseName);
+}
+
+SessionFiles SessionIndex::value(const QString &baseName) const
+{
+    return sessions.value(baseName);
+}
+
+/**
+ * @brief List the files of a single training session.
+ *
+ * This is the fallback for sessions not found via an index, such as those
+ * converted individually, and lists only the session's own files.
+ *
+ * @param baseName Base name of the training session.
+ */
+SessionFiles SessionIndex::listSession(const QString &baseName)
+{
+    const QFileInfo baseInfo(baseName);
+    SessionIndex index;
+    foreach (const QFileInfo &info, baseInfo.dir().entryInfoList(
+             QStringList(baseInfo.fileName() + QLatin1String("-*")), QDir::Files)) {
+        index.addFile(baseName, info);
+    }
+    return index.value(baseName);
+}
+
+}}
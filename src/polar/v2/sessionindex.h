@@ -0,0 +1,73 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __POLAR_V2_SESSION_INDEX_H__
+#define __POLAR_V2_SESSION_INDEX_H__
+
+#include <QFileInfo>
+#include <QHash>
+#include <QMap>
+#include <QStringList>
+
+namespace polar {
+namespace v2 {
+
+/**
+ * @brief The input files of a single training session.
+ */
+struct SessionFiles {
+    /// All of the session's files, in the order found.
+    QFileInfoList files;
+
+    /// Exercise file names, keyed by exercise ID, then by file type (eg
+    /// "create", "samples", etc). Exercises remain ordered by ID, as their
+    /// order determines the order of multi-exercise output.
+    QMap<QString, QMap<QString, QString> > exercises;
+
+    bool isEmpty() const;
+};
+
+/**
+ * @brief Index of training session files, grouped by session and exercise.
+ *
+ * Each input folder is listed just once, with every file grouped into its
+ * session, exercise and file type as it is found, so discovering sessions is
+ * linear in the number of files, regardless of how many sessions there are.
+ */
+class SessionIndex {
+
+public:
+    void addFile(const QString &baseName, const QFileInfo &fileInfo);
+    int addFolder(const QString &folder);
+
+    const QStringList &baseNames() const;
+    bool contains(const QString &baseName) const;
+    SessionFiles value(const QString &baseName) const;
+
+    static SessionFiles listSession(const QString &baseName);
+
+protected:
+    QStringList sessionBaseNames;
+    QHash<QString, SessionFiles> sessions;
+
+};
+
+}}
+
+#endif // __POLAR_V2_SESSION_INDEX_H__
@@ -19,23 +19,27 @@
 
 #include "trainingsession.h"
 
+#include "exercisedata.h"
+#include "inflatedevice.h"
 #include "message.h"
+#include "sessionindex.h"
 #include "types.h"
+#include "zonehistogram.h"
 
 #include "os/versioninfo.h"
 
-#include <QApplication>
+#include <QBuffer>
+#include <QCoreApplication>
 #include <QDebug>
 #include <QDir>
 #include <QDomElement>
+#include <QFileDevice>
 #include <QFileInfo>
 #include <QProcessEnvironment>
+#include <QtConcurrentRun>
+#include <QXmlStreamWriter>
 
-#ifdef Q_OS_WIN
-#include <QtZlib/zlib.h>
-#else
-#include <zlib.h>
-#endif
+#include <limits>
 
 // These constants match those used by Polar's V2 API.
 #define AUTOLAPS   QLatin1String("autolaps")
@@ -51,7 +55,7 @@ namespace polar {
 namespace v2 {
 
 TrainingSession::TrainingSession(const QString &baseName)
-    : baseName(baseName), hrmOptions(LapNames)
+    : baseName(baseName), hasOutputNaming(false), hrmOptions(LapNames)
 {
 
 }
@@ -173,73 +177,323 @@ bool TrainingSession::isValid() const
     return !parsedExercises.isEmpty();
 }
 
+/**
+ * @brief Get the exercise file types to parse, in order.
+ */
+QStringList TrainingSession::exerciseFileTypes()
+{
+    return QStringList()
+        << AUTOLAPS
+        << CREATE
+        << LAPS
+      //<< PHASES
+        << ROUTE
+        << RRSAMPLES
+        << SAMPLES
+      //<< SENSORS
+        << STATISTICS
+        << ZONES;
+}
+
 bool TrainingSession::parse()
 {
+    exerciseData.clear();
     parsedExercises.clear();
+    hasOutputNaming = false; // Name outputs from the parsed session from now on.
 
-    parsedPhysicalInformation = parsePhysicalInformation(
-        baseName + QLatin1String("-physical-information"));
+    const QMap<QString, QMap<QString, QString> > fileNames = getInputFiles().exercises;
 
-    parsedSession = parseCreateSession(baseName + QLatin1String("-create"));
+    const QString physicalInformationFileName = baseName + QLatin1String("-physical-information");
+    const QString sessionFileName = baseName + QLatin1String("-create");
+    const QPair<qint64, QDateTime> sessionFingerprint = fingerprintFile(sessionFileName);
+    const bool reparseSession = !isParsedSessionCurrent(sessionFingerprint);
 
-    QMap<QString, QMap<QString, QString> > fileNames;
-    const QFileInfo fileInfo(this->baseName);
-    foreach (const QFileInfo &entryInfo, fileInfo.dir().entryInfoList(
-             QStringList(fileInfo.fileName() + QLatin1String("-*"))))
-    {
-        const QStringList nameParts = entryInfo.fileName().split(QLatin1Char('-'));
-        if ((nameParts.size() >= 3) && (nameParts.at(nameParts.size() - 3) == QLatin1String("exercises"))) {
-            fileNames[nameParts.at(nameParts.size() - 2)][nameParts.at(nameParts.size() - 1)] = entryInfo.filePath();
+    if (!parseOptions.testFlag(ConcurrentParsing)) {
+        parsedPhysicalInformation = parsePhysicalInformation(physicalInformationFileName);
+        if (reparseSession) {
+            parsedSession = parseCreateSession(sessionFileName);
+            parsedSessionFingerprint = sessionFingerprint;
+        }
+        for (QMap<QString, QMap<QString, QString> >::const_iterator iter = fileNames.constBegin();
+             iter != fileNames.constEnd(); ++iter)
+        {
+            ExerciseData data;
+            parse(iter.key(), iter.value(), data);
         }
+        return isValid();
     }
 
+    // Start parsing every file (of every exercise) on the global thread pool.
+    // Each of an exercise's files parses into a different member of its
+    // ExerciseData, so no locking is needed. Note, all of the data entries are
+    // added up front, since they must not move while being parsed into.
+    const QFuture<QVariantMap> physicalInformation = QtConcurrent::run(this,
+        static_cast<FileParser>(&TrainingSession::parsePhysicalInformation),
+        physicalInformationFileName);
+    QFuture<QVariantMap> session;
+    if (reparseSession) {
+        session = QtConcurrent::run(this, static_cast<FileParser>(
+            &TrainingSession::parseCreateSession), sessionFileName);
+    }
+    QMap<QString, ExerciseData> data;
+    for (QMap<QString, QMap<QString, QString> >::const_iterator iter = fileNames.constBegin();
+         iter != fileNames.constEnd(); ++iter)
+    {
+        data.insert(iter.key(), ExerciseData());
+    }
+    const QStringList types = exerciseFileTypes();
+    QMap<QString, QMap<QString, QFuture<QVariantMap> > > exercises;
     for (QMap<QString, QMap<QString, QString> >::const_iterator iter = fileNames.constBegin();
          iter != fileNames.constEnd(); ++iter)
     {
-        parse(iter.key(), iter.value());
+        ExerciseData * const exercise = &data[iter.key()];
+        foreach (const QString &type, types) {
+            if (iter.value().contains(type)) {
+                exercises[iter.key()][type] = QtConcurrent::run(this,
+                    &TrainingSession::parseExerciseFile, type, iter.value().value(type),
+                    exercise);
+            }
+        }
     }
 
+    // Then join the results, in the same order as the sequential parse.
+    parsedPhysicalInformation = physicalInformation.result();
+    if (reparseSession) {
+        parsedSession = session.result();
+        parsedSessionFingerprint = sessionFingerprint;
+    }
+    for (QMap<QString, QMap<QString, QString> >::const_iterator iter = fileNames.constBegin();
+         iter != fileNames.constEnd(); ++iter)
+    {
+        parse(iter.key(), iter.value(), data[iter.key()], exercises.value(iter.key()));
+    }
     return isValid();
 }
 
-bool TrainingSession::parse(const QString &exerciseId, const QMap<QString, QString> &fileNames)
+/**
+ * @brief Parse (or collect already parsed) exercise files into parsedExercises,
+ *        and their per-sample data into exerciseData.
+ *
+ * @param exerciseId ID of the exercise to parse.
+ * @param fileNames  Exercise file names, keyed by file type.
+ * @param data       Per-sample data to parse into. Files in @a parsing are
+ *                   expected to be parsing into this same data.
+ * @param parsing    Optional files already being parsed (eg concurrently),
+ *                   keyed by file type. Files not included here are parsed
+ *                   directly by this function.
+ */
+bool TrainingSession::parse(const QString &exerciseId, const QMap<QString, QString> &fileNames,
+                            ExerciseData &data, const QMap<QString, QFuture<QVariantMap> > &parsing)
 {
     QVariantMap exercise;
     QVariantList sources;
-    #define PARSE_IF_CONTAINS(str, Func) \
-        if (fileNames.contains(str)) { \
-            const QVariantMap map = parse##Func(fileNames.value(str)); \
-            if (!map.empty()) { \
-                exercise[str] = map; \
-                sources << fileNames.value(str); \
-            } \
+    foreach (const QString &type, exerciseFileTypes()) {
+        if (fileNames.contains(type)) {
+            const QVariantMap map = parsing.contains(type) ? parsing.value(type).result()
+                : parseExerciseFile(type, fileNames.value(type), &data);
+            // Per-sample files may have no fields left besides their samples.
+            const bool haveSamples =
+                ((type == ROUTE)     && (!data.route.isEmpty())) ||
+                ((type == RRSAMPLES) && (!data.rrSamples.isEmpty())) ||
+                ((type == SAMPLES)   && (!data.samples.isEmpty()));
+            if ((!map.empty()) || (haveSamples)) {
+                exercise[type] = map;
+                sources << fileNames.value(type);
+            }
         }
-    PARSE_IF_CONTAINS(AUTOLAPS,   Laps);
-    PARSE_IF_CONTAINS(CREATE,     CreateExercise);
-    PARSE_IF_CONTAINS(LAPS,       Laps);
-  //PARSE_IF_CONTAINS(PHASES,     Phases);
-    PARSE_IF_CONTAINS(ROUTE,      Route);
-    PARSE_IF_CONTAINS(RRSAMPLES,  RRSamples);
-    PARSE_IF_CONTAINS(SAMPLES,    Samples);
-  //PARSE_IF_CONTAINS(SENSORS,    Sensors);
-    PARSE_IF_CONTAINS(STATISTICS, Statistics);
-    PARSE_IF_CONTAINS(ZONES,      Zones);
-    #undef PARSE_IF_CONTAINS
+    }
 
     if (!exercise.empty()) {
         exercise[QLatin1String("sources")] = sources;
         parsedExercises[exerciseId] = exercise;
+        exerciseData[exerciseId] = data;
         return true;
     }
     return false;
 }
 
+/**
+ * @brief Parse a single exercise file.
+ *
+ * Per-sample files (route, rrsamples and samples) are parsed straight into
+ * @a data, so the returned map holds only their remaining fields.
+ *
+ * @param type     Type of exercise file, such as "samples".
+ * @param fileName Name of the file to parse.
+ * @param data     Per-sample data to parse into. Only the member matching
+ *                 @a type is modified.
+ *
+ * @return The parsed (non-sample) fields.
+ */
+QVariantMap TrainingSession::parseExerciseFile(const QString &type, const QString &fileName,
+                                               ExerciseData * const data) const
+{
+    if ((type == AUTOLAPS) || (type == LAPS)) {
+        return parseLaps(fileName);
+    } else if (type == CREATE) {
+        return parseCreateExercise(fileName);
+    } else if (type == STATISTICS) {
+        return parseStatistics(fileName);
+    } else if (type == ZONES) {
+        return parseZones(fileName);
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open" << type << "file" << fileName;
+        return QVariantMap();
+    }
+    if (type == ROUTE) {
+        return parseRoute(file, data->route);
+    } else if (type == RRSAMPLES) {
+        return parseRRSamples(file, data->rrSamples);
+    } else if (type == SAMPLES) {
+        return parseSamples(file, data->samples);
+    }
+    qWarning() << "Unknown exercise file type" << type;
+    return QVariantMap();
+}
+
+namespace {
+
+/**
+ * @brief Parse a protobuf message as it is inflated.
+ *
+ * The parser decodes the inflated data a chunk at a time, so the message is
+ * never held in memory whole (nor re-allocated as it grows).
+ *
+ * The gzip trailer's size hint is compared to the actual inflated size, so
+ * that any growth beyond the hint (eg multi-member streams) is reported.
+ */
+QVariantMap parseInflated(const ProtoBuf::Message &parser, InflateDevice &inflater,
+                          ProtoBuf::Message::PackedFields * const packedFields,
+                          const qint64 sizeHint)
+{
+    if (!inflater.open(QIODevice::ReadOnly|QIODevice::Unbuffered)) {
+        return QVariantMap();
+    }
+    const QVariantMap result = (packedFields == NULL) ? parser.parse(inflater)
+                                                      : parser.parse(inflater, *packedFields);
+    if (!inflater.atEnd()) {
+        qWarning() << "Failed to inflate data:" << inflater.errorString();
+        if (packedFields != NULL) {
+            *packedFields = ProtoBuf::Message::PackedFields(); // Drop partial samples.
+        }
+        return QVariantMap();
+    }
+    if (sizeHint < 0) {
+        qDebug() << "Inflated" << inflater.inflatedSize() << "bytes, without a size hint";
+    } else if (inflater.inflatedSize() == sizeHint) {
+        qDebug() << "Inflated" << inflater.inflatedSize() << "bytes, as hinted";
+    } else {
+        qDebug() << "Inflated" << inflater.inflatedSize() << "bytes, but the size hint was"
+                 << sizeHint << "bytes; grew by" << (inflater.inflatedSize() - sizeHint);
+    }
+    return result;
+}
+
+/**
+ * @brief Parse a gzipped protobuf message, inflating it as it is read.
+ *
+ * @param parser       Parser for the expected message type.
+ * @param data         Device to read the compressed message from.
+ * @param packedFields Optional arrays to decode packed repeated fields into.
+ *
+ * @return The parsed message, or an empty map if the data could not be
+ *         completely inflated.
+ */
+QVariantMap parseInflated(const ProtoBuf::Message &parser, QIODevice &data,
+                          ProtoBuf::Message::PackedFields * const packedFields = NULL)
+{
+    // Inflate local files straight from a memory mapping, if possible.
+    QFileDevice * const file = qobject_cast<QFileDevice *>(&data);
+    const qint64 size = (file == NULL) ? 0 : (file->size() - file->pos());
+    if ((file != NULL) && (!file->isSequential()) &&
+        (size > 0) && (size <= std::numeric_limits<int>::max())) {
+        uchar * const map = file->map(file->pos(), size);
+        if (map != NULL) {
+            const QByteArray mapped = QByteArray::fromRawData(
+                reinterpret_cast<const char *>(map), static_cast<int>(size));
+            QVariantMap result;
+            {
+                InflateDevice inflater(mapped);
+                result = parseInflated(parser, inflater, packedFields,
+                                       InflateDevice::uncompressedSizeHint(mapped));
+            }
+            file->unmap(map);
+            file->seek(file->size());
+            return result;
+        }
+    }
+
+    const qint64 sizeHint = InflateDevice::uncompressedSizeHint(data);
+    InflateDevice inflater(&data);
+    return parseInflated(parser, inflater, packedFields, sizeHint);
+}
+
+void takePackedValues(ProtoBuf::Message::PackedFields &packedFields, const QString &tagPath,
+                      QVector<double> &values)
+{
+    values = packedFields.doubles.take(tagPath);
+}
+
+void takePackedValues(ProtoBuf::Message::PackedFields &packedFields, const QString &tagPath,
+                      QVector<float> &values)
+{
+    values = packedFields.floats.take(tagPath);
+}
+
+void takePackedValues(ProtoBuf::Message::PackedFields &packedFields, const QString &tagPath,
+                      QVector<qint32> &values)
+{
+    values = packedFields.signedIntegers.take(tagPath);
+}
+
+void takePackedValues(ProtoBuf::Message::PackedFields &packedFields, const QString &tagPath,
+                      QVector<quint32> &values)
+{
+    values = packedFields.unsignedIntegers.take(tagPath);
+}
+
+/**
+ * @brief Take a per-sample field's values out of a (packed fields) parse.
+ *
+ * Polar packs all of its per-sample fields, but unpacked encodings are valid
+ * too, and are parsed into @a fields instead. So any such values are appended
+ * (and removed from @a fields) as well.
+ *
+ * @param packedFields Packed arrays, as parsed by ProtoBuf::Message::parse.
+ * @param fields       Unpacked fields, as returned by ProtoBuf::Message::parse.
+ * @param tagPath      Tag path of the per-sample field.
+ * @param name         Name of the per-sample field.
+ *
+ * @return The field's values.
+ */
+template<typename Type>
+QVector<Type> takeSamples(ProtoBuf::Message::PackedFields &packedFields, QVariantMap &fields,
+                          const QString &tagPath, const QString &name)
+{
+    QVector<Type> values;
+    takePackedValues(packedFields, tagPath, values);
+    foreach (const QVariant &value, fields.take(name).toList()) {
+        values.append(value.value<Type>());
+    }
+    return values;
+}
+
+}
+
+// The field info for each file type is compiled into a parser just once, on
+// first use, and then shared (read-only) by all sessions and threads.
+
 #define ADD_FIELD_INFO(tag, name, type) \
     fieldInfo[QLatin1String(tag)] = ProtoBuf::Message::FieldInfo( \
         QLatin1String(name), ProtoBuf::Types::type \
     )
 
-QVariantMap TrainingSession::parseCreateExercise(QIODevice &data) const
+namespace {
+
+ProtoBuf::Message::FieldInfoMap createExerciseFieldInfo()
 {
     ProtoBuf::Message::FieldInfoMap fieldInfo;
     ADD_FIELD_INFO("1",     "start",         EmbeddedMessage);
@@ -313,11 +567,19 @@ QVariantMap TrainingSession::parseCreateExercise(QIODevice &data) const
     ADD_FIELD_INFO("16",       "exercise-counters", EmbeddedMessage);
     ADD_FIELD_INFO("16/1",     "sprint-count",      Uint32);
     ADD_FIELD_INFO("17", "speed-calibration-offset", Float);
-    ProtoBuf::Message parser(fieldInfo);
+    return fieldInfo;
+}
+
+}
+
+Q_GLOBAL_STATIC_WITH_ARGS(ProtoBuf::Message, createExerciseParser, (createExerciseFieldInfo()))
+
+QVariantMap TrainingSession::parseCreateExercise(QIODevice &data) const
+{
+    const ProtoBuf::Message &parser = *createExerciseParser();
 
     if (isGzipped(data)) {
-        QByteArray array = unzip(data.readAll());
-        return parser.parse(array);
+        return parseInflated(parser, data);
     } else {
         return parser.parse(data);
     }
@@ -333,7 +595,9 @@ QVariantMap TrainingSession::parseCreateExercise(const QString &fileName) const
     return parseCreateExercise(file);
 }
 
-QVariantMap TrainingSession::parseCreateSession(QIODevice &data) const
+namespace {
+
+ProtoBuf::Message::FieldInfoMap createSessionFieldInfo()
 {
     ProtoBuf::Message::FieldInfoMap fieldInfo;
     ADD_FIELD_INFO("1",      "start",              EmbeddedMessage);
@@ -410,11 +674,19 @@ QVariantMap TrainingSession::parseCreateSession(QIODevice &data) const
     ADD_FIELD_INFO("20/2/3", "seconds",            Uint32);
     ADD_FIELD_INFO("20/2/4", "milliseconds",       Uint32);
     ADD_FIELD_INFO("20/4",   "offset",             Int32);
-    ProtoBuf::Message parser(fieldInfo);
+    return fieldInfo;
+}
+
+}
+
+Q_GLOBAL_STATIC_WITH_ARGS(ProtoBuf::Message, createSessionParser, (createSessionFieldInfo()))
+
+QVariantMap TrainingSession::parseCreateSession(QIODevice &data) const
+{
+    const ProtoBuf::Message &parser = *createSessionParser();
 
     if (isGzipped(data)) {
-        QByteArray array = unzip(data.readAll());
-        return parser.parse(array);
+        return parseInflated(parser, data);
     } else {
         return parser.parse(data);
     }
@@ -430,7 +702,9 @@ QVariantMap TrainingSession::parseCreateSession(const QString &fileName) const
     return parseCreateSession(file);
 }
 
-QVariantMap TrainingSession::parseLaps(QIODevice &data) const
+namespace {
+
+ProtoBuf::Message::FieldInfoMap lapsFieldInfo()
 {
     ProtoBuf::Message::FieldInfoMap fieldInfo;
     ADD_FIELD_INFO("1",        "laps",             EmbeddedMessage);
@@ -480,11 +754,19 @@ QVariantMap TrainingSession::parseLaps(QIODevice &data) const
     ADD_FIELD_INFO("2/2/2",    "minutes",          Uint32);
     ADD_FIELD_INFO("2/2/3",    "seconds",          Uint32);
     ADD_FIELD_INFO("2/2/4",    "milliseconds",     Uint32);
-    ProtoBuf::Message parser(fieldInfo);
+    return fieldInfo;
+}
+
+}
+
+Q_GLOBAL_STATIC_WITH_ARGS(ProtoBuf::Message, lapsParser, (lapsFieldInfo()))
+
+QVariantMap TrainingSession::parseLaps(QIODevice &data) const
+{
+    const ProtoBuf::Message &parser = *lapsParser();
 
     if (isGzipped(data)) {
-        QByteArray array = unzip(data.readAll());
-        return parser.parse(array);
+        return parseInflated(parser, data);
     } else {
         return parser.parse(data);
     }
@@ -500,7 +782,9 @@ QVariantMap TrainingSession::parseLaps(const QString &fileName) const
     return parseLaps(file);
 }
 
-QVariantMap TrainingSession::parsePhysicalInformation(QIODevice &data) const
+namespace {
+
+ProtoBuf::Message::FieldInfoMap physicalInformationFieldInfo()
 {
     ProtoBuf::Message::FieldInfoMap fieldInfo;
     ADD_FIELD_INFO("1",        "birthday",            EmbeddedMessage);
@@ -653,11 +937,19 @@ QVariantMap TrainingSession::parsePhysicalInformation(QIODevice &data) const
     ADD_FIELD_INFO("100/2/2",  "minute",              Uint32);
     ADD_FIELD_INFO("100/2/3",  "seconds",             Uint32);
     ADD_FIELD_INFO("100/2/4",  "milliseconds",        Uint32);
-    ProtoBuf::Message parser(fieldInfo);
+    return fieldInfo;
+}
+
+}
+
+Q_GLOBAL_STATIC_WITH_ARGS(ProtoBuf::Message, physicalInformationParser, (physicalInformationFieldInfo()))
+
+QVariantMap TrainingSession::parsePhysicalInformation(QIODevice &data) const
+{
+    const ProtoBuf::Message &parser = *physicalInformationParser();
 
     if (isGzipped(data)) {
-        QByteArray array = unzip(data.readAll());
-        return parser.parse(array);
+        return parseInflated(parser, data);
     } else {
         return parser.parse(data);
     }
@@ -673,7 +965,9 @@ QVariantMap TrainingSession::parsePhysicalInformation(const QString &fileName) c
     return parsePhysicalInformation(file);
 }
 
-QVariantMap TrainingSession::parseRoute(QIODevice &data) const
+namespace {
+
+ProtoBuf::Message::FieldInfoMap routeFieldInfo()
 {
     ProtoBuf::Message::FieldInfoMap fieldInfo;
     ADD_FIELD_INFO("1",     "duration",     Uint32);
@@ -691,16 +985,54 @@ QVariantMap TrainingSession::parseRoute(QIODevice &data) const
     ADD_FIELD_INFO("9/2/2", "minute",       Uint32);
     ADD_FIELD_INFO("9/2/3", "seconds",      Uint32);
     ADD_FIELD_INFO("9/2/4", "milliseconds", Uint32);
-    ProtoBuf::Message parser(fieldInfo);
+    return fieldInfo;
+}
+
+}
+
+Q_GLOBAL_STATIC_WITH_ARGS(ProtoBuf::Message, routeParser, (routeFieldInfo()))
+
+/**
+ * @brief Parse a route file generically, including its samples as QVariants.
+ *
+ * This is a convenience for tests and debugging; parse() uses the typed
+ * parseRoute(QIODevice &, ExerciseData::Route &) overload instead.
+ */
+QVariantMap TrainingSession::parseRoute(QIODevice &data) const
+{
+    const ProtoBuf::Message &parser = *routeParser();
 
     if (isGzipped(data)) {
-        QByteArray array = unzip(data.readAll());
-        return parser.parse(array);
+        return parseInflated(parser, data);
     } else {
         return parser.parse(data);
     }
 }
 
+/**
+ * @brief Parse a route file, decoding its samples straight into @a route.
+ *
+ * @return The route's remaining fields, such as its timestamp.
+ */
+QVariantMap TrainingSession::parseRoute(QIODevice &data, ExerciseData::Route &route) const
+{
+    const ProtoBuf::Message &parser = *routeParser();
+
+    ProtoBuf::Message::PackedFields packedFields;
+    QVariantMap fields = (isGzipped(data)) ? parseInflated(parser, data, &packedFields)
+                                           : parser.parse(data, packedFields);
+    #define TAKE_SAMPLES(Type, tag, name, member) \
+        route.member = SampleChannel<Type>(takeSamples<Type>( \
+            packedFields, fields, QLatin1String(tag), QLatin1String(name)))
+    TAKE_SAMPLES(quint32, "1", "duration",   duration);
+    TAKE_SAMPLES(double,  "2", "latitude",   latitude);
+    TAKE_SAMPLES(double,  "3", "longitude",  longitude);
+    TAKE_SAMPLES(qint32,  "4", "altitude",   altitude);
+    TAKE_SAMPLES(quint32, "5", "satellites", satellites);
+    #undef TAKE_SAMPLES
+    return fields;
+}
+
 QVariantMap TrainingSession::parseRoute(const QString &fileName) const
 {
     QFile file(fileName);
@@ -711,20 +1043,53 @@ QVariantMap TrainingSession::parseRoute(const QString &fileName) const
     return parseRoute(file);
 }
 
-QVariantMap TrainingSession::parseRRSamples(QIODevice &data) const
+namespace {
+
+ProtoBuf::Message::FieldInfoMap rrSamplesFieldInfo()
 {
     ProtoBuf::Message::FieldInfoMap fieldInfo;
     ADD_FIELD_INFO("1", "value", Uint32);
-    ProtoBuf::Message parser(fieldInfo);
+    return fieldInfo;
+}
+
+}
+
+Q_GLOBAL_STATIC_WITH_ARGS(ProtoBuf::Message, rrSamplesParser, (rrSamplesFieldInfo()))
+
+/**
+ * @brief Parse an R-R samples file generically, including its samples as QVariants.
+ *
+ * This is a convenience for tests and debugging; parse() uses the typed
+ * parseRRSamples(QIODevice &, QVector<quint32> &) overload instead.
+ */
+QVariantMap TrainingSession::parseRRSamples(QIODevice &data) const
+{
+    const ProtoBuf::Message &parser = *rrSamplesParser();
 
     if (isGzipped(data)) {
-        QByteArray array = unzip(data.readAll());
-        return parser.parse(array);
+        return parseInflated(parser, data);
     } else {
         return parser.parse(data);
     }
 }
 
+/**
+ * @brief Parse an R-R samples file, decoding its samples straight into @a rrSamples.
+ *
+ * @return The file's remaining fields (currently, always none).
+ */
+QVariantMap TrainingSession::parseRRSamples(QIODevice &data, QVector<quint32> &rrSamples) const
+{
+    const ProtoBuf::Message &parser = *rrSamplesParser();
+
+    ProtoBuf::Message::PackedFields packedFields;
+    QVariantMap fields = (isGzipped(data)) ? parseInflated(parser, data, &packedFields)
+                                           : parser.parse(data, packedFields);
+    rrSamples = takeSamples<quint32>(packedFields, fields,
+                                     QLatin1String("1"), QLatin1String("value"));
+    return fields;
+}
+
 QVariantMap TrainingSession::parseRRSamples(const QString &fileName) const
 {
     QFile file(fileName);
@@ -735,7 +1100,9 @@ QVariantMap TrainingSession::parseRRSamples(const QString &fileName) const
     return parseRRSamples(file);
 }
 
-QVariantMap TrainingSession::parseSamples(QIODevice &data) const
+namespace {
+
+ProtoBuf::Message::FieldInfoMap samplesFieldInfo()
 {
     ProtoBuf::Message::FieldInfoMap fieldInfo;
     ADD_FIELD_INFO("1",     "record-interval",          EmbeddedMessage);
@@ -786,16 +1153,60 @@ QVariantMap TrainingSession::parseSamples(QIODevice &data) const
     ADD_FIELD_INFO("20",    "fwd-acceleration-offline", EmbeddedMessage);
     ADD_FIELD_INFO("20/1",  "start-index",              Uint32);
     ADD_FIELD_INFO("20/2",  "stop-index",               Uint32);
-    ProtoBuf::Message parser(fieldInfo);
+    return fieldInfo;
+}
+
+}
+
+Q_GLOBAL_STATIC_WITH_ARGS(ProtoBuf::Message, samplesParser, (samplesFieldInfo()))
+
+/**
+ * @brief Parse a samples file generically, including its samples as QVariants.
+ *
+ * This is a convenience for tests and debugging; parse() uses the typed
+ * parseSamples(QIODevice &, ExerciseData::Samples &) overload instead.
+ */
+QVariantMap TrainingSession::parseSamples(QIODevice &data) const
+{
+    const ProtoBuf::Message &parser = *samplesParser();
 
     if (isGzipped(data)) {
-        QByteArray array = unzip(data.readAll());
-        return parser.parse(array);
+        return parseInflated(parser, data);
     } else {
         return parser.parse(data);
     }
 }
 
+/**
+ * @brief Parse a samples file, decoding its samples straight into @a samples.
+ *
+ * Packed per-sample fields that are not (yet) used, such as stride lengths,
+ * are dropped.
+ *
+ * @return The file's remaining fields, such as its record interval, and the
+ *         sensors' offline ranges.
+ */
+QVariantMap TrainingSession::parseSamples(QIODevice &data, ExerciseData::Samples &samples) const
+{
+    const ProtoBuf::Message &parser = *samplesParser();
+
+    ProtoBuf::Message::PackedFields packedFields;
+    QVariantMap fields = (isGzipped(data)) ? parseInflated(parser, data, &packedFields)
+                                           : parser.parse(data, packedFields);
+    #define TAKE_SAMPLES(Type, tag, name, member) \
+        samples.member = SampleChannel<Type>(takeSamples<Type>( \
+            packedFields, fields, QLatin1String(tag), QLatin1String(name)), \
+            fields.value(QLatin1String(name "-offline")).toList())
+    TAKE_SAMPLES(float,   "6",  "altitude",    altitude);
+    TAKE_SAMPLES(quint32, "4",  "cadence",     cadence);
+    TAKE_SAMPLES(float,   "11", "distance",    distance);
+    TAKE_SAMPLES(quint32, "2",  "heartrate",   heartrate);
+    TAKE_SAMPLES(float,   "9",  "speed",       speed);
+    TAKE_SAMPLES(float,   "8",  "temperature", temperature);
+    #undef TAKE_SAMPLES
+    return fields;
+}
+
 QVariantMap TrainingSession::parseSamples(const QString &fileName) const
 {
     QFile file(fileName);
@@ -806,7 +1217,9 @@ QVariantMap TrainingSession::parseSamples(const QString &fileName) const
     return parseSamples(file);
 }
 
-QVariantMap TrainingSession::parseStatistics(QIODevice &data) const
+namespace {
+
+ProtoBuf::Message::FieldInfoMap statisticsFieldInfo()
 {
     ProtoBuf::Message::FieldInfoMap fieldInfo;
     ADD_FIELD_INFO("1",    "heartrate",      EmbeddedMessage);
@@ -843,11 +1256,19 @@ QVariantMap TrainingSession::parseStatistics(QIODevice &data) const
     ADD_FIELD_INFO("11",   "declince",       EmbeddedMessage);
     ADD_FIELD_INFO("11/1", "average",        Float);
     ADD_FIELD_INFO("11/2", "maximum",        Float);
-    ProtoBuf::Message parser(fieldInfo);
+    return fieldInfo;
+}
+
+}
+
+Q_GLOBAL_STATIC_WITH_ARGS(ProtoBuf::Message, statisticsParser, (statisticsFieldInfo()))
+
+QVariantMap TrainingSession::parseStatistics(QIODevice &data) const
+{
+    const ProtoBuf::Message &parser = *statisticsParser();
 
     if (isGzipped(data)) {
-        QByteArray array = unzip(data.readAll());
-        return parser.parse(array);
+        return parseInflated(parser, data);
     } else {
         return parser.parse(data);
     }
@@ -863,7 +1284,9 @@ QVariantMap TrainingSession::parseStatistics(const QString &fileName) const
     return parseStatistics(file);
 }
 
-QVariantMap TrainingSession::parseZones(QIODevice &data) const
+namespace {
+
+ProtoBuf::Message::FieldInfoMap zonesFieldInfo()
 {
     ProtoBuf::Message::FieldInfoMap fieldInfo;
     ADD_FIELD_INFO("1",     "heartrate",        EmbeddedMessage);
@@ -907,11 +1330,19 @@ QVariantMap TrainingSession::parseZones(QIODevice &data) const
     ADD_FIELD_INFO("4/2.4", "milliseconds",     Uint32);
     ADD_FIELD_INFO("4/3",   "distance",         Float);
     ADD_FIELD_INFO("10",    "heartrate-source", Enumerator);
-    ProtoBuf::Message parser(fieldInfo);
+    return fieldInfo;
+}
+
+}
+
+Q_GLOBAL_STATIC_WITH_ARGS(ProtoBuf::Message, zonesParser, (zonesFieldInfo()))
+
+QVariantMap TrainingSession::parseZones(QIODevice &data) const
+{
+    const ProtoBuf::Message &parser = *zonesParser();
 
     if (isGzipped(data)) {
-        QByteArray array = unzip(data.readAll());
-        return parser.parse(array);
+        return parseInflated(parser, data);
     } else {
         return parser.parse(data);
     }
@@ -927,6 +1358,36 @@ QVariantMap TrainingSession::parseZones(const QString &fileName) const
     return parseZones(file);
 }
 
+/**
+ * @brief Set the session's input files, as already found by the caller.
+ *
+ * This avoids listing the input directory for each session, which matters
+ * when many sessions share the same (potentially large) input directory.
+ *
+ * @param files The session's files, typically from a SessionIndex.
+ */
+void TrainingSession::setInputFiles(const SessionFiles &files)
+{
+    inputFiles = files;
+}
+
+/**
+ * @brief Set the session details to name output files with, as recorded by
+ *        the caller from an earlier getOutputNaming().
+ *
+ * This avoids parsing the create file just to name output files, such as when
+ * checking if a session's outputs already exist. The caller must ensure the
+ * create file is unchanged since the details were recorded. A later parse()
+ * reverts to naming outputs from the parsed create file.
+ *
+ * @param naming Session details to name output files with.
+ */
+void TrainingSession::setOutputNaming(const OutputNaming &naming)
+{
+    outputNaming = naming;
+    hasOutputNaming = true;
+}
+
 void TrainingSession::setGpxOption(const GpxOption option, const bool enabled)
 {
     if (enabled) {
@@ -955,6 +1416,20 @@ void TrainingSession::setHrmOptions(const HrmOptions options)
     hrmOptions = options;
 }
 
+void TrainingSession::setParseOption(const ParseOption option, const bool enabled)
+{
+    if (enabled) {
+        parseOptions |= option;
+    } else {
+        parseOptions &= ~option;
+    }
+}
+
+void TrainingSession::setParseOptions(const ParseOptions options)
+{
+    parseOptions = options;
+}
+
 void TrainingSession::setTcxOption(const TcxOption option, const bool enabled)
 {
     if (enabled) {
@@ -1057,33 +1532,64 @@ QString hrmTime(const QTime &time)
             .arg(qRound(time.msec()/100.0));
 }
 
-bool sensorOffline(const QVariantList &list, const int index)
+/**
+ * @brief Get the session's input files, listing the input directory only if
+ *        they have not already been set via setInputFiles().
+ */
+SessionFiles TrainingSession::getInputFiles() const
 {
-    foreach (const QVariant &entry, list) {
-        const QVariantMap map = entry.toMap();
-        const QVariant startIndex = first(map.value(QLatin1String("start-index")));
-        const QVariant endIndex = first(map.value(QLatin1String("start-index")));
-        if ((!startIndex.canConvert(QMetaType::Int)) ||
-            (!endIndex.canConvert(QMetaType::Int))) {
-            qWarning() << "Ignoring invalid 'offline' entry" << entry;
-            continue;
-        }
-        if ((startIndex.toInt() <= index) && (index <= endIndex.toInt())) {
-            return true; // Sensor was offline.
-        }
-    }
-    return false; // Sensor was not offline.
+    return (inputFiles.isEmpty()) ? SessionIndex::listSession(baseName) : inputFiles;
 }
 
-bool haveAnySamples(const QVariantMap &samples, const QString &type)
+/**
+ * @brief Fingerprint a file by its size and last-modified time.
+ */
+QPair<qint64, QDateTime> TrainingSession::fingerprintFile(const QString &fileName)
 {
-    const int size = samples.value(type).toList().length();
-    for (int index = 0; index < size; ++index) {
-        if (!sensorOffline(samples.value(type + QLatin1String("-offline")).toList(), index)) {
-            return true;
-        }
+    const QFileInfo fileInfo(fileName);
+    return qMakePair(fileInfo.size(), fileInfo.lastModified());
+}
+
+/**
+ * @brief Check if parsedSession may be reused, rather than parsed again.
+ *
+ * The create session file may be parsed early (eg by getOutputBaseFileName)
+ * and reused by parse(), but only while that file's fingerprint is unchanged.
+ *
+ * @param fingerprint The create session file's current fingerprint, as per
+ *                    fingerprintFile().
+ */
+bool TrainingSession::isParsedSessionCurrent(const QPair<qint64, QDateTime> &fingerprint) const
+{
+    return ((!parsedSession.isEmpty()) && (parsedSessionFingerprint == fingerprint));
+}
+
+/**
+ * @brief Get the session details used to name output files.
+ *
+ * These are the details given to setOutputNaming(), if any, otherwise those
+ * of the session's create file, which is parsed (again) only if necessary.
+ *
+ * @see setOutputNaming
+ */
+TrainingSession::OutputNaming TrainingSession::getOutputNaming()
+{
+    if (hasOutputNaming) {
+        return outputNaming;
     }
-    return false;
+
+    const QString sessionFileName = baseName + QLatin1String("-create");
+    const QPair<qint64, QDateTime> sessionFingerprint = fingerprintFile(sessionFileName);
+    if (!isParsedSessionCurrent(sessionFingerprint)) {
+        parsedSession = parseCreateSession(sessionFileName);
+        parsedSessionFingerprint = sessionFingerprint;
+    }
+
+    OutputNaming naming;
+    naming.startTime = getDateTime(firstMap(parsedSession.value(QLatin1String("start"))));
+    naming.sessionName = first(firstMap(parsedSession.value(QLatin1String("session-name")))
+        .value(QLatin1String("text"))).toString();
+    return naming;
 }
 
 QString TrainingSession::getOutputBaseFileName(const QString &format)
@@ -1104,17 +1610,14 @@ QString TrainingSession::getOutputBaseFileName(const QString &format)
 
     QString fileName = format;
 
-    // If any of these placeholders are used, ensure we've parsed the base details.
+    // If any of these placeholders are used, ensure we have the session's details.
+    OutputNaming naming;
     if (format.contains(QLatin1String("$date"       )) ||
         format.contains(QLatin1String("$dateUTC"    )) ||
         format.contains(QLatin1String("$time"       )) ||
         format.contains(QLatin1String("$timeUTC"    )) ||
-        format.contains(QLatin1String("$userId"     )) ||
-        format.contains(QLatin1String("$sessionId"  )) ||
         format.contains(QLatin1String("$sessionName"))) {
-        if (parsedSession.isEmpty()) {
-            parsedSession = parseCreateSession(baseName + QLatin1String("-create"));
-        }
+        naming = getOutputNaming();
     }
 
     fileName.replace(QLatin1String("$baseName"), inputBaseNameInfo.fileName());
@@ -1128,8 +1631,7 @@ QString TrainingSession::getOutputBaseFileName(const QString &format)
         format.contains(QLatin1String("$timeExt"   )) ||
         format.contains(QLatin1String("$timeExtUTC")))
     {
-        const QDateTime startTime =
-            getDateTime(firstMap(parsedSession.value(QLatin1String("start"))));
+        const QDateTime &startTime = naming.startTime;
         fileName.replace(QLatin1String("$dateExtUTC"),
              startTime.toUTC().toString(QLatin1String("yyyy-MM-dd")));
         fileName.replace(QLatin1String("$dateExt"),
@@ -1168,9 +1670,7 @@ QString TrainingSession::getOutputBaseFileName(const QString &format)
         fileName.replace(QLatin1String("$sessionId"), inputFileNameParts.cap(2));
     }
 
-    fileName.replace(QLatin1String("$sessionName"),
-        first(firstMap(parsedSession.value(QLatin1String("session-name")))
-            .value(QLatin1String("text"))).toString());
+    fileName.replace(QLatin1String("$sessionName"), naming.sessionName);
     return fileName;
 }
 
@@ -1193,9 +1693,13 @@ QStringList TrainingSession::getOutputFileNames(const QString &fileNameFormat,
     }
 
     if (outputFormats & HrmOutput) {
-        const QFileInfo fileInfo(this->baseName);
-        const int exerciseCount = fileInfo.dir().entryInfoList(QStringList(
-            fileInfo.fileName() + QLatin1String("-exercises-*-create"))).count();
+        const QMap<QString, QMap<QString, QString> > exercises = getInputFiles().exercises;
+        int exerciseCount = 0;
+        foreach (const QMap<QString, QString> &exercise, exercises) {
+            if (exercise.contains(QLatin1String("create"))) {
+                ++exerciseCount;
+            }
+        }
         if (exerciseCount == 1) {
             fileNames.append(baseName + QLatin1String(".hrm"));
             if (hrmOptions.testFlag(RrFiles)) {
@@ -1220,68 +1724,78 @@ QStringList TrainingSession::getOutputFileNames(const QString &fileNameFormat,
     return fileNames;
 }
 
-/// @see http://www.topografix.com/GPX/1/1/gpx.xsd
 QDomDocument TrainingSession::toGPX(const QDateTime &creationTime) const
 {
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
     QDomDocument doc;
-    doc.appendChild(doc.createProcessingInstruction(QLatin1String("xml"),
-        QLatin1String("version='1.0' encoding='utf-8'")));
-
-    QDomElement gpx = doc.createElement(QLatin1String("gpx"));
-    gpx.setAttribute(QLatin1String("version"), QLatin1String("1.1"));
-    gpx.setAttribute(QLatin1String("creator"), QString::fromLatin1("%1 %2 - %3")
-                     .arg(QApplication::applicationName())
-                     .arg(QApplication::applicationVersion())
-                     .arg(QLatin1String("https://github.com/pcolby/bipolar")));
-    gpx.setAttribute(QLatin1String("xmlns"),
-                     QLatin1String("http://www.topografix.com/GPX/1/1"));
-    gpx.setAttribute(QLatin1String("xmlns:xsi"),
-                     QLatin1String("http://www.w3.org/2001/XMLSchema-instance"));
-    gpx.setAttribute(QLatin1String("xsi:schemaLocation"),
-                     QLatin1String("http://www.topografix.com/GPX/1/1 "
-                                   "http://www.topografix.com/GPX/1/1/gpx.xsd"));
-    doc.appendChild(gpx);
-
-    QDomElement metaData = doc.createElement(QLatin1String("metadata"));
-    metaData.appendChild(doc.createElement(QLatin1String("name")))
-        .appendChild(doc.createTextNode(getFileName(baseName)));
-    metaData.appendChild(doc.createElement(QLatin1String("desc")))
-        .appendChild(doc.createTextNode(tr("GPX encoding of %1")
-                                        .arg(getFileName(baseName))));
-    QDomElement link = doc.createElement(QLatin1String("link"));
-    link.setAttribute(QLatin1String("href"), QLatin1String("https://github.com/pcolby/bipolar"));
-    metaData.appendChild(doc.createElement(QLatin1String("author")))
-        .appendChild(link).appendChild(doc.createElement(QLatin1String("text")))
-            .appendChild(doc.createTextNode(QLatin1String("Bipolar")));
-    metaData.appendChild(doc.createElement(QLatin1String("time")))
-        .appendChild(doc.createTextNode(creationTime.toString(Qt::ISODate)));
-    gpx.appendChild(metaData);
-
-    foreach (const QVariant &exercise, parsedExercises) {
-        const QVariantMap map = exercise.toMap();
+    if (writeGPX(buffer, creationTime)) {
+        doc.setContent(buffer.data());
+    }
+    return doc;
+}
 
-        QDomElement trk = doc.createElement(QLatin1String("trk"));
-        gpx.appendChild(trk);
+/// @see http://www.topografix.com/GPX/1/1/gpx.xsd
+bool TrainingSession::writeGPX(QIODevice &device, const QDateTime &creationTime) const
+{
+    QXmlStreamWriter gpx(&device);
+    gpx.setAutoFormatting(true);
+    gpx.setAutoFormattingIndent(2);
+    gpx.writeProcessingInstruction(QLatin1String("xml"),
+        QLatin1String("version='1.0' encoding='utf-8'"));
+
+    gpx.writeStartElement(QLatin1String("gpx"));
+    gpx.writeAttribute(QLatin1String("version"), QLatin1String("1.1"));
+    gpx.writeAttribute(QLatin1String("xmlns:xsi"),
+                       QLatin1String("http://www.w3.org/2001/XMLSchema-instance"));
+    gpx.writeAttribute(QLatin1String("creator"), QString::fromLatin1("%1 %2 - %3")
+                       .arg(QCoreApplication::applicationName())
+                       .arg(QCoreApplication::applicationVersion())
+                       .arg(QLatin1String("https://github.com/pcolby/bipolar")));
+    gpx.writeAttribute(QLatin1String("xmlns"),
+                       QLatin1String("http://www.topografix.com/GPX/1/1"));
+    gpx.writeAttribute(QLatin1String("xsi:schemaLocation"),
+                       QLatin1String("http://www.topografix.com/GPX/1/1 "
+                                     "http://www.topografix.com/GPX/1/1/gpx.xsd"));
+
+    gpx.writeStartElement(QLatin1String("metadata"));
+    gpx.writeTextElement(QLatin1String("name"), getFileName(baseName));
+    gpx.writeTextElement(QLatin1String("desc"), tr("GPX encoding of %1")
+                         .arg(getFileName(baseName)));
+    gpx.writeStartElement(QLatin1String("author"));
+    gpx.writeStartElement(QLatin1String("link"));
+    gpx.writeAttribute(QLatin1String("href"), QLatin1String("https://github.com/pcolby/bipolar"));
+    gpx.writeTextElement(QLatin1String("text"), QLatin1String("Bipolar"));
+    gpx.writeEndElement(); // link
+    gpx.writeEndElement(); // author
+    gpx.writeTextElement(QLatin1String("time"), creationTime.toString(Qt::ISODate));
+    gpx.writeEndElement(); // metadata
+
+    for (QVariantMap::const_iterator exercise = parsedExercises.constBegin();
+         exercise != parsedExercises.constEnd(); ++exercise) {
+        const QVariantMap map = exercise.value().toMap();
+        const ExerciseData data = exerciseData.value(exercise.key());
+
+        gpx.writeStartElement(QLatin1String("trk"));
 
         QStringList sources;
         foreach (const QVariant &source, map.value(QLatin1String("sources")).toList()) {
             sources << getFileName(source.toString());
         }
-        trk.appendChild(doc.createElement(QLatin1String("src")))
-            .appendChild(doc.createTextNode(sources.join(QLatin1Char(' '))));
+        gpx.writeTextElement(QLatin1String("src"), sources.join(QLatin1Char(' ')));
 
         const QVariantMap route = map.value(ROUTE).toMap();
-        if (!route.isEmpty()) {
+        if (map.contains(ROUTE)) {
             // Get the starting time.
             const QDateTime startTime = getDateTime(firstMap(
                 route.value(QLatin1String("timestamp"))));
 
             // Get the number of samples.
-            const QVariantList altitude   = route.value(QLatin1String("altitude")).toList();
-            const QVariantList duration   = route.value(QLatin1String("duration")).toList();
-            const QVariantList latitude   = route.value(QLatin1String("latitude")).toList();
-            const QVariantList longitude  = route.value(QLatin1String("longitude")).toList();
-            const QVariantList satellites = route.value(QLatin1String("satellites")).toList();
+            const SampleChannel<qint32>  &altitude   = data.route.altitude;
+            const SampleChannel<quint32> &duration   = data.route.duration;
+            const SampleChannel<double>  &latitude   = data.route.latitude;
+            const SampleChannel<double>  &longitude  = data.route.longitude;
+            const SampleChannel<quint32> &satellites = data.route.satellites;
             if ((duration.size() != altitude.size())  ||
                 (duration.size() != latitude.size())  ||
                 (duration.size() != longitude.size()) ||
@@ -1307,390 +1821,568 @@ QDomDocument TrainingSession::toGPX(const QDateTime &creationTime) const
             }
             std::sort(splits.begin(), splits.end());
 
-            // Add trkseg elements containing the actual GPS data.
-            QDomElement trkseg = doc.createElement(QLatin1String("trkseg"));
-            trk.appendChild(trkseg);
+            // Add trkseg elements containing the actual GPS data, writing each
+            // trkpt as we go, rather than building the entire document first.
+            gpx.writeStartElement(QLatin1String("trkseg"));
             for (int index = 0; index < duration.size(); ++index) {
-                const quint32 timeOffset = duration.at(index).toUInt();
+                const quint32 timeOffset = duration.at(index);
                 if ((!splits.isEmpty()) && (timeOffset > splits.first())) {
-                    trkseg = doc.createElement(QLatin1String("trkseg"));
-                    trk.appendChild(trkseg);
+                    gpx.writeEndElement(); // trkseg
+                    gpx.writeStartElement(QLatin1String("trkseg"));
                     splits.removeFirst();
                 }
 
-                QDomElement trkpt = doc.createElement(QLatin1String("trkpt"));
-                trkpt.setAttribute(QLatin1String("lat"), latitude.at(index).toDouble());
-                trkpt.setAttribute(QLatin1String("lon"), longitude.at(index).toDouble());
-                trkpt.appendChild(doc.createElement(QLatin1String("ele")))
-                    .appendChild(doc.createTextNode(altitude.at(index).toString()));
-                trkpt.appendChild(doc.createElement(QLatin1String("time")))
-                    .appendChild(doc.createTextNode(startTime.addMSecs(
-                        timeOffset).toString(Qt::ISODate)));
-                trkpt.appendChild(doc.createElement(QLatin1String("sat")))
-                    .appendChild(doc.createTextNode(satellites.at(index).toString()));
-                trkseg.appendChild(trkpt);
+                gpx.writeStartElement(QLatin1String("trkpt"));
+                gpx.writeAttribute(QLatin1String("lat"),
+                    QString::number(latitude.at(index), 'g', 16));
+                gpx.writeAttribute(QLatin1String("lon"),
+                    QString::number(longitude.at(index), 'g', 16));
+                gpx.writeTextElement(QLatin1String("ele"), altitude.toString(index));
+                gpx.writeTextElement(QLatin1String("time"),
+                    startTime.addMSecs(timeOffset).toString(Qt::ISODate));
+                gpx.writeTextElement(QLatin1String("sat"), satellites.toString(index));
+                gpx.writeEndElement(); // trkpt
             }
+            gpx.writeEndElement(); // trkseg
         }
+        gpx.writeEndElement(); // trk
     }
-    return doc;
+    gpx.writeEndElement(); // gpx
+    gpx.writeEndDocument();
+    if (gpx.hasError()) {
+        qWarning() << "Failed to write GPX" << baseName;
+        return false;
+    }
+    return true;
 }
 
-/// @see http://www.polar.com/files/Polar_HRM_file%20format.pdf
-QStringList TrainingSession::toHRM(const bool rrDataOnly) const
-{
-    QStringList hrmList;
+namespace {
 
-    foreach (const QVariant &exercise, parsedExercises) {
-        const QVariantMap map = exercise.toMap();
-        const QVariantMap autoLaps   = map.value(AUTOLAPS).toMap();
-        const QVariantMap create     = map.value(CREATE).toMap();
-        const QVariantMap manualLaps = map.value(LAPS).toMap();
-        const QVariantMap samples    = map.value(SAMPLES).toMap();
-        const QVariantMap stats      = map.value(STATISTICS).toMap();
-        const QVariantMap zones      = map.value(ZONES).toMap();
+/**
+ * @brief Minimal Latin-1 text stream for writing HRM data.
+ *
+ * Unlike QTextStream, this formats numbers directly into a reusable byte
+ * buffer, which is flushed to the device whenever it fills, rather than
+ * building a UTF-16 string of the entire file, and re-encoding it as Latin-1.
+ */
+class HrmStream {
 
-        const QVariantList rrsamples  = map.value(RRSAMPLES).toMap().value(QLatin1String("value")).toList();
+public:
+    explicit HrmStream(QIODevice &device) : device(device), ok(true)
+    {
+        buffer.reserve(bufferSize);
+    }
 
-        const bool haveAltitude = ((!rrDataOnly) && (haveAnySamples(samples, QLatin1String("speed"))));
-        const bool haveCadence  = ((!rrDataOnly) && (haveAnySamples(samples, QLatin1String("cadence"))));
-        const bool haveSpeed    = ((!rrDataOnly) && (haveAnySamples(samples, QLatin1String("altitude"))));
+    ~HrmStream()
+    {
+        flush();
+    }
 
-        QString hrmData;
-        QTextStream stream(&hrmData);
+    bool flush()
+    {
+        if ((ok) && (!buffer.isEmpty())) {
+            ok = (device.write(buffer) == buffer.size());
+        }
+        buffer.resize(0); // Keeps the reserved capacity.
+        return ok;
+    }
 
-        // [Params]
-        stream <<
-            "[Params]\r\n"
-            "Version=106\r\n"
-            "Monitor=1\r\n"
-            "SMode=";
-        stream << (haveSpeed    ? '1' : '0'); // a) Speed
-        stream << (haveCadence  ? '1' : '0'); // b) Cadence
-        stream << (haveAltitude ? '1' : '0'); // c) Altitude
-        stream <<
-            "0" // d) Power (not supported by V800 yet).
-            "0" // e) Power Left Right Ballance (not supported by V800 yet).
-            "0" // f) Power Pedalling Index (not supported by V800 yet).
-            "0" // g) HR/CC data (available only with Polar XTrainer Plus).
-            "0" // h) US / Euro unit (always metric).
-            "0" // i) Air pressure (not available).
-            "\r\n";
+    HrmStream &operator<<(const char c)
+    {
+        buffer.append(c);
+        return *this;
+    }
 
-        const QDateTime startTime = getDateTime(firstMap(create.value(QLatin1String("start"))));
-        const quint64 recordInterval = getDuration(firstMap(samples.value(QLatin1String("record-interval"))));
-        stream << "Date="      << startTime.toString(QLatin1String("yyyyMMdd")) << "\r\n";
-        stream << "StartTime=" << hrmTime(startTime.time()) << "\r\n";
-        stream << "Length="    << hrmTime(firstMap(create.value(QLatin1String("duration")))) << "\r\n";
-        stream << "Interval="  << (rrDataOnly ? 238 : qRound(recordInterval / 1000.0)) << "\r\n";
-
-        // In the absence of available training target phases data, just include
-        // one of the static target HR zones (better than nothing). We'll use
-        // the one with the greatest duration (why not?).
-        QVariantList hrZones = zones.value(QLatin1String("heartrate")).toList();
-        quint64 hrZoneMaxDuration = 0;
-        QVariantMap longestHrZone;
-        for (int index = 0; (hrZones.length() > 3) && (index < hrZones.length()); ++index) {
-            const QVariantMap hrZone = hrZones.at(index).toMap();
-            const quint64 duration = getDuration(firstMap(hrZone.value(QLatin1String("duration"))));
-            if ((duration > hrZoneMaxDuration) || (hrZoneMaxDuration == 0)) {
-                longestHrZone = hrZone;
-                hrZoneMaxDuration = duration;
-            }
-        }
-        const QVariantMap phase1Limits = firstMap(longestHrZone.value(QLatin1String("limits")));
-        const quint32 phase1LimitHigh = first(phase1Limits.value(QLatin1String("high"))).toUInt();
-        const quint32 phase1LimitLow  = first(phase1Limits.value(QLatin1String("low"))).toUInt();
-        stream << "Upper1=" << phase1LimitHigh << "\r\n";
-        stream << "Lower1=" << phase1LimitLow << "\r\n";
-        stream << "Upper2=0\r\n";
-        stream << "Lower2=0\r\n";
-        stream << "Upper3=0\r\n";
-        stream << "Lower3=0\r\n";
-        stream << "Timer1=" << hrmTime(firstMap(longestHrZone.value(QLatin1String("duration")))) << "\r\n";
-        stream << "Timer2=00:00:00.0\r\n";
-        stream << "Timer3=00:00:00.0\r\n";
-        stream << "ActiveLimit=0\r\n";
-
-        const quint32 hrMax = first(firstMap(parsedPhysicalInformation.value(
-            QLatin1String("maximum-heartrate"))).value(QLatin1String("value"))).toUInt();
-        const quint32 hrRest = first(firstMap(parsedPhysicalInformation.value(
-            QLatin1String("resting-heartrate"))).value(QLatin1String("value"))).toUInt();
-        stream << "MaxHR="  << hrMax  << "\r\n";
-        stream << "RestHR=" << hrRest << "\r\n";
-        stream << "StartDelay=0\r\n"; ///< "Vantage NV RR data only".
-        stream << "VO2max=" << first(firstMap(parsedPhysicalInformation.value(
-            QLatin1String("vo2max"))).value(QLatin1String("value"))).toUInt() << "\r\n";
-        stream << "Weight=" << first(firstMap(parsedPhysicalInformation.value(
-            QLatin1String("weight"))).value(QLatin1String("value"))).toFloat() << "\r\n";
-
-        // [Coach] "Coach parameters are only from Polar Coach HR monitor."
-
-        // [Note]
-        stream << "\r\n[Note]\r\n";
-        if (parsedSession.contains(QLatin1String("note"))) {
-            stream << first(firstMap(parsedSession.value(
-                QLatin1String("note"))).value(QLatin1String("text"))).toString();
-        } else if (parsedSession.contains(QLatin1String("session-name"))) {
-            stream << first(firstMap(parsedSession.value(
-                QLatin1String("session-name"))).value(QLatin1String("text"))).toString();
-        } else {
-            stream << "Exported by " << QApplication::applicationName()
-                   << " " << QApplication::applicationVersion();
-        }
-        stream << "\r\n";
-
-        // [HRZones]
-        QMap<quint32, quint32> hrLimits; // Map hr-high to hr-low.
-        foreach (const QVariant &entry, zones.value(QLatin1String("heartrate")).toList()) {
-            const QVariantMap limits = firstMap(entry.toMap().value(QLatin1String("limits")));
-            hrLimits.insert(
-                first(limits.value(QLatin1String("high"))).toUInt(),
-                first(limits.value(QLatin1String("low"))).toUInt());
-        }
-        // Limit to maximum of 10 HRZones (as implied by HRM v1.4).
-        if (hrLimits.size() > 10) {
-            hrZones.erase(hrZones.begin());
+    HrmStream &operator<<(const char * const text)
+    {
+        buffer.append(text);
+        return flushIfFull();
+    }
+
+    HrmStream &operator<<(const QByteArray &data)
+    {
+        if (data.size() < bufferSize) {
+            buffer.append(data);
+            return flushIfFull();
         }
-        stream << "\r\n[HRZones]\r\n";
-        const QList<quint32> hrLimitsKeys = hrLimits.keys();
-        for (int index = hrLimitsKeys.length() - 2; index >=0; --index) {
-            stream << hrLimitsKeys.at(index) << "\r\n"; // Zone 1 to n upper limits.
+        flush(); // Write large blocks straight through, after anything buffered.
+        if (ok) {
+            ok = (device.write(data) == data.size());
         }
-        if (!hrLimits.empty()) {
-            #if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
-            stream << hrLimits.first() << "\r\n"; // Zone n lower limit.
-            #else
-            stream << hrLimits.constBegin().value() << "\r\n";
-            #endif
+        return *this;
+    }
+
+    HrmStream &operator<<(const QString &text)
+    {
+        buffer.append(text.toLatin1());
+        return flushIfFull();
+    }
+
+    HrmStream &operator<<(const float value)
+    {
+        // Same formatting as QTextStream's default (ie 6 significant digits).
+        buffer.append(QByteArray::number(value, 'g', 6));
+        return flushIfFull();
+    }
+
+    HrmStream &operator<<(const int value)
+    {
+        return appendNumber((value < 0) ? (0 - static_cast<quint64>(value))
+                                        : static_cast<quint64>(value), value < 0);
+    }
+
+    HrmStream &operator<<(const uint value)
+    {
+        return appendNumber(value, false);
+    }
+
+protected:
+    static const int bufferSize = 64 * 1024;
+    QByteArray buffer;
+    QIODevice &device;
+    bool ok;
+
+    HrmStream &appendNumber(quint64 magnitude, const bool negative)
+    {
+        char digits[21];
+        char * const end = digits + sizeof(digits);
+        char * begin = end;
+        do {
+            *--begin = static_cast<char>('0' + (magnitude % 10));
+            magnitude /= 10;
+        } while (magnitude > 0);
+        if (negative) {
+            *--begin = '-';
         }
-        for (int index = hrLimits.size() + (hrLimits.isEmpty() ? 1 : 0); index < 11; ++index) {
-            stream << "0\r\n"; // "0" entries for a total of 11 HRZones entries.
+        buffer.append(begin, end - begin);
+        return flushIfFull();
+    }
+
+    HrmStream &flushIfFull()
+    {
+        if (buffer.size() >= bufferSize) {
+            flush();
         }
+        return *this;
+    }
 
-        // [SwapTimes]
-        stream << "[SwapTimes]\r\n";
-        /// @todo Add phase swap times here if/when the training phases data becomes available.
+};
 
-        // [HRCCModeCh] "HR/CC mode swaps are a available only with Polar XTrainer Plus."
+}
 
-        // [IntTimes]
-        QMap<QString, QVariantMap> laps;
-        foreach (const QVariant &lap, autoLaps.value(QLatin1String("laps")).toList()) {
-            QVariantMap lapMap = lap.toMap();
-            const QString splitTime = hrmTime(firstMap(firstMap(
-                lapMap.value(QLatin1String("header")))
-                .value(QLatin1String("split-time"))));
-            lapMap.insert(QLatin1String("_isAuto"), QVariant(true));
-            laps.insert(splitTime, lapMap);
+QStringList TrainingSession::toHRM(const bool rrDataOnly) const
+{
+    QStringList hrmList;
+    foreach (const QString &exerciseId, parsedExercises.keys()) {
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        if (writeHRM(buffer, exerciseId, rrDataOnly)) {
+            hrmList.append(QString::fromLatin1(buffer.data()));
         }
-        foreach (const QVariant &lap, manualLaps.value(QLatin1String("laps")).toList()) {
-            QVariantMap lapMap = lap.toMap();
-            const QString splitTime = hrmTime(firstMap(firstMap(
-                lapMap.value(QLatin1String("header")))
-                .value(QLatin1String("split-time"))));
-            lapMap.insert(QLatin1String("_isAuto"), QVariant(false));
-            laps.insert(splitTime, lapMap);
+    }
+    return hrmList;
+}
+
+/**
+ * @brief Write a single exercise in HRM format.
+ *
+ * @param device      Device to write the HRM data to.
+ * @param exerciseId  ID of the (parsed) exercise to write.
+ * @param rrDataOnly  If `true`, write R-R intervals instead of samples.
+ *
+ * @return `true` if the exercise was written successfully.
+ *
+ * @see writeHRM(const QString &, QIODevice *, QIODevice *)
+ */
+bool TrainingSession::writeHRM(QIODevice &device, const QString &exerciseId,
+                               const bool rrDataOnly) const
+{
+    return (rrDataOnly) ? writeHRM(exerciseId, NULL, &device)
+                        : writeHRM(exerciseId, &device, NULL);
+}
+
+/**
+ * @brief Write a single exercise as HRM sample and/or R-R interval data.
+ *
+ * The two HRM files differ only in their modes, intervals and [HRData] rows,
+ * so all other sections (zones, laps, summaries, etc) are generated once, and
+ * shared by both.
+ *
+ * @param exerciseId ID of the (parsed) exercise to write.
+ * @param hrmDevice  Device to write HRM sample data to, or `NULL` for none.
+ * @param rrDevice   Device to write HRM R-R data to, or `NULL` for none.
+ *
+ * @return `true` if all requested data was written successfully.
+ *
+ * @see http://www.polar.com/files/Polar_HRM_file%20format.pdf
+ */
+bool TrainingSession::writeHRM(const QString &exerciseId, QIODevice * const hrmDevice,
+                               QIODevice * const rrDevice) const
+{
+    const QVariantMap::const_iterator exercise = parsedExercises.constFind(exerciseId);
+    if (exercise == parsedExercises.constEnd()) {
+        qWarning() << "No such exercise" << exerciseId;
+        return false;
+    }
+
+    const QVariantMap map = exercise.value().toMap();
+    const ExerciseData data = exerciseData.value(exercise.key());
+    const QVariantMap autoLaps   = map.value(AUTOLAPS).toMap();
+    const QVariantMap create     = map.value(CREATE).toMap();
+    const QVariantMap manualLaps = map.value(LAPS).toMap();
+    const QVariantMap samples    = map.value(SAMPLES).toMap();
+    const QVariantMap stats      = map.value(STATISTICS).toMap();
+    const QVariantMap zones      = map.value(ZONES).toMap();
+
+    const bool haveAltitude = data.samples.speed.haveAnyOnline();
+    const bool haveCadence  = data.samples.cadence.haveAnyOnline();
+    const bool haveSpeed    = data.samples.altitude.haveAnyOnline();
+
+    // Generate the sections shared by both files, noting where the (unshared)
+    // "Interval" parameter needs to be inserted.
+    QBuffer shared;
+    shared.open(QIODevice::WriteOnly);
+    HrmStream stream(shared);
+
+    const QDateTime startTime = getDateTime(firstMap(create.value(QLatin1String("start"))));
+    const quint64 recordInterval = getDuration(firstMap(samples.value(QLatin1String("record-interval"))));
+    stream << "Date="      << startTime.toString(QLatin1String("yyyyMMdd")) << "\r\n";
+    stream << "StartTime=" << hrmTime(startTime.time()) << "\r\n";
+    stream << "Length="    << hrmTime(firstMap(create.value(QLatin1String("duration")))) << "\r\n";
+    stream.flush();
+    const int intervalOffset = shared.data().size();
+
+    // In the absence of available training target phases data, just include
+    // one of the static target HR zones (better than nothing). We'll use
+    // the one with the greatest duration (why not?).
+    QVariantList hrZones = zones.value(QLatin1String("heartrate")).toList();
+    quint64 hrZoneMaxDuration = 0;
+    QVariantMap longestHrZone;
+    for (int index = 0; (hrZones.length() > 3) && (index < hrZones.length()); ++index) {
+        const QVariantMap hrZone = hrZones.at(index).toMap();
+        const quint64 duration = getDuration(firstMap(hrZone.value(QLatin1String("duration"))));
+        if ((duration > hrZoneMaxDuration) || (hrZoneMaxDuration == 0)) {
+            longestHrZone = hrZone;
+            hrZoneMaxDuration = duration;
         }
-        if (!laps.isEmpty()) {
-            stream << "\r\n[IntTimes]\r\n";
-            foreach (const QString &splitTime, laps.keys()) {
-                const QVariantMap &lap = laps.value(splitTime);
-                const QVariantMap header = firstMap(lap.value(QLatin1String("header")));
-                const QVariantMap stats = firstMap(lap.value(QLatin1String("stats")));
-                const QVariantMap hrStats = firstMap(stats.value(QLatin1String("heartrate")));
-                // Row 1
-                stream << hrmTime(firstMap(header.value(QLatin1String("split-time"))));
-                stream << '\t' << first(hrStats.value(QLatin1String("average"))).toUInt();
-                stream << '\t' << first(hrStats.value(QLatin1String("minimum"))).toUInt();
-                stream << '\t' << first(hrStats.value(QLatin1String("average"))).toUInt();
-                stream << '\t' << first(hrStats.value(QLatin1String("maximum"))).toUInt();
-                stream << "\r\n";
-                // Row 2
-                stream << "28";
-                stream << "\t0"; // Recovery time (seconds); data not available.
-                stream << "\t0"; // Recovery HR (bpm); data not available.
-                stream << "\t" << qRound(first(firstMap(stats.value(QLatin1String("speed")))
-                    .value(QLatin1String("maximum"))).toFloat() * 128.0);
-                stream << "\t" << first(firstMap(stats.value(QLatin1String("cadence")))
-                    .value(QLatin1String("maximum"))).toUInt();
-                stream << "\t0"; // Momentary altitude; not available per lap.
-                stream << "\r\n";
-                // Row 3
-                stream << qRound(first(header.value(QLatin1String("descent"))).toFloat() * 10.0);
-                stream << '\t' << (first(firstMap(stats.value(QLatin1String("pedaling")))
-                    .value(QLatin1String("average"))).toUInt() * 10);
-                stream << '\t' << qRound(first(firstMap(stats.value(QLatin1String("incline")))
-                    .value(QLatin1String("max"))).toFloat() * 10.0);
-                stream << '\t' << qRound(first(header.value(QLatin1String("ascent"))).toFloat() / 10.0);
-                stream << '\t' << qRound(first(header.value(QLatin1String("distance"))).toFloat() / 100.0);
-                stream << "\r\n";
-                // Row 4
-                switch (first(header.value(QLatin1String("lap-type"))).toInt()) {
-                case 1:  stream << 1; break; // Distance -> interval
-                case 2:  stream << 1; break; // Duration -> interval
-                case 3:  stream << 0; break; // Location -> normal lap
-                default: stream << 0; // Absent (ie manual) -> normal lap
-                }
-                stream << '\t' << qRound(first(header.value(QLatin1String("distance"))).toFloat());
-                stream << '\t' << first(header.value(QLatin1String("power"))).toUInt();
-                stream << '\t' << first(firstMap(stats.value(QLatin1String("temperature")))
-                    .value(QLatin1String("average"))).toFloat();
-                stream << "\t0"; // "Internal phase/lap information"
-                stream << "\t0"; // Air pressure not available in protobuf data.
-                stream << "\r\n";
-                // Row 5
-                stream << first(firstMap(stats.value(QLatin1String("stride")))
-                    .value(QLatin1String("average"))).toUInt();
-                stream << '\t' << (lap.value(QLatin1String("_isAuto")).toBool() ? '1' : '0');
-                stream << "\t0\t0\t0\t0\r\n";
+    }
+    const QVariantMap phase1Limits = firstMap(longestHrZone.value(QLatin1String("limits")));
+    const quint32 phase1LimitHigh = first(phase1Limits.value(QLatin1String("high"))).toUInt();
+    const quint32 phase1LimitLow  = first(phase1Limits.value(QLatin1String("low"))).toUInt();
+    stream << "Upper1=" << phase1LimitHigh << "\r\n";
+    stream << "Lower1=" << phase1LimitLow << "\r\n";
+    stream << "Upper2=0\r\n";
+    stream << "Lower2=0\r\n";
+    stream << "Upper3=0\r\n";
+    stream << "Lower3=0\r\n";
+    stream << "Timer1=" << hrmTime(firstMap(longestHrZone.value(QLatin1String("duration")))) << "\r\n";
+    stream << "Timer2=00:00:00.0\r\n";
+    stream << "Timer3=00:00:00.0\r\n";
+    stream << "ActiveLimit=0\r\n";
+
+    const quint32 hrMax = first(firstMap(parsedPhysicalInformation.value(
+        QLatin1String("maximum-heartrate"))).value(QLatin1String("value"))).toUInt();
+    const quint32 hrRest = first(firstMap(parsedPhysicalInformation.value(
+        QLatin1String("resting-heartrate"))).value(QLatin1String("value"))).toUInt();
+    stream << "MaxHR="  << hrMax  << "\r\n";
+    stream << "RestHR=" << hrRest << "\r\n";
+    stream << "StartDelay=0\r\n"; ///< "Vantage NV RR data only".
+    stream << "VO2max=" << first(firstMap(parsedPhysicalInformation.value(
+        QLatin1String("vo2max"))).value(QLatin1String("value"))).toUInt() << "\r\n";
+    stream << "Weight=" << first(firstMap(parsedPhysicalInformation.value(
+        QLatin1String("weight"))).value(QLatin1String("value"))).toFloat() << "\r\n";
+
+    // [Coach] "Coach parameters are only from Polar Coach HR monitor."
+
+    // [Note]
+    stream << "\r\n[Note]\r\n";
+    if (parsedSession.contains(QLatin1String("note"))) {
+        stream << first(firstMap(parsedSession.value(
+            QLatin1String("note"))).value(QLatin1String("text"))).toString();
+    } else if (parsedSession.contains(QLatin1String("session-name"))) {
+        stream << first(firstMap(parsedSession.value(
+            QLatin1String("session-name"))).value(QLatin1String("text"))).toString();
+    } else {
+        stream << "Exported by " << QCoreApplication::applicationName()
+               << " " << QCoreApplication::applicationVersion();
+    }
+    stream << "\r\n";
+
+    // [HRZones]
+    QMap<quint32, quint32> hrLimits; // Map hr-high to hr-low.
+    foreach (const QVariant &entry, zones.value(QLatin1String("heartrate")).toList()) {
+        const QVariantMap limits = firstMap(entry.toMap().value(QLatin1String("limits")));
+        hrLimits.insert(
+            first(limits.value(QLatin1String("high"))).toUInt(),
+            first(limits.value(QLatin1String("low"))).toUInt());
+    }
+    // Limit to maximum of 10 HRZones (as implied by HRM v1.4).
+    if (hrLimits.size() > 10) {
+        hrZones.erase(hrZones.begin());
+    }
+    stream << "\r\n[HRZones]\r\n";
+    const QList<quint32> hrLimitsKeys = hrLimits.keys();
+    for (int index = hrLimitsKeys.length() - 2; index >=0; --index) {
+        stream << hrLimitsKeys.at(index) << "\r\n"; // Zone 1 to n upper limits.
+    }
+    if (!hrLimits.empty()) {
+        #if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
+        stream << hrLimits.first() << "\r\n"; // Zone n lower limit.
+        #else
+        stream << hrLimits.constBegin().value() << "\r\n";
+        #endif
+    }
+    for (int index = hrLimits.size() + (hrLimits.isEmpty() ? 1 : 0); index < 11; ++index) {
+        stream << "0\r\n"; // "0" entries for a total of 11 HRZones entries.
+    }
+
+    // [SwapTimes]
+    stream << "[SwapTimes]\r\n";
+    /// @todo Add phase swap times here if/when the training phases data becomes available.
+
+    // [HRCCModeCh] "HR/CC mode swaps are a available only with Polar XTrainer Plus."
+
+    // [IntTimes]
+    QMap<QString, QVariantMap> laps;
+    foreach (const QVariant &lap, autoLaps.value(QLatin1String("laps")).toList()) {
+        QVariantMap lapMap = lap.toMap();
+        const QString splitTime = hrmTime(firstMap(firstMap(
+            lapMap.value(QLatin1String("header")))
+            .value(QLatin1String("split-time"))));
+        lapMap.insert(QLatin1String("_isAuto"), QVariant(true));
+        laps.insert(splitTime, lapMap);
+    }
+    foreach (const QVariant &lap, manualLaps.value(QLatin1String("laps")).toList()) {
+        QVariantMap lapMap = lap.toMap();
+        const QString splitTime = hrmTime(firstMap(firstMap(
+            lapMap.value(QLatin1String("header")))
+            .value(QLatin1String("split-time"))));
+        lapMap.insert(QLatin1String("_isAuto"), QVariant(false));
+        laps.insert(splitTime, lapMap);
+    }
+    if (!laps.isEmpty()) {
+        stream << "\r\n[IntTimes]\r\n";
+        foreach (const QString &splitTime, laps.keys()) {
+            const QVariantMap &lap = laps.value(splitTime);
+            const QVariantMap header = firstMap(lap.value(QLatin1String("header")));
+            const QVariantMap stats = firstMap(lap.value(QLatin1String("stats")));
+            const QVariantMap hrStats = firstMap(stats.value(QLatin1String("heartrate")));
+            // Row 1
+            stream << hrmTime(firstMap(header.value(QLatin1String("split-time"))));
+            stream << '\t' << first(hrStats.value(QLatin1String("average"))).toUInt();
+            stream << '\t' << first(hrStats.value(QLatin1String("minimum"))).toUInt();
+            stream << '\t' << first(hrStats.value(QLatin1String("average"))).toUInt();
+            stream << '\t' << first(hrStats.value(QLatin1String("maximum"))).toUInt();
+            stream << "\r\n";
+            // Row 2
+            stream << "28";
+            stream << "\t0"; // Recovery time (seconds); data not available.
+            stream << "\t0"; // Recovery HR (bpm); data not available.
+            stream << "\t" << qRound(first(firstMap(stats.value(QLatin1String("speed")))
+                .value(QLatin1String("maximum"))).toFloat() * 128.0);
+            stream << "\t" << first(firstMap(stats.value(QLatin1String("cadence")))
+                .value(QLatin1String("maximum"))).toUInt();
+            stream << "\t0"; // Momentary altitude; not available per lap.
+            stream << "\r\n";
+            // Row 3
+            stream << qRound(first(header.value(QLatin1String("descent"))).toFloat() * 10.0);
+            stream << '\t' << (first(firstMap(stats.value(QLatin1String("pedaling")))
+                .value(QLatin1String("average"))).toUInt() * 10);
+            stream << '\t' << qRound(first(firstMap(stats.value(QLatin1String("incline")))
+                .value(QLatin1String("max"))).toFloat() * 10.0);
+            stream << '\t' << qRound(first(header.value(QLatin1String("ascent"))).toFloat() / 10.0);
+            stream << '\t' << qRound(first(header.value(QLatin1String("distance"))).toFloat() / 100.0);
+            stream << "\r\n";
+            // Row 4
+            switch (first(header.value(QLatin1String("lap-type"))).toInt()) {
+            case 1:  stream << 1; break; // Distance -> interval
+            case 2:  stream << 1; break; // Duration -> interval
+            case 3:  stream << 0; break; // Location -> normal lap
+            default: stream << 0; // Absent (ie manual) -> normal lap
             }
+            stream << '\t' << qRound(first(header.value(QLatin1String("distance"))).toFloat());
+            stream << '\t' << first(header.value(QLatin1String("power"))).toUInt();
+            stream << '\t' << first(firstMap(stats.value(QLatin1String("temperature")))
+                .value(QLatin1String("average"))).toFloat();
+            stream << "\t0"; // "Internal phase/lap information"
+            stream << "\t0"; // Air pressure not available in protobuf data.
+            stream << "\r\n";
+            // Row 5
+            stream << first(firstMap(stats.value(QLatin1String("stride")))
+                .value(QLatin1String("average"))).toUInt();
+            stream << '\t' << (lap.value(QLatin1String("_isAuto")).toBool() ? '1' : '0');
+            stream << "\t0\t0\t0\t0\r\n";
         }
+    }
 
-        // [IntNotes]
-        if (!laps.isEmpty()) {
-            stream << "\r\n[IntNotes]\r\n";
-            const QStringList keys = laps.keys();
-            for (int index = 0; index < keys.length(); ++index) {
-                const QVariantMap &lap = laps.value(keys.at(index));
-                const QVariantMap header = firstMap(lap.value(QLatin1String("header")));
-                switch (first(header.value(QLatin1String("lap-type"))).toInt()) {
-                case 1:  stream << (index+1) << "\tDistance based lap\r\n"; break;
-                case 2:  stream << (index+1) << "\tDuration based lap\r\n"; break;
-                case 3:  stream << (index+1) << "\tLocation based lap\r\n"; break;
-                default: stream << (index+1) << "\tManual lap\r\n";
-                }
+    // [IntNotes]
+    if (!laps.isEmpty()) {
+        stream << "\r\n[IntNotes]\r\n";
+        const QStringList keys = laps.keys();
+        for (int index = 0; index < keys.length(); ++index) {
+            const QVariantMap &lap = laps.value(keys.at(index));
+            const QVariantMap header = firstMap(lap.value(QLatin1String("header")));
+            switch (first(header.value(QLatin1String("lap-type"))).toInt()) {
+            case 1:  stream << (index+1) << "\tDistance based lap\r\n"; break;
+            case 2:  stream << (index+1) << "\tDuration based lap\r\n"; break;
+            case 3:  stream << (index+1) << "\tLocation based lap\r\n"; break;
+            default: stream << (index+1) << "\tManual lap\r\n";
             }
         }
+    }
 
-        // [ExtraData] This section describes the semantics of the "extra" data.
-        // The data itself is included in the [IntTimes] section ("row 3"),
-        // where HRM2 v1.4 says the acceptable range is 0..3000, and values are
-        // all multiplied by 10, to extra data can hold 0..300 units.
-        if (!laps.isEmpty()) {
-            stream << "\r\n[ExtraData]\r\n";
-            stream << "Descent\r\nMeters\t1000\t0\r\n";
-            stream << "Pedaling Index\r\n%\t100\t0\r\n";
-            stream << "Max Incline\r\nDegrees\t90\t0\r\n";
-        }
+    // [ExtraData] This section describes the semantics of the "extra" data.
+    // The data itself is included in the [IntTimes] section ("row 3"),
+    // where HRM2 v1.4 says the acceptable range is 0..3000, and values are
+    // all multiplied by 10, to extra data can hold 0..300 units.
+    if (!laps.isEmpty()) {
+        stream << "\r\n[ExtraData]\r\n";
+        stream << "Descent\r\nMeters\t1000\t0\r\n";
+        stream << "Pedaling Index\r\n%\t100\t0\r\n";
+        stream << "Max Incline\r\nDegrees\t90\t0\r\n";
+    }
 
-        // [LapNames] This HRM section is undocumented, but supported by PPT5.
-        if ((hrmOptions.testFlag(LapNames)) && (!laps.isEmpty())) {
-            stream << "\r\n[LapNames]\r\n";
-            const QStringList keys = laps.keys();
-            for (int index = 0; index < keys.length(); ++index) {
-                const QVariantMap &lap = laps.value(keys.at(index));
-                stream << (index+1) << '\t'
-                       << (lap.value(QLatin1String("_isAuto")).toBool() ? '2' : '1')
-                       << "\r\n"; // 2 = Auto, 1 = Manual.
-            }
+    // [LapNames] This HRM section is undocumented, but supported by PPT5.
+    if ((hrmOptions.testFlag(LapNames)) && (!laps.isEmpty())) {
+        stream << "\r\n[LapNames]\r\n";
+        const QStringList keys = laps.keys();
+        for (int index = 0; index < keys.length(); ++index) {
+            const QVariantMap &lap = laps.value(keys.at(index));
+            stream << (index+1) << '\t'
+                   << (lap.value(QLatin1String("_isAuto")).toBool() ? '2' : '1')
+                   << "\r\n"; // 2 = Auto, 1 = Manual.
         }
+    }
 
-        // [Summary-123] This will need updating if/when phases data is available.
-        const QVariantList heartrate = samples.value(QLatin1String("heartrate")).toList();
-        int summary123Row1[5] = { 0, 0, 0, 0, 0};
-        for (int index = 0; index < heartrate.length(); ++index) {
-            const quint32 hr = ((index < heartrate.length()) ? heartrate.at(index).toUInt() : (uint)0);
-            if (hr > hrMax)
-                summary123Row1[0]++;
-            else if (hr > phase1LimitHigh)
-                summary123Row1[2]++;
-            else if (hr > phase1LimitLow)
-                summary123Row1[2]++;
-            else if (hr > hrRest)
-                summary123Row1[3]++;
-            else
-                summary123Row1[4]++;
-        }
-        stream << "\r\n[Summary-123]\r\n";
-        stream << qRound(heartrate.length() * recordInterval / 1000.0);
-        for (size_t index = 0; index < (sizeof(summary123Row1)/sizeof(summary123Row1[0])); ++index) {
-            stream << '\t' << qRound(summary123Row1[index] * recordInterval / 1000.0);
-        }
-        stream << "\r\n";
-        stream << "0\t0\t0\t0\t0\t0\r\n";
-        stream << "0\t0\t0\t0\r\n";
-        stream << "0\t0\t0\t0\t0\t0\r\n";
-        stream << "0\t0\t0\t0\r\n";
-        stream << "0\t" << heartrate.length() << "\r\n";
-
-        // [Summary-TH]
-        const quint32 anaerobicThreshold = first(firstMap(parsedPhysicalInformation.value(
-            QLatin1String("anaerobic-threshold"))).value(QLatin1String("value"))).toUInt();
-        const quint32 aerobicThreshold = first(firstMap(parsedPhysicalInformation.value(
-            QLatin1String("aerobic-threshold"))).value(QLatin1String("value"))).toUInt();
-        int summaryThRow1[5] = { 0, 0, 0, 0, 0};
-        for (int index = 0; index < heartrate.length(); ++index) {
-            const quint32 hr = ((index < heartrate.length()) ? heartrate.at(index).toUInt() : (uint)0);
-            if (hr > hrMax)
-                summaryThRow1[0]++;
-            else if (hr > anaerobicThreshold)
-                summaryThRow1[1]++;
-            else if (hr > aerobicThreshold)
-                summaryThRow1[2]++;
-            else if (hr > hrRest)
-                summaryThRow1[3]++;
-            else
-                summaryThRow1[4]++;
-        }
-        stream << "\r\n[Summary-TH]\r\n"; // WebSync includes 0's when empty.
-        stream << qRound(heartrate.length() * recordInterval / 1000.0);
-        for (size_t index = 0; index < (sizeof(summaryThRow1)/sizeof(summaryThRow1[0])); ++index) {
-            stream << '\t' << qRound(summaryThRow1[index] * recordInterval / 1000.0);
+    // Count heart rate zone samples for both [Summary-123] and [Summary-TH].
+    const SampleChannel<quint32> &heartrate = data.samples.heartrate;
+    const quint32 anaerobicThreshold = first(firstMap(parsedPhysicalInformation.value(
+        QLatin1String("anaerobic-threshold"))).value(QLatin1String("value"))).toUInt();
+    const quint32 aerobicThreshold = first(firstMap(parsedPhysicalInformation.value(
+        QLatin1String("aerobic-threshold"))).value(QLatin1String("value"))).toUInt();
+    ZoneHistogram hrHistogram;
+    const int summary123Zones = hrHistogram.addZones(QVector<quint32>()
+        << hrMax << phase1LimitHigh << phase1LimitLow << hrRest);
+    const int summaryThZones = hrHistogram.addZones(QVector<quint32>()
+        << hrMax << anaerobicThreshold << aerobicThreshold << hrRest);
+    hrHistogram.addSamples(heartrate.constData(), heartrate.size());
+
+    // [Summary-123] This will need updating if/when phases data is available.
+    // Until then, samples above the phase 1 upper limit are counted as within
+    // the limits, as they always have been.
+    QVector<int> summary123Row1 = hrHistogram.counts(summary123Zones);
+    summary123Row1[2] += summary123Row1[1];
+    summary123Row1[1] = 0;
+    stream << "\r\n[Summary-123]\r\n";
+    stream << qRound(heartrate.size() * recordInterval / 1000.0);
+    for (int index = 0; index < summary123Row1.size(); ++index) {
+        stream << '\t' << qRound(summary123Row1.at(index) * recordInterval / 1000.0);
+    }
+    stream << "\r\n";
+    stream << "0\t0\t0\t0\t0\t0\r\n";
+    stream << "0\t0\t0\t0\r\n";
+    stream << "0\t0\t0\t0\t0\t0\r\n";
+    stream << "0\t0\t0\t0\r\n";
+    stream << "0\t" << heartrate.size() << "\r\n";
+
+    // [Summary-TH]
+    const QVector<int> summaryThRow1 = hrHistogram.counts(summaryThZones);
+    stream << "\r\n[Summary-TH]\r\n"; // WebSync includes 0's when empty.
+    stream << qRound(heartrate.size() * recordInterval / 1000.0);
+    for (int index = 0; index < summaryThRow1.size(); ++index) {
+        stream << '\t' << qRound(summaryThRow1.at(index) * recordInterval / 1000.0);
+    }
+    stream << "\r\n";
+    stream << hrMax;
+    stream << '\t' << anaerobicThreshold;
+    stream << '\t' << aerobicThreshold;
+    stream << '\t' << hrRest;
+    stream << "\r\n";
+    stream << "0\t" << heartrate.size() << "\r\n";
+
+    // [Trip]
+    stream << "\r\n[Trip]\r\n";
+    stream << qRound(first(create.value(QLatin1String("distance"))).toFloat()/100.0) << "\r\n";
+    stream << qRound(first(create.value(QLatin1String("ascent"))).toFloat()) << "\r\n";
+    stream << qRound(getDuration(firstMap(create.value(QLatin1String("duration"))))/1000.0) << "\r\n";
+    stream << qRound(first(firstMap(stats.value(QLatin1String("altitude"))).value(QLatin1String("average"))).toFloat()) << "\r\n";
+    stream << qRound(first(firstMap(stats.value(QLatin1String("altitude"))).value(QLatin1String("maximum"))).toFloat()) << "\r\n";
+    stream << qRound(first(firstMap(stats.value(QLatin1String("speed"))).value(QLatin1String("average"))).toFloat() * 128.0) << "\r\n";
+    stream << qRound(first(firstMap(stats.value(QLatin1String("speed"))).value(QLatin1String("maximum"))).toFloat() * 128.0) << "\r\n";
+    stream << "0\r\n"; // Odometer value at the end of an exercise.
+    stream.flush();
+
+    // Write each requested file, from the shared sections.
+    const QByteArray &sharedData = shared.data();
+    bool result = true;
+    for (int rrDataOnly = 0; rrDataOnly <= 1; ++rrDataOnly) {
+        QIODevice * const device = (rrDataOnly) ? rrDevice : hrmDevice;
+        if (device == NULL) {
+            continue;
         }
-        stream << "\r\n";
-        stream << hrMax;
-        stream << '\t' << anaerobicThreshold;
-        stream << '\t' << aerobicThreshold;
-        stream << '\t' << hrRest;
-        stream << "\r\n";
-        stream << "0\t" << heartrate.length() << "\r\n";
-
-        // [Trip]
-        stream << "\r\n[Trip]\r\n";
-        stream << qRound(first(create.value(QLatin1String("distance"))).toFloat()/100.0) << "\r\n";
-        stream << qRound(first(create.value(QLatin1String("ascent"))).toFloat()) << "\r\n";
-        stream << qRound(getDuration(firstMap(create.value(QLatin1String("duration"))))/1000.0) << "\r\n";
-        stream << qRound(first(firstMap(stats.value(QLatin1String("altitude"))).value(QLatin1String("average"))).toFloat()) << "\r\n";
-        stream << qRound(first(firstMap(stats.value(QLatin1String("altitude"))).value(QLatin1String("maximum"))).toFloat()) << "\r\n";
-        stream << qRound(first(firstMap(stats.value(QLatin1String("speed"))).value(QLatin1String("average"))).toFloat() * 128.0) << "\r\n";
-        stream << qRound(first(firstMap(stats.value(QLatin1String("speed"))).value(QLatin1String("maximum"))).toFloat() * 128.0) << "\r\n";
-        stream << "0\r\n"; // Odometer value at the end of an exercise.
+        HrmStream hrm(*device);
+
+        // [Params]
+        hrm <<
+            "[Params]\r\n"
+            "Version=106\r\n"
+            "Monitor=1\r\n"
+            "SMode=";
+        hrm << (((!rrDataOnly) && (haveSpeed))    ? '1' : '0'); // a) Speed
+        hrm << (((!rrDataOnly) && (haveCadence))  ? '1' : '0'); // b) Cadence
+        hrm << (((!rrDataOnly) && (haveAltitude)) ? '1' : '0'); // c) Altitude
+        hrm <<
+            "0" // d) Power (not supported by V800 yet).
+            "0" // e) Power Left Right Ballance (not supported by V800 yet).
+            "0" // f) Power Pedalling Index (not supported by V800 yet).
+            "0" // g) HR/CC data (available only with Polar XTrainer Plus).
+            "0" // h) US / Euro unit (always metric).
+            "0" // i) Air pressure (not available).
+            "\r\n";
+        hrm << QByteArray::fromRawData(sharedData.constData(), intervalOffset);
+        hrm << "Interval="  << (rrDataOnly ? 238 : qRound(recordInterval / 1000.0)) << "\r\n";
+        hrm << QByteArray::fromRawData(sharedData.constData() + intervalOffset,
+                                          sharedData.size() - intervalOffset);
 
         // [HRData]
-        stream << "\r\n[HRData]\r\n";
+        hrm << "\r\n[HRData]\r\n";
         if (rrDataOnly) {
-            foreach (const QVariant &sample, rrsamples) {
-                stream << sample.toUInt() << "\r\n";
+            foreach (const quint32 sample, data.rrSamples) {
+                hrm << sample << "\r\n";
             }
         } else {
-            const QVariantList altitude = samples.value(QLatin1String("altitude")).toList();
-            const QVariantList cadence  = samples.value(QLatin1String("cadence")).toList();
-            const QVariantList speed    = samples.value(QLatin1String("speed")).toList();
-            for (int index = 0; index < heartrate.length(); ++index) {
-                stream << ((index < heartrate.length())
-                    ? heartrate.at(index).toUInt() : (uint)0);
+            const SampleChannel<float>   &altitude = data.samples.altitude;
+            const SampleChannel<quint32> &cadence  = data.samples.cadence;
+            const SampleChannel<float>   &speed    = data.samples.speed;
+            for (int index = 0; index < heartrate.size(); ++index) {
+                hrm << ((index < heartrate.size())
+                    ? heartrate.at(index) : (uint)0);
                 if (haveSpeed) {
-                    stream << '\t' << ((index < speed.length())
-                        ? qRound(speed.at(index).toFloat() * 10.0) : ( int)0);
+                    hrm << '\t' << ((index < speed.size())
+                        ? qRound(speed.at(index) * 10.0) : ( int)0);
                 }
                 if (haveCadence) {
-                    stream << '\t' << ((index < cadence.length())
-                        ? cadence.at(index).toUInt() : (uint)0);
+                    hrm << '\t' << ((index < cadence.size())
+                        ? cadence.at(index) : (uint)0);
                 }
                 if (haveAltitude) {
-                    stream << '\t' << ((index < altitude.length())
-                        ? qRound(altitude.at(index).toFloat()) : ( int)0);
+                    hrm << '\t' << ((index < altitude.size())
+                        ? qRound(altitude.at(index)) : ( int)0);
                 }
                 // Power (Watts) - not yet supported by Polar.
                 // Power Balance and Pedalling Index - not yet supported by Polar.
                 // Air pressure - not available in protobuf data.
-                stream << "\r\n";
+                hrm << "\r\n";
             }
         }
 
-        hrmList.append(hrmData);
+        if (!hrm.flush()) {
+            qWarning() << "Failed to write HRM" << exerciseId
+                       << (rrDataOnly ? "R-R data" : "samples");
+            result = false;
+        }
     }
-    return hrmList;
+    return result;
 }
 
 /**
@@ -1702,109 +2394,139 @@ QStringList TrainingSession::toHRM(const bool rrDataOnly) const
  *
  * @return A TCX document representing the parsed Polar data.
  *
- * @see http://developer.garmin.com/schemas/tcx/v2/
- * @see http://www8.garmin.com/xmlschemas/TrainingCenterDatabasev2.xsd
+ * @see writeTCX(QIODevice &, const QString &)
  */
 QDomDocument TrainingSession::toTCX(const QString &buildTime) const
 {
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
     QDomDocument doc;
-    doc.appendChild(doc.createProcessingInstruction(QLatin1String("xml"),
-        QLatin1String("version='1.0' encoding='utf-8'")));
-
-    QDomElement tcx = doc.createElement(QLatin1String("TrainingCenterDatabase"));
-    tcx.setAttribute(QLatin1String("xmlns"),
-                     QLatin1String("http://www.garmin.com/xmlschemas/TrainingCenterDatabase/v2"));
-    tcx.setAttribute(QLatin1String("xmlns:xsi"),
-                     QLatin1String("http://www.w3.org/2001/XMLSchema-instance"));
-    tcx.setAttribute(QLatin1String("xsi:schemaLocation"),
-                     QLatin1String("http://www.garmin.com/xmlschemas/TrainingCenterDatabase/v2 "
-                                   "http://www.garmin.com/xmlschemas/TrainingCenterDatabasev2.xsd"));
+    if (writeTCX(buffer, buildTime)) {
+        doc.setContent(buffer.data());
+    }
+    return doc;
+}
+
+/**
+ * @brief TrainingSession::writeTCX
+ *
+ * Each Trackpoint is written to @a device as it is generated, so the document
+ * is never held in memory in its entirety.
+ *
+ * @param device    Device to write the TCX document to.
+ * @param buildTime If set, will override the internally detected build time.
+ *                  Note, this is really only here to allow for deterministic
+ *                  testing - not to be used by the final application.
+ *
+ * @return \c true on success, \c false otherwise.
+ *
+ * @see http://developer.garmin.com/schemas/tcx/v2/
+ * @see http://www8.garmin.com/xmlschemas/TrainingCenterDatabasev2.xsd
+ */
+bool TrainingSession::writeTCX(QIODevice &device, const QString &buildTime) const
+{
+    QXmlStreamWriter tcx(&device);
+    tcx.setAutoFormatting(true);
+    tcx.setAutoFormattingIndent(2);
+    tcx.writeProcessingInstruction(QLatin1String("xml"),
+        QLatin1String("version='1.0' encoding='utf-8'"));
+
+    tcx.writeStartElement(QLatin1String("TrainingCenterDatabase"));
+    tcx.writeAttribute(QLatin1String("xmlns"),
+                       QLatin1String("http://www.garmin.com/xmlschemas/TrainingCenterDatabase/v2"));
+    tcx.writeAttribute(QLatin1String("xmlns:xsi"),
+                       QLatin1String("http://www.w3.org/2001/XMLSchema-instance"));
+    tcx.writeAttribute(QLatin1String("xsi:schemaLocation"),
+                       QLatin1String("http://www.garmin.com/xmlschemas/TrainingCenterDatabase/v2 "
+                                     "http://www.garmin.com/xmlschemas/TrainingCenterDatabasev2.xsd"));
     if (tcxOptions.testFlag(GarminActivityExtension)) {
-        tcx.setAttribute(QLatin1String("xmlns:ax2"),
-                         QLatin1String("http://www.garmin.com/xmlschemas/ActivityExtension/v2"));
+        tcx.writeAttribute(QLatin1String("xmlns:ax2"),
+                           QLatin1String("http://www.garmin.com/xmlschemas/ActivityExtension/v2"));
+    }
+
+    // Since nothing can be removed once written, determine up front whether
+    // or not there will be anything to write to the Activities element.
+    const bool multiSport = ((parsedExercises.size() > 1) && (!parsedSession.isEmpty()));
+    bool haveActivities = multiSport;
+    foreach (const QVariant &exercise, parsedExercises) {
+        if (exercise.toMap().contains(CREATE)) {
+            haveActivities = true;
+        }
     }
-    doc.appendChild(tcx);
 
-    QDomElement activities = doc.createElement(QLatin1String("Activities"));
+    if (haveActivities) {
+        tcx.writeStartElement(QLatin1String("Activities"));
+    }
 
-    QDomElement multiSportSession;
-    if ((parsedExercises.size() > 1) && (!parsedSession.isEmpty())) {
-        multiSportSession = doc.createElement(QLatin1String("MultiSportSession"));
+    if (multiSport) {
+        tcx.writeStartElement(QLatin1String("MultiSportSession"));
         QDateTime id = getDateTime(firstMap(parsedSession.value(QLatin1String("start"))));
         if (tcxOptions.testFlag(ForceTcxUTC)) {
             id = id.toUTC();
         }
-        multiSportSession.appendChild(doc.createElement(QLatin1String("Id")))
-            .appendChild(doc.createTextNode(id.toString(Qt::ISODate)));
-        activities.appendChild(multiSportSession);
+        tcx.writeTextElement(QLatin1String("Id"), id.toString(Qt::ISODate));
     }
 
-    foreach (const QVariant &exercise, parsedExercises) {
-        const QVariantMap map = exercise.toMap();
+    bool firstSport = true;
+    for (QVariantMap::const_iterator exercise = parsedExercises.constBegin();
+         exercise != parsedExercises.constEnd(); ++exercise) {
+        const QVariantMap map = exercise.value().toMap();
+        const ExerciseData data = exerciseData.value(exercise.key());
         if (!map.contains(CREATE)) {
             qWarning() << "Skipping exercise with no 'create' request data";
             continue;
         }
         const QVariantMap create  = map.value(CREATE).toMap();
-        const QVariantMap route   = map.value(ROUTE).toMap();
         const QVariantMap samples = map.value(SAMPLES).toMap();
         const quint64 recordInterval = getDuration(
             firstMap(samples.value(QLatin1String("record-interval"))));
 
         // Get the "samples" samples.
-        const QVariantList altitude    = samples.value(QLatin1String("altitude")).toList();
-        const QVariantList cadence     = samples.value(QLatin1String("cadence")).toList();
-        const QVariantList distance    = samples.value(QLatin1String("distance")).toList();
-        const QVariantList heartrate   = samples.value(QLatin1String("heartrate")).toList();
-        const QVariantList speed       = samples.value(QLatin1String("speed")).toList();
-        const QVariantList temperature = samples.value(QLatin1String("temperature")).toList();
+        const SampleChannel<float>   &altitude  = data.samples.altitude;
+        const SampleChannel<quint32> &cadence   = data.samples.cadence;
+        const SampleChannel<float>   &distance  = data.samples.distance;
+        const SampleChannel<quint32> &heartrate = data.samples.heartrate;
+        const SampleChannel<float>   &speed     = data.samples.speed;
 
         // Get the "route" samples.
-        const QVariantList duration    = route.value(QLatin1String("duration")).toList();
-        const QVariantList gpsAltitude = route.value(QLatin1String("altitude")).toList();
-        const QVariantList latitude    = route.value(QLatin1String("latitude")).toList();
-        const QVariantList longitude   = route.value(QLatin1String("longitude")).toList();
-        const QVariantList satellites  = route.value(QLatin1String("satellites")).toList();
+        const SampleChannel<quint32> &duration    = data.route.duration;
+        const SampleChannel<qint32>  &gpsAltitude = data.route.altitude;
+        const SampleChannel<double>  &latitude    = data.route.latitude;
+        const SampleChannel<double>  &longitude   = data.route.longitude;
+        const SampleChannel<quint32> &satellites  = data.route.satellites;
 
         const int maxIndex =
-            qMax(altitude.length(),
-            qMax(cadence.length(),
-            qMax(distance.length(),
-            qMax(heartrate.length(),
-            qMax(speed.length(),
-          //qMax(temperature.length(), // We don't use temperature in TCX yet.
-            qMax(duration.length(),
-            qMax(gpsAltitude.length(),
-            qMax(latitude.length(),
-            qMax(longitude.length(),
-            qMax(satellites.length(), 0))))))))));
-
-        QDomElement activity = doc.createElement(QLatin1String("Activity"));
-        if (multiSportSession.isNull()) {
-            activities.appendChild(activity);
-        } else if (multiSportSession.childNodes().length() <= 1) {
-            multiSportSession
-                .appendChild(doc.createElement(QLatin1String("FirstSport")))
-                .appendChild(activity);
-        } else {
-            multiSportSession
-                .appendChild(doc.createElement(QLatin1String("NextSport")))
-                .appendChild(activity);
+            qMax(altitude.size(),
+            qMax(cadence.size(),
+            qMax(distance.size(),
+            qMax(heartrate.size(),
+            qMax(speed.size(),
+          //qMax(temperature.size(), // We don't use temperature in TCX yet.
+            qMax(duration.size(),
+            qMax(gpsAltitude.size(),
+            qMax(latitude.size(),
+            qMax(longitude.size(),
+            qMax(satellites.size(), 0))))))))));
+
+        if (multiSport) {
+            tcx.writeStartElement(firstSport ? QLatin1String("FirstSport")
+                                             : QLatin1String("NextSport"));
+            firstSport = false;
         }
-        Q_ASSERT(!activity.parentNode().isNull());
+        tcx.writeStartElement(QLatin1String("Activity"));
 
         // Get the sport type.
-        activity.setAttribute(QLatin1String("Sport"),
-            getTcxSport(first(firstMap(create.value(QLatin1String("sport")))
-                .value(QLatin1String("value"))).toULongLong()));
+        const quint64 polarSport = first(firstMap(create.value(QLatin1String("sport")))
+            .value(QLatin1String("value"))).toULongLong();
+        tcx.writeAttribute(QLatin1String("Sport"), getTcxSport(polarSport));
+        const QString cadenceSensor = getTcxCadenceSensor(polarSport);
 
         // Get the starting time.
         QDateTime startTime = getDateTime(firstMap(create.value(QLatin1String("start"))));
         if (tcxOptions.testFlag(ForceTcxUTC)) {
             startTime = startTime.toUTC();
         }
-        activity.appendChild(doc.createElement(QLatin1String("Id")))
-            .appendChild(doc.createTextNode(startTime.toString(Qt::ISODate)));
+        tcx.writeTextElement(QLatin1String("Id"), startTime.toString(Qt::ISODate));
 
         // Build a map of lap split times to lap data.
         QVariantList laps = map.value(LAPS).toMap().value(QLatin1String("laps")).toList();
@@ -1823,25 +2545,29 @@ QDomDocument TrainingSession::toTCX(const QString &buildTime) const
         }
 
         // Add each of the laps to the Activity element.
-        QDomElement lap;
+        bool inLap = false;
         QVariantMap base = create; // The base data for this lap.
         QVariantMap stats = map.value(STATISTICS).toMap();
-        QDomElement track = doc.createElement(QLatin1String("Track"));
         qint64 durationRemaining = getDuration(firstMap(create.value(QLatin1String("duration"))));
         double distanceRemaining = first(create.value(QLatin1String("distance"))).toDouble();
         for (int index = 0; index < maxIndex; ++index) {
             #if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
-            if ((lap.isNull()) || ((!splits.isEmpty()) && (index * recordInterval > splits.firstKey()))) {
+            if ((!inLap) || ((!splits.isEmpty()) && (index * recordInterval > splits.firstKey()))) {
             #else
-            if ((lap.isNull()) || ((!splits.isEmpty()) && (index * recordInterval > splits.constBegin().key()))) {
+            if ((!inLap) || ((!splits.isEmpty()) && (index * recordInterval > splits.constBegin().key()))) {
             #endif
                 double trailingDuration = 0, trailingDistance = 0;
-                if ((!lap.isNull()) && (!splits.isEmpty())) {
-                    #if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
-                    splits.remove(splits.firstKey());
-                    #else
-                    splits.remove(splits.constBegin().key());
-                    #endif
+                if (inLap) {
+                    tcx.writeEndElement(); // Track
+                    writeLapExtensions(tcx, stats, cadenceSensor);
+                    tcx.writeEndElement(); // Lap
+                    if (!splits.isEmpty()) {
+                        #if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
+                        splits.remove(splits.firstKey());
+                        #else
+                        splits.remove(splits.constBegin().key());
+                        #endif
+                    }
                 }
                 if (!splits.isEmpty()) {
                     #if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
@@ -1860,7 +2586,7 @@ QDomDocument TrainingSession::toTCX(const QString &buildTime) const
                     stats = QVariantMap();
                 }
 
-                // Create the Lap element, and set its StartTime attribute.
+                // Start the Lap element, and set its StartTime attribute.
                 #if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
                 QDateTime lapStartTime = startTime.addMSecs(index * recordInterval);
                 #else /// @todo Remove this hack when Qt 5.2+ is available on Travis CI.
@@ -1871,250 +2597,256 @@ QDomDocument TrainingSession::toTCX(const QString &buildTime) const
                 if (tcxOptions.testFlag(ForceTcxUTC)) {
                     lapStartTime = lapStartTime.toUTC();
                 }
-                lap = doc.createElement(QLatin1String("Lap"));
-                lap.setAttribute(QLatin1String("StartTime"),
+                tcx.writeStartElement(QLatin1String("Lap"));
+                tcx.writeAttribute(QLatin1String("StartTime"),
                     lapStartTime.toString(Qt::ISODate));
-                activity.appendChild(lap);
+                inLap = true;
 
                 // Add the per-lap (or per-exercise) statistics.
-                addLapStats(doc, lap, base, stats, trailingDuration / 1000.0,
-                            trailingDistance);
-
-                track = doc.createElement(QLatin1String("Track"));
-                lap.appendChild(track);
-
-                // Add any enabled extensions.
-                if (tcxOptions.testFlag(GarminActivityExtension)) {
-                    QDomElement extensions = doc.createElement(QLatin1String("Extensions"));
-                    lap.appendChild(extensions);
-
-                    // Add the Garmin Activity Extension.
-                    if (tcxOptions.testFlag(GarminActivityExtension)) {
-                        QDomElement lx = doc.createElement(QLatin1String("LX"));
-                        lx.setAttribute(QLatin1String("xmlns"),
-                            QLatin1String("http://www.garmin.com/xmlschemas/ActivityExtension/v2"));
-                        extensions.appendChild(lx);
-
-                        if (stats.contains(QLatin1String("speed"))) {
-                            lx.appendChild(doc.createElement(QLatin1String("AvgSpeed")))
-                                .appendChild(doc.createTextNode(QString::fromLatin1("%1")
-                                    .arg(first(firstMap(stats.value(QLatin1String("speed")))
-                                        .value(QLatin1String("average"))).toDouble())));
-                        }
-
-                        if (stats.contains(QLatin1String("cadence"))) {
-                            const QVariantMap cadence = firstMap(stats.value(QLatin1String("cadence")));
-
-                            const QString sensor = getTcxCadenceSensor(
-                                first(firstMap(create.value(QLatin1String("sport")))
-                                                .value(QLatin1String("value"))).toULongLong());
-
-                            if (sensor != QLatin1String("Footpod")) {
-                                lx.appendChild(doc.createElement(QLatin1String("MaxBikeCadence")))
-                                    .appendChild(doc.createTextNode(QString::fromLatin1("%1")
-                                        .arg(first(cadence.value(QLatin1String("maximum"))).toUInt())));
-                            }
-
-                            lx.appendChild(doc.createElement(QLatin1String("AvgRunCadence")))
-                                .appendChild(doc.createTextNode(QString::fromLatin1("%1")
-                                    .arg(first(cadence.value(QLatin1String("average"))).toUInt())));
-
-                            if (sensor == QLatin1String("Footpod")) {
-                                lx.appendChild(doc.createElement(QLatin1String("MaxRunCadence")))
-                                    .appendChild(doc.createTextNode(QString::fromLatin1("%1")
-                                        .arg(first(cadence.value(QLatin1String("maximum"))).toUInt())));
-                            }
-
-                            /// @todo AvgWatts and MaxWatts when power data is available.
-                        }
-                    }
-                }
-            }
+                writeLapStats(tcx, base, stats, trailingDuration / 1000.0,
+                              trailingDistance);
 
-            QDomElement trackPoint = doc.createElement(QLatin1String("Trackpoint"));
+                tcx.writeStartElement(QLatin1String("Track"));
+            }
 
-            if ((index < latitude.length()) && (index < longitude.length())) {
-                QDomElement position = doc.createElement(QLatin1String("Position"));
-                position.appendChild(doc.createElement(QLatin1String("LatitudeDegrees")))
-                    .appendChild(doc.createTextNode(latitude.at(index).toString()));
-                position.appendChild(doc.createElement(QLatin1String("LongitudeDegrees")))
-                    .appendChild(doc.createTextNode(longitude.at(index).toString()));
-                trackPoint.appendChild(position);
+            // Work out which of the Trackpoint's children are present, since
+            // empty Trackpoint elements are to be omitted altogether.
+            const bool havePosition =
+                ((index < latitude.size()) && (index < longitude.size()));
+            const bool haveAltitude = ((index < altitude.size()) &&
+                (!altitude.isOffline(index)));
+            const bool haveDistance = ((index < distance.size()) &&
+                (!distance.isOffline(index)));
+            const bool haveHeartrate = ((index < heartrate.size()) &&
+                (static_cast<qint32>(heartrate.at(index)) > 0) &&
+                (!heartrate.isOffline(index)));
+            const bool haveCadence = ((index < cadence.size()) &&
+                (static_cast<qint32>(cadence.at(index)) >= 0) &&
+                (!cadence.isOffline(index)));
+            const bool haveSpeed = ((index < cadence.size()) &&
+                (static_cast<qint32>(cadence.at(index)) >= 0) &&
+                (!speed.isOffline(index)));
+
+            if ((!havePosition) && (!haveAltitude) && (!haveDistance) &&
+                (!haveHeartrate) && (!haveCadence) &&
+                (!tcxOptions.testFlag(GarminActivityExtension))) {
+                continue;
             }
 
-            if ((index < altitude.length()) &&
-                (!sensorOffline(samples.value(QLatin1String("altitude-offline")).toList(), index))) {
-                trackPoint.appendChild(doc.createElement(QLatin1String("AltitudeMeters")))
-                    .appendChild(doc.createTextNode(altitude.at(index).toString()));
+            tcx.writeStartElement(QLatin1String("Trackpoint"));
+
+            #if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
+            QDateTime trackPointTime = startTime.addMSecs(index * recordInterval);
+            #else /// @todo Remove this hack when Qt 5.2+ is available on Travis CI.
+            QDateTime trackPointTime = startTime.toUTC()
+                .addMSecs(index * recordInterval).addSecs(startTime.utcOffset());
+            trackPointTime.setUtcOffset(startTime.utcOffset());
+            #endif
+            if (tcxOptions.testFlag(ForceTcxUTC)) {
+                trackPointTime = trackPointTime.toUTC();
+            }
+            tcx.writeTextElement(QLatin1String("Time"), trackPointTime.toString(Qt::ISODate));
+
+            if (havePosition) {
+                tcx.writeStartElement(QLatin1String("Position"));
+                tcx.writeTextElement(QLatin1String("LatitudeDegrees"),
+                                     latitude.toString(index));
+                tcx.writeTextElement(QLatin1String("LongitudeDegrees"),
+                                     longitude.toString(index));
+                tcx.writeEndElement(); // Position
             }
-            if ((index < distance.length()) &&
-                (!sensorOffline(samples.value(QLatin1String("distance-offline")).toList(), index))) {
-                trackPoint.appendChild(doc.createElement(QLatin1String("DistanceMeters")))
-                    .appendChild(doc.createTextNode(distance.at(index).toString()));
+            if (haveAltitude) {
+                tcx.writeTextElement(QLatin1String("AltitudeMeters"),
+                                     altitude.toString(index));
             }
-            if ((index < heartrate.length()) && (heartrate.at(index).toInt() > 0) &&
-                (!sensorOffline(samples.value(QLatin1String("heartrate-offline")).toList(), index))) {
-                trackPoint.appendChild(doc.createElement(QLatin1String("HeartRateBpm")))
-                    .appendChild(doc.createElement(QLatin1String("Value")))
-                    .appendChild(doc.createTextNode(heartrate.at(index).toString()));
+            if (haveDistance) {
+                tcx.writeTextElement(QLatin1String("DistanceMeters"),
+                                     distance.toString(index));
             }
-            if ((index < cadence.length()) && (cadence.at(index).toInt() >= 0) &&
-                (!sensorOffline(samples.value(QLatin1String("cadence-offline")).toList(), index))) {
-                trackPoint.appendChild(doc.createElement(QLatin1String("Cadence")))
-                    .appendChild(doc.createTextNode(cadence.at(index).toString()));
+            if (haveHeartrate) {
+                tcx.writeStartElement(QLatin1String("HeartRateBpm"));
+                tcx.writeTextElement(QLatin1String("Value"), heartrate.toString(index));
+                tcx.writeEndElement(); // HeartRateBpm
+            }
+            if (haveCadence) {
+                tcx.writeTextElement(QLatin1String("Cadence"), cadence.toString(index));
             }
 
             if (tcxOptions.testFlag(GarminActivityExtension)) {
-                QDomElement tpx = doc.createElement(QLatin1String("TPX"));
-                tpx.setAttribute(QLatin1String("xmlns"),
+                tcx.writeStartElement(QLatin1String("Extensions"));
+                tcx.writeStartElement(QLatin1String("TPX"));
+                tcx.writeAttribute(QLatin1String("xmlns"),
                     QLatin1String("http://www.garmin.com/xmlschemas/ActivityExtension/v2"));
-                trackPoint.appendChild(doc.createElement(QLatin1String("Extensions")))
-                    .appendChild(tpx);
-
-                if ((index < cadence.length()) && (cadence.at(index).toInt() >= 0) &&
-                    (!sensorOffline(samples.value(QLatin1String("speed-offline")).toList(), index))) {
-                    tpx.appendChild(doc.createElement(QLatin1String("Speed")))
-                        .appendChild(doc.createTextNode(speed.at(index).toString()));
+                if ((haveCadence) && (!cadenceSensor.isEmpty())) {
+                    tcx.writeAttribute(QLatin1String("CadenceSensor"), cadenceSensor);
                 }
-
-                if ((index < cadence.length()) && (cadence.at(index).toInt() >= 0) &&
-                    (!sensorOffline(samples.value(QLatin1String("cadence-offline")).toList(), index))) {
-                    const QString sensor = getTcxCadenceSensor(
-                        first(firstMap(create.value(QLatin1String("sport")))
-                                        .value(QLatin1String("value"))).toULongLong());
-                    if (!sensor.isEmpty()) {
-                        tpx.setAttribute(QLatin1String("CadenceSensor"), sensor);
-                    }
-                    if (sensor == QLatin1String("Footpod")) {
-                        tpx.appendChild(doc.createElement(QLatin1String("RunCadence")))
-                            .appendChild(doc.createTextNode(cadence.at(index).toString()));
-                    }
+                if (haveSpeed) {
+                    tcx.writeTextElement(QLatin1String("Speed"), speed.toString(index));
                 }
-            }
-
-            if (trackPoint.hasChildNodes()) {
-                #if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
-                QDateTime trackPointTime = startTime.addMSecs(index * recordInterval);
-                #else /// @todo Remove this hack when Qt 5.2+ is available on Travis CI.
-                QDateTime trackPointTime = startTime.toUTC()
-                    .addMSecs(index * recordInterval).addSecs(startTime.utcOffset());
-                trackPointTime.setUtcOffset(startTime.utcOffset());
-                #endif
-                if (tcxOptions.testFlag(ForceTcxUTC)) {
-                    trackPointTime = trackPointTime.toUTC();
+                if ((haveCadence) && (cadenceSensor == QLatin1String("Footpod"))) {
+                    tcx.writeTextElement(QLatin1String("RunCadence"),
+                                         cadence.toString(index));
                 }
-                trackPoint.insertBefore(doc.createElement(QLatin1String("Time")), QDomNode())
-                    .appendChild(doc.createTextNode(trackPointTime.toString(Qt::ISODate)));
-                track.appendChild(trackPoint);
+                tcx.writeEndElement(); // TPX
+                tcx.writeEndElement(); // Extensions
             }
+
+            tcx.writeEndElement(); // Trackpoint
+        }
+
+        if (inLap) {
+            tcx.writeEndElement(); // Track
+            writeLapExtensions(tcx, stats, cadenceSensor);
+            tcx.writeEndElement(); // Lap
+        }
+
+        tcx.writeEndElement(); // Activity
+        if (multiSport) {
+            tcx.writeEndElement(); // FirstSport / NextSport
         }
     }
 
-    if ((multiSportSession.hasChildNodes()) ||
-        (multiSportSession.isNull() && activities.hasChildNodes())) {
-        tcx.appendChild(activities);
+    if (multiSport) {
+        tcx.writeEndElement(); // MultiSportSession
+    }
+    if (haveActivities) {
+        tcx.writeEndElement(); // Activities
     }
 
     {
-        QDomElement author = doc.createElement(QLatin1String("Author"));
-        author.setAttribute(QLatin1String("xsi:type"), QLatin1String("Application_t"));
-        author.appendChild(doc.createElement(QLatin1String("Name")))
-            .appendChild(doc.createTextNode(QLatin1String("Bipolar")));
-        tcx.appendChild(author);
+        tcx.writeStartElement(QLatin1String("Author"));
+        tcx.writeAttribute(QLatin1String("xsi:type"), QLatin1String("Application_t"));
+        tcx.writeTextElement(QLatin1String("Name"), QLatin1String("Bipolar"));
 
         {
-            QDomElement build = doc.createElement(QLatin1String("Build"));
-            author.appendChild(build);
-            QDomElement version = doc.createElement(QLatin1String("Version"));
-            build.appendChild(version);
-            QStringList versionParts = QApplication::applicationVersion().split(QLatin1Char('.'));
+            tcx.writeStartElement(QLatin1String("Build"));
+            tcx.writeStartElement(QLatin1String("Version"));
+            QStringList versionParts = QCoreApplication::applicationVersion().split(QLatin1Char('.'));
             while (versionParts.length() < 4) {
                 versionParts.append(QLatin1String("0"));
             }
-            version.appendChild(doc.createElement(QLatin1String("VersionMajor")))
-                .appendChild(doc.createTextNode(versionParts.at(0)));
-            version.appendChild(doc.createElement(QLatin1String("VersionMinor")))
-                .appendChild(doc.createTextNode(versionParts.at(1)));
-            version.appendChild(doc.createElement(QLatin1String("BuildMajor")))
-                .appendChild(doc.createTextNode(versionParts.at(2)));
-            version.appendChild(doc.createElement(QLatin1String("BuildMinor")))
-                .appendChild(doc.createTextNode(versionParts.at(3)));
+            tcx.writeTextElement(QLatin1String("VersionMajor"), versionParts.at(0));
+            tcx.writeTextElement(QLatin1String("VersionMinor"), versionParts.at(1));
+            tcx.writeTextElement(QLatin1String("BuildMajor"), versionParts.at(2));
+            tcx.writeTextElement(QLatin1String("BuildMinor"), versionParts.at(3));
+            tcx.writeEndElement(); // Version
             QString buildType = QLatin1String("Release");
             VersionInfo versionInfo;
             const QString specialBuild = versionInfo.fileInfo(QLatin1String("SpecialBuild"));
             if (!specialBuild.isEmpty()) {
                 buildType = specialBuild;
             }
-            build.appendChild(doc.createElement(QLatin1String("Type")))
-                .appendChild(doc.createTextNode(buildType));
-            build.appendChild(doc.createElement(QLatin1String("Time")))
-                .appendChild(doc.createTextNode(
-                    buildTime.isEmpty() ? QString::fromLatin1(__DATE__" "__TIME__) : buildTime));
+            tcx.writeTextElement(QLatin1String("Type"), buildType);
+            tcx.writeTextElement(QLatin1String("Time"),
+                buildTime.isEmpty() ? QString::fromLatin1(__DATE__" "__TIME__) : buildTime);
             #ifdef BUILD_USER
             #define BIPOLAR_STRINGIFY(string) #string
             #define BIPOLAR_EXPAND_AND_STRINGIFY(macro) BIPOLAR_STRINGIFY(macro)
-            build.appendChild(doc.createElement(QLatin1String("Builder")))
-                .appendChild(doc.createTextNode(QLatin1String(
-                    BIPOLAR_EXPAND_AND_STRINGIFY(BUILD_USER))));
+            tcx.writeTextElement(QLatin1String("Builder"), QLatin1String(
+                BIPOLAR_EXPAND_AND_STRINGIFY(BUILD_USER)));
             #undef BIPOLAR_EXPAND_AND_STRINGIFY
             #undef BIPOLAR_STRINGIFY
             #endif
+            tcx.writeEndElement(); // Build
         }
 
         /// @todo  Make this dynamic if/when app is localized.
-        author.appendChild(doc.createElement(QLatin1String("LangID")))
-            .appendChild(doc.createTextNode(QLatin1String("EN")));
-        author.appendChild(doc.createElement(QLatin1String("PartNumber")))
-            .appendChild(doc.createTextNode(QLatin1String("434-F4C42-59")));
+        tcx.writeTextElement(QLatin1String("LangID"), QLatin1String("EN"));
+        tcx.writeTextElement(QLatin1String("PartNumber"), QLatin1String("434-F4C42-59"));
+        tcx.writeEndElement(); // Author
     }
-    return doc;
+
+    tcx.writeEndElement(); // TrainingCenterDatabase
+    tcx.writeEndDocument();
+    if (tcx.hasError()) {
+        qWarning() << "Failed to write TCX" << baseName;
+        return false;
+    }
+    return true;
+}
+
+void TrainingSession::writeLapExtensions(QXmlStreamWriter &tcx,
+                                         const QVariantMap &stats,
+                                         const QString &cadenceSensor) const
+{
+    if (!tcxOptions.testFlag(GarminActivityExtension)) {
+        return;
+    }
+    tcx.writeStartElement(QLatin1String("Extensions"));
+
+    // Add the Garmin Activity Extension.
+    tcx.writeStartElement(QLatin1String("LX"));
+    tcx.writeAttribute(QLatin1String("xmlns"),
+        QLatin1String("http://www.garmin.com/xmlschemas/ActivityExtension/v2"));
+
+    if (stats.contains(QLatin1String("speed"))) {
+        tcx.writeTextElement(QLatin1String("AvgSpeed"), QString::fromLatin1("%1")
+            .arg(first(firstMap(stats.value(QLatin1String("speed")))
+                .value(QLatin1String("average"))).toDouble()));
+    }
+
+    if (stats.contains(QLatin1String("cadence"))) {
+        const QVariantMap cadence = firstMap(stats.value(QLatin1String("cadence")));
+
+        if (cadenceSensor != QLatin1String("Footpod")) {
+            tcx.writeTextElement(QLatin1String("MaxBikeCadence"), QString::fromLatin1("%1")
+                .arg(first(cadence.value(QLatin1String("maximum"))).toUInt()));
+        }
+
+        tcx.writeTextElement(QLatin1String("AvgRunCadence"), QString::fromLatin1("%1")
+            .arg(first(cadence.value(QLatin1String("average"))).toUInt()));
+
+        if (cadenceSensor == QLatin1String("Footpod")) {
+            tcx.writeTextElement(QLatin1String("MaxRunCadence"), QString::fromLatin1("%1")
+                .arg(first(cadence.value(QLatin1String("maximum"))).toUInt()));
+        }
+
+        /// @todo AvgWatts and MaxWatts when power data is available.
+    }
+
+    tcx.writeEndElement(); // LX
+    tcx.writeEndElement(); // Extensions
 }
 
-void TrainingSession::addLapStats(QDomDocument &doc, QDomElement &lap,
-                                  const QVariantMap &base,
-                                  const QVariantMap &stats,
-                                  const double duration,
-                                  const double distance) const
+void TrainingSession::writeLapStats(QXmlStreamWriter &tcx,
+                                    const QVariantMap &base,
+                                    const QVariantMap &stats,
+                                    const double duration,
+                                    const double distance) const
 {
-    lap.appendChild(doc.createElement(QLatin1String("TotalTimeSeconds")))
-        .appendChild(doc.createTextNode(QString::fromLatin1("%1").arg(qMax(
-            duration, getDuration(firstMap(base.value(QLatin1String("duration"))))/1000.0))));
-    lap.appendChild(doc.createElement(QLatin1String("DistanceMeters")))
-        .appendChild(doc.createTextNode(QString::fromLatin1("%1").arg(qMax(
-            distance, first(base.value(QLatin1String("distance"))).toDouble()))));
+    tcx.writeTextElement(QLatin1String("TotalTimeSeconds"), QString::fromLatin1("%1").arg(qMax(
+        duration, getDuration(firstMap(base.value(QLatin1String("duration"))))/1000.0)));
+    tcx.writeTextElement(QLatin1String("DistanceMeters"), QString::fromLatin1("%1").arg(qMax(
+        distance, first(base.value(QLatin1String("distance"))).toDouble())));
     if (stats.contains(QLatin1String("speed"))) {
-        lap.appendChild(doc.createElement(QLatin1String("MaximumSpeed")))
-            .appendChild(doc.createTextNode(QString::fromLatin1("%1")
-                .arg(first(firstMap(stats.value(QLatin1String("speed")))
-                    .value(QLatin1String("maximum"))).toDouble())));
+        tcx.writeTextElement(QLatin1String("MaximumSpeed"), QString::fromLatin1("%1")
+            .arg(first(firstMap(stats.value(QLatin1String("speed")))
+                .value(QLatin1String("maximum"))).toDouble()));
     }
 
     // Calories is only available per exercise, not per lap, but it is required
     // by the TCX schema, so the following will set it to 0, if not present.
-    lap.appendChild(doc.createElement(QLatin1String("Calories")))
-        .appendChild(doc.createTextNode(QString::fromLatin1("%1")
-            .arg(first(base.value(QLatin1String("calories"))).toUInt())));
+    tcx.writeTextElement(QLatin1String("Calories"), QString::fromLatin1("%1")
+        .arg(first(base.value(QLatin1String("calories"))).toUInt()));
 
     const QVariantMap hrStats = firstMap(stats.value(QLatin1String("heartrate")));
     if (!hrStats.isEmpty()) {
-        lap.appendChild(doc.createElement(QLatin1String("AverageHeartRateBpm")))
-            .appendChild(doc.createElement(QLatin1String("Value")))
-                .appendChild(doc.createTextNode(QString::fromLatin1("%1")
-                    .arg(first(hrStats.value(QLatin1String("average"))).toUInt())));
-        lap.appendChild(doc.createElement(QLatin1String("MaximumHeartRateBpm")))
-            .appendChild(doc.createElement(QLatin1String("Value")))
-                .appendChild(doc.createTextNode(QString::fromLatin1("%1")
-                    .arg(first(hrStats.value(QLatin1String("maximum"))).toUInt())));
+        tcx.writeStartElement(QLatin1String("AverageHeartRateBpm"));
+        tcx.writeTextElement(QLatin1String("Value"), QString::fromLatin1("%1")
+            .arg(first(hrStats.value(QLatin1String("average"))).toUInt()));
+        tcx.writeEndElement(); // AverageHeartRateBpm
+        tcx.writeStartElement(QLatin1String("MaximumHeartRateBpm"));
+        tcx.writeTextElement(QLatin1String("Value"), QString::fromLatin1("%1")
+            .arg(first(hrStats.value(QLatin1String("maximum"))).toUInt()));
+        tcx.writeEndElement(); // MaximumHeartRateBpm
     }
     /// @todo Intensity must be one of: Active, Resting.
-    lap.appendChild(doc.createElement(QLatin1String("Intensity")))
-        .appendChild(doc.createTextNode(QString::fromLatin1("Active")));
+    tcx.writeTextElement(QLatin1String("Intensity"), QLatin1String("Active"));
 
     if (stats.contains(QLatin1String("cadence"))) {
-        lap.appendChild(doc.createElement(QLatin1String("Cadence")))
-            .appendChild(doc.createTextNode(QString::fromLatin1("%1")
-                .arg(first(firstMap(stats.value(QLatin1String("cadence")))
-                    .value(QLatin1String("average"))).toUInt())));
+        tcx.writeTextElement(QLatin1String("Cadence"), QString::fromLatin1("%1")
+            .arg(first(firstMap(stats.value(QLatin1String("cadence")))
+                .value(QLatin1String("average"))).toUInt()));
     }
 
     // TriggerMethod must be one of: Manual, Distance, Location, Time, HeartRate.
@@ -2125,52 +2857,7 @@ void TrainingSession::addLapStats(QDomDocument &doc, QDomElement &lap,
     case 3:  triggerMethod = QLatin1String("Location"); break; // LOCATION -> Location
     default: triggerMethod = QLatin1String("Manual");
     }
-    lap.appendChild(doc.createElement(QLatin1String("TriggerMethod")))
-        .appendChild(doc.createTextNode(triggerMethod));
-}
-
-QByteArray TrainingSession::unzip(const QByteArray &data,
-                                  const int initialBufferSize) const
-{
-    Q_ASSERT(initialBufferSize > 0);
-    QByteArray result;
-    result.resize(initialBufferSize);
-
-    // Prepare a zlib stream structure.
-    z_stream stream = {};
-    stream.next_in = (Bytef *) data.data();
-    stream.avail_in = data.length();
-    stream.next_out = (Bytef *) result.data();
-    stream.avail_out = result.size();
-    stream.zalloc = Z_NULL;
-    stream.zfree = Z_NULL;
-    stream.opaque = Z_NULL;
-
-    // Decompress the data.
-    int z_result;
-    for (z_result = inflateInit2(&stream, 15 + 32); z_result == Z_OK;) {
-        if ((z_result = inflate(&stream, Z_SYNC_FLUSH)) == Z_OK) {
-            const int oldSize = result.size();
-            result.resize(result.size() * 2);
-            stream.next_out = (Bytef *)(result.data() + oldSize);
-            stream.avail_out = oldSize;
-        }
-    }
-
-    // Check for errors.
-    if (z_result != Z_STREAM_END) {
-        qWarning() << "zlib error" << z_result << stream.msg;
-        return QByteArray();
-    }
-
-    // Free any allocated resources.
-    if ((z_result = inflateEnd(&stream)) != Z_OK) {
-        qWarning() << "inflateEnd returned" << z_result << stream.msg;
-    }
-
-    // Return the decompressed data.
-    result.chop(stream.avail_out);
-    return result;
+    tcx.writeTextElement(QLatin1String("TriggerMethod"), triggerMethod);
 }
 
 QString TrainingSession::writeGPX(const QString &fileNameFormat,
@@ -2195,17 +2882,6 @@ bool TrainingSession::writeGPX(const QString &fileName) const
     return writeGPX(file);
 }
 
-bool TrainingSession::writeGPX(QIODevice &device) const
-{
-    QDomDocument gpx = toGPX();
-    if (gpx.isNull()) {
-        qWarning() << "Failed to convert to GPX" << baseName;
-        return false;
-    }
-    device.write(gpx.toByteArray());
-    return true;
-}
-
 QStringList TrainingSession::writeHRM(const QString &fileNameFormat,
                                       QString outputDirName)
 {
@@ -2218,24 +2894,44 @@ QStringList TrainingSession::writeHRM(const QString &fileNameFormat,
 
 QStringList TrainingSession::writeHRM(const QString &baseName) const
 {
+    if (parsedExercises.isEmpty()) {
+        qWarning() << "Failed to convert to HRM" << baseName;
+        return QStringList();
+    }
+
+    // Write each exercise's HRM and R-R files (if wanted) together, in one pass.
     QStringList fileNames;
-    for (int rrDataOnly = 0; rrDataOnly <= (hrmOptions.testFlag(RrFiles) ? 1 : 0); ++rrDataOnly) {
-        QStringList hrm = toHRM(rrDataOnly);
-        if (hrm.isEmpty()) {
-            qWarning() << "Failed to convert to HRM" << baseName;
-            return QStringList();
+    const QStringList exerciseIds = parsedExercises.keys();
+    for (int index = 0; index < exerciseIds.length(); ++index) {
+        const QString fileNameBase = (exerciseIds.length() == 1) ? baseName
+            : QString::fromLatin1("%1.%2").arg(baseName).arg(index);
+        QFile hrmFile(fileNameBase + QLatin1String(".hrm"));
+        QFile rrFile(fileNameBase + QLatin1String(".rr.hrm"));
+        QList<QFile *> files;
+        files << &hrmFile;
+        if (hrmOptions.testFlag(RrFiles)) {
+            files << &rrFile;
         }
 
-        for (int index = 0; index < hrm.length(); ++index) {
-            const QString extension = QLatin1String((rrDataOnly) ? "rr.hrm" : "hrm");
-            const QString fileName = (hrm.length() == 1)
-                ? QString::fromLatin1("%1.%2").arg(baseName).arg(extension)
-                : QString::fromLatin1("%1.%2.%3").arg(baseName).arg(index).arg(extension);
-            QFile file(fileName);
-            if (!file.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
-                qWarning() << "Failed to open" << QDir::toNativeSeparators(fileName);
-            } else if (file.write(hrm.at(index).toLatin1())) {
-                fileNames.append(fileName);
+        QList<QFile *> openFiles;
+        foreach (QFile * const file, files) {
+            if (file->open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+                openFiles << file;
+            } else {
+                qWarning() << "Failed to open" << QDir::toNativeSeparators(file->fileName());
+            }
+        }
+        if (openFiles.isEmpty()) {
+            continue;
+        }
+
+        writeHRM(exerciseIds.at(index),
+                 openFiles.contains(&hrmFile) ? &hrmFile : NULL,
+                 openFiles.contains(&rrFile)  ? &rrFile  : NULL);
+        foreach (QFile * const file, openFiles) {
+            file->close();
+            if (file->error() == QFileDevice::NoError) {
+                fileNames.append(file->fileName());
             }
         }
     }
@@ -2264,15 +2960,4 @@ bool TrainingSession::writeTCX(const QString &fileName) const
     return writeTCX(file);
 }
 
-bool TrainingSession::writeTCX(QIODevice &device) const
-{
-    QDomDocument tcx = toTCX();
-    if (tcx.isNull()) {
-        qWarning() << "Failed to convert to TCX" << baseName;
-        return false;
-    }
-    device.write(tcx.toByteArray());
-    return true;
-}
-
 }}
@@ -20,12 +20,18 @@
 #ifndef __POLAR_V2_TRAINING_SESSION_H__
 #define __POLAR_V2_TRAINING_SESSION_H__
 
+#include "exercisedata.h"
+#include "sessionindex.h"
+
 #include <QDateTime>
 #include <QDomDocument>
+#include <QFuture>
 #include <QIODevice>
 #include <QMap>
+#include <QPair>
 #include <QStringList>
 #include <QVariant>
+#include <QXmlStreamWriter>
 
 class TestTrainingSession;
 
@@ -63,6 +69,11 @@ public:
     };
     Q_DECLARE_FLAGS(HrmOptions, HrmOption)
 
+    enum ParseOption {
+        ConcurrentParsing = 0x0001,
+    };
+    Q_DECLARE_FLAGS(ParseOptions, ParseOption)
+
     enum TcxOption {
         ForceTcxUTC = 0x0001,
         GarminActivityExtension = 0x0100,
@@ -70,10 +81,18 @@ public:
     };
     Q_DECLARE_FLAGS(TcxOptions, TcxOption)
 
+    /// Session details used to name output files, as per getOutputBaseFileName().
+    struct OutputNaming {
+        QDateTime startTime;
+        QString sessionName;
+    };
+
     TrainingSession(const QString &baseName);
 
     int exerciseCount() const;
 
+    QString getOutputBaseFileName(const QString &format);
+    OutputNaming getOutputNaming();
     QStringList getOutputFileNames(const QString &fileNameFormat,
                                    const OutputFormats outputFormats,
                                    QString outputDirName = QString());
@@ -82,42 +101,66 @@ public:
 
     bool parse();
 
+    void setInputFiles(const SessionFiles &files);
+    void setOutputNaming(const OutputNaming &naming);
+
     void setGpxOption(const GpxOption option, const bool enabled = true);
     void setHrmOption(const HrmOption option, const bool enabled = true);
+    void setParseOption(const ParseOption option, const bool enabled = true);
     void setTcxOption(const TcxOption option, const bool enabled = true);
     void setGpxOptions(const GpxOptions options);
     void setHrmOptions(const HrmOptions options);
+    void setParseOptions(const ParseOptions options);
     void setTcxOptions(const TcxOptions options);
 
     QString writeGPX(const QString &fileNameFormat, QString outputDirName);
     bool writeGPX(const QString &fileName) const;
-    bool writeGPX(QIODevice &device) const;
+    bool writeGPX(QIODevice &device,
+                  const QDateTime &creationTime = QDateTime::currentDateTimeUtc()) const;
 
     QStringList writeHRM(const QString &fileNameFormat, QString outputDirName);
     QStringList writeHRM(const QString &baseName) const;
+    bool writeHRM(QIODevice &device, const QString &exerciseId,
+                  const bool rrDataOnly = false) const;
 
     QString writeTCX(const QString &fileNameFormat, QString outputDirName);
     bool writeTCX(const QString &fileName) const;
-    bool writeTCX(QIODevice &device) const;
+    bool writeTCX(QIODevice &device, const QString &buildTime = QString()) const;
 
 protected:
     QString baseName;
+    SessionFiles inputFiles;
+    QMap<QString, ExerciseData> exerciseData;
     QVariantMap parsedExercises;
     QVariantMap parsedPhysicalInformation;
     QVariantMap parsedSession;
+    QPair<qint64, QDateTime> parsedSessionFingerprint; ///< Size and time of the create file.
+    OutputNaming outputNaming; ///< Naming details set by setOutputNaming(), if any.
+    bool hasOutputNaming;
 
     GpxOptions gpxOptions;
     HrmOptions hrmOptions;
+    ParseOptions parseOptions;
     TcxOptions tcxOptions;
 
+    typedef QVariantMap (TrainingSession::*FileParser)(const QString &fileName) const;
+    static QStringList exerciseFileTypes();
+
+    SessionFiles getInputFiles() const;
+    static QPair<qint64, QDateTime> fingerprintFile(const QString &fileName);
+    bool isParsedSessionCurrent(const QPair<qint64, QDateTime> &fingerprint) const;
+
     static QString getTcxCadenceSensor(const quint64 &polarSportValue);
     static QString getTcxSport(const quint64 &polarSportValue);
-    QString getOutputBaseFileName(const QString &format);
 
     static bool isGzipped(const QByteArray &data);
     static bool isGzipped(QIODevice &data);
 
-    bool parse(const QString &exerciseId, const QMap<QString, QString> &fileNames);
+    bool parse(const QString &exerciseId, const QMap<QString, QString> &fileNames,
+               ExerciseData &data, const QMap<QString, QFuture<QVariantMap> > &parsing =
+                   QMap<QString, QFuture<QVariantMap> >());
+    QVariantMap parseExerciseFile(const QString &type, const QString &fileName,
+                                  ExerciseData * const data) const;
     QVariantMap parseCreateExercise(QIODevice &data) const;
     QVariantMap parseCreateExercise(const QString &fileName) const;
     QVariantMap parseCreateSession(QIODevice &data) const;
@@ -127,10 +170,13 @@ protected:
     QVariantMap parsePhysicalInformation(QIODevice &data) const;
     QVariantMap parsePhysicalInformation(const QString &fileName) const;
     QVariantMap parseRoute(QIODevice &data) const;
+    QVariantMap parseRoute(QIODevice &data, ExerciseData::Route &route) const;
     QVariantMap parseRoute(const QString &fileName) const;
     QVariantMap parseRRSamples(QIODevice &data) const;
+    QVariantMap parseRRSamples(QIODevice &data, QVector<quint32> &rrSamples) const;
     QVariantMap parseRRSamples(const QString &fileName) const;
     QVariantMap parseSamples(QIODevice &data) const;
+    QVariantMap parseSamples(QIODevice &data, ExerciseData::Samples &samples) const;
     QVariantMap parseSamples(const QString &fileName) const;
     QVariantMap parseStatistics(QIODevice &data) const;
     QVariantMap parseStatistics(const QString &fileName) const;
@@ -143,21 +189,23 @@ protected:
 
     QDomDocument toTCX(const QString &buildTime = QString()) const;
 
-    QByteArray unzip(const QByteArray &data,
-                     const int initialBufferSize = 10240) const;
-
 private:
     friend class ::TestTrainingSession;
 
-    void addLapStats(QDomDocument &doc, QDomElement &lap,
-                     const QVariantMap &base, const QVariantMap &stats,
-                     const double duration = 0, const double distance = 0) const;
+    bool writeHRM(const QString &exerciseId, QIODevice * const hrmDevice,
+                  QIODevice * const rrDevice) const;
+    void writeLapExtensions(QXmlStreamWriter &tcx, const QVariantMap &stats,
+                            const QString &cadenceSensor) const;
+    void writeLapStats(QXmlStreamWriter &tcx,
+                       const QVariantMap &base, const QVariantMap &stats,
+                       const double duration = 0, const double distance = 0) const;
 
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(TrainingSession::OutputFormats);
 Q_DECLARE_OPERATORS_FOR_FLAGS(TrainingSession::GpxOptions);
 Q_DECLARE_OPERATORS_FOR_FLAGS(TrainingSession::HrmOptions);
+Q_DECLARE_OPERATORS_FOR_FLAGS(TrainingSession::ParseOptions);
 Q_DECLARE_OPERATORS_FOR_FLAGS(TrainingSession::TcxOptions);
 
 }}
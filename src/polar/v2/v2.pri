@@ -1,6 +1,6 @@
 INCLUDEPATH += $$PWD
 VPATH += $$PWD
-HEADERS += trainingsession.h
-SOURCES += trainingsession.cpp
+HEADERS += exercisedata.h   inflatedevice.h   sessionindex.h   trainingsession.h   zonehistogram.h
+SOURCES += exercisedata.cpp inflatedevice.cpp sessionindex.cpp trainingsession.cpp zonehistogram.cpp
 
 unix:LIBS += -lz
@@ -0,0 +1,116 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "zonehistogram.h"
+
+namespace polar {
+namespace v2 {
+
+ZoneHistogram::ZoneHistogram() : totalSamples(0)
+{
+
+}
+
+/**
+ * @brief Add a zone set.
+ *
+ * Limits need not be sorted. Since a sample only reaches a limit in the ladder
+ * if it did not exceed any earlier limit, each limit is effectively clamped to
+ * the minimum of all limits before it. The resulting limits never increase, so
+ * each zone's count is simply the difference between the number of samples
+ * exceeding consecutive limits.
+ *
+ * @param limits Zone limits, in the order they are to be tested.
+ *
+ * @return The index of the new zone set, for use with counts().
+ */
+int ZoneHistogram::addZones(const QVector<quint32> &limits)
+{
+    Q_ASSERT(totalSamples == 0);
+    zoneSetOffsets.append(this->limits.size());
+    for (int index = 0; index < limits.size(); ++index) {
+        this->limits.append((index == 0) ? limits.at(index)
+                            : qMin(limits.at(index), this->limits.last()));
+        exceededCounts.append(0);
+    }
+    return zoneSetOffsets.size() - 1;
+}
+
+/**
+ * @brief Count samples against all zone sets.
+ *
+ * Samples are processed in blocks small enough to remain in cache, so each is
+ * read from memory just once, while counting the samples that exceed each limit
+ * is a branch-free reduction that compilers can readily vectorise.
+ *
+ * @param samples Contiguous samples to count.
+ * @param count   Number of samples.
+ */
+template<typename Type>
+void ZoneHistogram::addSamples(const Type * const samples, const int count)
+{
+    static const int blockSize = 1024;
+    for (int blockStart = 0; blockStart < count; blockStart += blockSize) {
+        const Type * const block = samples + blockStart;
+        const int blockCount = qMin(blockSize, count - blockStart);
+        for (int limit = 0; limit < limits.size(); ++limit) {
+            const quint32 value = limits.at(limit);
+            int exceeded = 0;
+            for (int index = 0; index < blockCount; ++index) {
+                exceeded += (static_cast<quint32>(block[index]) > value) ? 1 : 0;
+            }
+            exceededCounts[limit] += exceeded;
+        }
+    }
+    totalSamples += count;
+}
+
+/**
+ * @brief Get the number of samples in each of a zone set's zones.
+ *
+ * @param zoneSet Index of the zone set, as returned by addZones().
+ *
+ * @return One count per zone, being one more than the zone set's limits.
+ */
+QVector<int> ZoneHistogram::counts(const int zoneSet) const
+{
+    Q_ASSERT((zoneSet >= 0) && (zoneSet < zoneSetOffsets.size()));
+    const int begin = zoneSetOffsets.at(zoneSet);
+    const int end = (zoneSet + 1 < zoneSetOffsets.size())
+        ? zoneSetOffsets.at(zoneSet + 1) : limits.size();
+
+    QVector<int> counts(end - begin + 1);
+    int previous = 0;
+    for (int index = begin; index < end; ++index) {
+        counts[index - begin] = exceededCounts.at(index) - previous;
+        previous = exceededCounts.at(index);
+    }
+    counts[end - begin] = totalSamples - previous;
+    return counts;
+}
+
+int ZoneHistogram::sampleCount() const
+{
+    return totalSamples;
+}
+
+template void ZoneHistogram::addSamples(const quint16 * const samples, const int count);
+template void ZoneHistogram::addSamples(const quint32 * const samples, const int count);
+
+}}
@@ -0,0 +1,60 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __POLAR_V2_ZONE_HISTOGRAM_H__
+#define __POLAR_V2_ZONE_HISTOGRAM_H__
+
+#include <QVector>
+
+namespace polar {
+namespace v2 {
+
+/**
+ * @brief Counts samples (such as heart rates) per zone, for any number of
+ *        zone sets at once, in a single pass over the samples.
+ *
+ * Each zone set is defined by limits tested in order, just like an if/else
+ * ladder: a sample belongs to the first zone whose limit it exceeds, or to
+ * the last zone (one more than there are limits) if it exceeds none.
+ */
+class ZoneHistogram {
+
+public:
+    ZoneHistogram();
+
+    int addZones(const QVector<quint32> &limits);
+
+    template<typename Type>
+    void addSamples(const Type * const samples, const int count);
+
+    QVector<int> counts(const int zoneSet) const;
+
+    int sampleCount() const;
+
+protected:
+    QVector<quint32> limits;        ///< Non-increasing limits of all zone sets.
+    QVector<int> exceededCounts;    ///< Number of samples exceeding each limit.
+    QVector<int> zoneSetOffsets;    ///< Index of each zone set's first limit.
+    int totalSamples;
+
+};
+
+}}
+
+#endif // __POLAR_V2_ZONE_HISTOGRAM_H__
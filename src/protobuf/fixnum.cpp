@@ -19,7 +19,6 @@
 
 #include "fixnum.h"
 
-#include <QBuffer>
 #include <QDebug>
 #include <QtEndian>
 
@@ -43,11 +42,20 @@ namespace ProtoBuf {
 
 /// @tparam  Type  May be one of: qint32, quint32, qint64, quint64, float or double.
 
+template<typename Type>
+int decodeFixedNumber(const char * const begin, const char * const end, Type &value)
+{
+    Q_ASSERT((sizeof(Type) == 4) || (sizeof(Type) == 8));
+    if (end - begin < static_cast<int>(sizeof(Type))) return 0;
+    value = qFromLittleEndian<Type>(reinterpret_cast<const uchar *>(begin));
+    return sizeof(Type);
+}
+
 template<typename Type>
 QVariant parseFixedNumber(QByteArray &data) {
-    QBuffer buffer(&data);
-    buffer.open(QIODevice::ReadOnly);
-    return parseFixedNumber<Type>(buffer);
+    Type value;
+    return (decodeFixedNumber<Type>(data.constData(), data.constData() + data.size(), value) > 0)
+        ? QVariant(value) : QVariant();
 }
 
 template<typename Type>
@@ -62,9 +70,18 @@ QVariant parseFixedNumber(QIODevice &data)
 template<typename Type>
 QVariantList parseFixedNumbers(QByteArray &data, int maxItems)
 {
-    QBuffer buffer(&data);
-    buffer.open(QIODevice::ReadOnly);
-    return parseFixedNumbers<Type>(buffer, maxItems);
+    QVariantList list;
+    const char * position = data.constData();
+    const char * const end = position + data.size();
+    for (Type value; (maxItems < 0) || (list.size() < maxItems);) {
+        const int length = decodeFixedNumber<Type>(position, end, value);
+        if (length == 0) {
+            break;
+        }
+        list << QVariant(value);
+        position += length;
+    }
+    return list;
 }
 
 template<typename Type>
@@ -82,6 +99,13 @@ QVariantList parseFixedNumbers(QIODevice &data, int maxItems)
     return list;
 }
 
+template int decodeFixedNumber<double> (const char * const, const char * const, double  &);
+template int decodeFixedNumber<float>  (const char * const, const char * const, float   &);
+template int decodeFixedNumber<qint32> (const char * const, const char * const, qint32  &);
+template int decodeFixedNumber<qint64> (const char * const, const char * const, qint64  &);
+template int decodeFixedNumber<quint32>(const char * const, const char * const, quint32 &);
+template int decodeFixedNumber<quint64>(const char * const, const char * const, quint64 &);
+
 template QVariant parseFixedNumber<double> (QByteArray &);
 template QVariant parseFixedNumber<float>  (QByteArray &);
 template QVariant parseFixedNumber<qint32> (QByteArray &);
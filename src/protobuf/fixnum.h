@@ -26,6 +26,9 @@
 
 namespace ProtoBuf {
 
+template<typename Type>
+int decodeFixedNumber(const char * const begin, const char * const end, Type &value);
+
 template<typename Type>
 QVariant parseFixedNumber(QByteArray &data);
 
@@ -22,30 +22,520 @@
 #include "fixnum.h"
 #include "varint.h"
 
-#include <QBuffer>
 #include <QDebug>
+#include <QFileDevice>
+
+#include <limits>
 
 namespace ProtoBuf {
 
+namespace {
+
+// The most packed value bytes to reserve array space for up front. Lengths are
+// read from (untrusted) input, so larger fields are left to grow as decoded.
+const quint64 maxReservedLength = 64 * 1024 * 1024;
+
+template<typename Type>
+QVariant readVarint(const char * &position, const char * const end,
+                    int (*decode)(const char * const, const char * const, Type &))
+{
+    Type value;
+    const int length = decode(position, end, value);
+    if (length == 0) {
+        return QVariant();
+    }
+    position += length;
+    return value;
+}
+
+template<typename Type>
+QVariant readFixedNumber(const char * &position, const char * const end)
+{
+    Type value;
+    const int length = decodeFixedNumber<Type>(position, end, value);
+    if (length == 0) {
+        return QVariant();
+    }
+    position += length;
+    return value;
+}
+
+/**
+ * @brief Decode packed varints, narrowing each to @a Type.
+ *
+ * Decoding stops at the first value that is either invalid, or out of range
+ * for @a Type, rather than silently truncating it.
+ *
+ * @return `false` if any values were rejected.
+ */
+template<typename Type, typename DecodedType>
+bool decodePackedVarints(const char * const begin, const char * const end, QVector<Type> &values,
+                         int (*decode)(const char * const, const char * const, DecodedType &))
+{
+    // Every varint ends with exactly one byte that has its MSB clear.
+    int count = 0;
+    for (const char * byte = begin; byte < end; ++byte) {
+        if ((*byte & 0x80) == 0) {
+            ++count;
+        }
+    }
+
+    const int offset = values.size();
+    values.resize(offset + count);
+    Type * value = values.data() + offset;
+    for (const char * position = begin; position < end; ++value) {
+        DecodedType decodedValue;
+        const int length = decode(position, end, decodedValue);
+        if ((length == 0) ||
+            (static_cast<DecodedType>(static_cast<Type>(decodedValue)) != decodedValue)) {
+            values.resize(value - values.constData());
+            return false;
+        }
+        *value = static_cast<Type>(decodedValue);
+        position += length;
+    }
+    return true;
+}
+
+/**
+ * @brief Decode packed fixed-size numbers, appending them to @a values.
+ *
+ * @param remainingLength Length of the packed field from @a begin onwards,
+ *                        which may extend beyond @a end when a field is
+ *                        decoded a chunk at a time, so that its values need
+ *                        only be allocated once.
+ */
+template<typename Type>
+bool decodePackedFixedNumbers(const char * const begin, const char * const end,
+                              const quint64 remainingLength, QVector<Type> &values)
+{
+    const int count = (end - begin) / sizeof(Type);
+    const int offset = values.size();
+    const int fieldCount = offset + static_cast<int>(
+        qMin(remainingLength, maxReservedLength) / sizeof(Type));
+    if (values.capacity() < fieldCount) {
+        values.reserve(fieldCount);
+    }
+    values.resize(offset + count);
+    Type * value = values.data() + offset;
+    for (const char * position = begin; value < values.constData() + offset + count; ++value) {
+        position += decodeFixedNumber<Type>(position, end, *value);
+    }
+    return (((end - begin) % sizeof(Type)) == 0);
+}
+
+/**
+ * @brief Get the length of the whole packed values at the start of a chunk.
+ *
+ * @return The number of bytes from @a begin that hold complete values, so
+ *         any value split across chunks can be carried over to the next.
+ */
+int completePackedLength(const char * const begin, const char * const end,
+                         const Types::ScalarType scalarType)
+{
+    const int length = end - begin;
+    switch (Types::getWireType(scalarType)) {
+    case Types::ThirtyTwoBit: return length - (length % 4);
+    case Types::SixtyFourBit: return length - (length % 8);
+    default: // Every varint ends with exactly one byte that has its MSB clear.
+        for (const char * byte = end; byte > begin; --byte) {
+            if ((*(byte - 1) & 0x80) == 0) {
+                return byte - begin;
+            }
+        }
+        return 0;
+    }
+}
+
+bool isPackedArrayType(const Types::ScalarType scalarType)
+{
+    switch (scalarType) {
+    case Types::Uint32:     case Types::Fixed32:
+    case Types::Int32:      case Types::Sint32:
+    case Types::Sfixed32:   case Types::Enumerator:
+    case Types::Float:      case Types::Double:
+        return true;
+    default:
+        return false;
+    }
+}
+
+QByteArray readRawBytes(const char * &position, const char * const end, const int size)
+{
+    const int length = qMin(size, static_cast<int>(end - position));
+    const QByteArray bytes(position, length);
+    position += length;
+    return bytes;
+}
+
+/// Map the unread remainder of @a data into memory, if it is a (local) file.
+uchar * mapRemaining(QIODevice &data, qint64 &size)
+{
+    QFileDevice * const file = qobject_cast<QFileDevice *>(&data);
+    if ((file == NULL) || (file->isSequential())) {
+        return NULL;
+    }
+    size = file->size() - file->pos();
+    return (size > 0) ? file->map(file->pos(), size) : NULL;
+}
+
+}
+
+/**
+ * @brief A window onto a device's data, read a chunk at a time as consumed.
+ *
+ * Only data not yet consumed is kept, so memory is bounded by the chunk size,
+ * plus the largest single value that must be buffered whole.
+ */
+class Message::StreamBuffer {
+
+public:
+    StreamBuffer(QIODevice &device, const int chunkSize = 65536)
+        : device(device), chunkSize(chunkSize), offset(0)
+    {
+        buffer.reserve(chunkSize);
+    }
+
+    const char * begin() const { return buffer.constData() + offset; }
+    const char * end() const { return buffer.constData() + buffer.size(); }
+    int size() const { return buffer.size() - offset; }
+
+    void consume(const int length)
+    {
+        Q_ASSERT(length <= size());
+        offset += length;
+    }
+
+    /**
+     * @brief Read from the device until at least @a required bytes are buffered.
+     *
+     * @return `false` if the device ended first.
+     */
+    bool fill(const int required)
+    {
+        if (size() >= required) {
+            return true;
+        }
+        buffer.remove(0, offset); // Note, keeps the reserved capacity.
+        offset = 0;
+        while (buffer.size() < required) {
+            // Read into any spare capacity, otherwise grow by at most double,
+            // so that corrupt lengths cannot force huge allocations up front.
+            const int size = buffer.size();
+            const int readSize = qMax(buffer.capacity() - size,
+                                      qMin(required - size, qMax(size, chunkSize)));
+            buffer.resize(size + readSize);
+            const qint64 count = device.read(buffer.data() + size, readSize);
+            buffer.resize(size + static_cast<int>(qMax(count, Q_INT64_C(0))));
+            if (count <= 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Buffer the whole of the next value of the given wire type.
+     *
+     * Groups (deprecated) have no length prefix, so for those, the remainder
+     * of the device is buffered instead.
+     *
+     * @return `false` if the value is truncated (or its length is invalid).
+     */
+    bool fillValue(const quint8 wireType)
+    {
+        switch (wireType) {
+        case Types::Varint:       return (varintLength() > 0);
+        case Types::SixtyFourBit: return fill(8);
+        case Types::ThirtyTwoBit: return fill(4);
+        case Types::LengthDelimeted: {
+            const int prefixLength = varintLength();
+            quint64 length;
+            if ((prefixLength == 0) || (decodeUnsignedVarint(begin(), end(), length) == 0) ||
+                (length > static_cast<quint64>(std::numeric_limits<int>::max() - prefixLength))) {
+                return false;
+            }
+            return fill(prefixLength + static_cast<int>(length));
+        }
+        case Types::StartGroup:
+            while (fill(size() + 1)) { }
+            return true;
+        default:
+            return true; // Invalid wire types are reported by parseValue.
+        }
+    }
+
+    /**
+     * @brief Buffer the whole of the next varint.
+     *
+     * @return The varint's length, or 0 if it is truncated (or too long).
+     */
+    int varintLength()
+    {
+        for (int length = 1; length <= 10; ++length) {
+            if (!fill(length)) {
+                return 0;
+            }
+            if ((*(begin() + length - 1) & 0x80) == 0) {
+                return length;
+            }
+        }
+        return 0;
+    }
+
+protected:
+    QIODevice &device;
+    const int chunkSize;
+    QByteArray buffer;
+    int offset;
+
+};
+
 Message::Message(const FieldInfoMap &fieldInfo, const QString pathSeparator)
-    : fieldInfo(fieldInfo), pathSeparator(pathSeparator)
+    : pathSeparator(pathSeparator)
 {
     Q_ASSERT_X(!pathSeparator.isEmpty(), "Message::Message", "pathSeparator should not be empty");
+    compileFieldInfo(fieldInfo);
 }
 
 QVariantMap Message::parse(QByteArray &data, const QString &tagPathPrefix) const
 {
-    QBuffer buffer(&data);
-    buffer.open(QIODevice::ReadOnly);
-    return parse(buffer, tagPathPrefix);
+    return parse(data.constData(), data.constData() + data.size(), tagPathPrefix);
+}
+
+/**
+ * @brief Parse a message directly from memory, such as a memory-mapped file.
+ *
+ * @param begin         Start of the encoded message.
+ * @param end           One past the end of the encoded message.
+ * @param tagPathPrefix Optional prefix of the tag paths to parse.
+ *
+ * @return The parsed fields.
+ */
+QVariantMap Message::parse(const char * const begin, const char * const end,
+                           const QString &tagPathPrefix) const
+{
+    const char * position = begin;
+    return parse(position, end, findFieldTable(tagPathPrefix), NULL);
 }
 
 QVariantMap Message::parse(QIODevice &data, const QString &tagPathPrefix) const
 {
+    // Decode local files straight from a memory mapping, if possible.
+    qint64 size;
+    uchar * const map = mapRemaining(data, size);
+    if (map != NULL) {
+        const char * position = reinterpret_cast<const char *>(map);
+        const QVariantMap result = parse(position, position + size,
+                                         findFieldTable(tagPathPrefix), NULL);
+        QFileDevice * const file = static_cast<QFileDevice *>(&data);
+        file->unmap(map);
+        file->seek(file->size());
+        return result;
+    }
+
+    // Otherwise, decode the data a chunk at a time, as it is read.
+    return parseStream(data, findFieldTable(tagPathPrefix), NULL);
+}
+
+/**
+ * @brief Parse a message, decoding supported packed repeated fields into typed arrays.
+ *
+ * Packed Uint32, Fixed32, Int32, Sint32, Sfixed32, Enumerator, Float and Double
+ * fields are appended to @a packedFields instead of the returned map, avoiding
+ * one QVariant per value. Each array is keyed by its field's full tag path
+ * (even when @a tagPathPrefix is used), so that identically named fields in
+ * different embedded messages are not merged. All other fields are returned
+ * as per parse(QByteArray&).
+ */
+QVariantMap Message::parse(QByteArray &data, PackedFields &packedFields,
+                           const QString &tagPathPrefix) const
+{
+    const char * position = data.constData();
+    return parse(position, position + data.size(), findFieldTable(tagPathPrefix), &packedFields);
+}
+
+QVariantMap Message::parse(QIODevice &data, PackedFields &packedFields,
+                           const QString &tagPathPrefix) const
+{
+    qint64 size;
+    uchar * const map = mapRemaining(data, size);
+    if (map != NULL) {
+        const char * position = reinterpret_cast<const char *>(map);
+        const QVariantMap result = parse(position, position + size,
+                                         findFieldTable(tagPathPrefix), &packedFields);
+        QFileDevice * const file = static_cast<QFileDevice *>(&data);
+        file->unmap(map);
+        file->seek(file->size());
+        return result;
+    }
+
+    return parseStream(data, findFieldTable(tagPathPrefix), &packedFields);
+}
+
+/**
+ * @brief Compile @a fieldInfo into tag-indexed field tables.
+ *
+ * Each tag path (such as "9/2/1") is split into its tag numbers, and walked
+ * from the top-level table, adding child tables as needed. This allows parse
+ * to find each field's info via integer lookups, rather than formatting and
+ * looking up tag path strings for every field decoded.
+ *
+ * Tag paths that are not made up of (canonical) positive tag numbers can never
+ * match any field, so are ignored.
+ */
+void Message::compileFieldInfo(const FieldInfoMap &fieldInfo)
+{
+    fieldTables.clear();
+    fieldTables.append(FieldTable());
+    for (FieldInfoMap::const_iterator iter = fieldInfo.constBegin(); iter != fieldInfo.constEnd(); ++iter) {
+        QList<quint32> tags;
+        QString tagPath;
+        foreach (const QString &component, iter.key().split(pathSeparator)) {
+            bool ok;
+            const quint32 tag = component.toUInt(&ok);
+            if ((!ok) || (tag == 0) || (component != QString::number(tag))) {
+                tags.clear();
+                break;
+            }
+            tags.append(tag);
+        }
+        if (tags.isEmpty()) {
+            continue;
+        }
+
+        // Walk (and extend) the tables down to the field's parent table.
+        int table = 0;
+        for (int index = 0; index < tags.size() - 1; ++index) {
+            tagPath += QString::number(tags.at(index));
+            CompiledField &parent = fieldTables[table][tags.at(index)];
+            if (parent.fieldInfo.fieldName.isEmpty()) {
+                parent.fieldInfo.fieldName = QString::number(tags.at(index));
+            }
+            parent.tagPath = tagPath;
+            tagPath += pathSeparator;
+            if (parent.childTable < 0) {
+                parent.childTable = fieldTables.size();
+                fieldTables.append(FieldTable()); // Note, invalidates parent.
+            }
+            table = fieldTables.at(table).value(tags.at(index)).childTable;
+        }
+
+        // Note, the field may already exist (with a child table) as a parent.
+        CompiledField &field = fieldTables[table][tags.last()];
+        field.fieldInfo = iter.value();
+        field.tagPath = iter.key();
+        if (field.fieldInfo.fieldName.isEmpty()) {
+            field.fieldInfo.fieldName = QString::number(tags.last());
+        }
+    }
+    fieldTables.squeeze();
+}
+
+/**
+ * @brief Decode packed values (or a chunk of them) into @a packedFields.
+ *
+ * @param begin       Start of the (whole) packed values to decode.
+ * @param end         One past the end of the values to decode.
+ * @param fieldLength Length of the field's values from @a begin onwards, for
+ *                    reserving array space; may extend beyond @a end.
+ * @param field       Field the values belong to.
+ * @param packedFields Arrays to append the decoded values to.
+ *
+ * @pre isPackedArrayType(field.fieldInfo.scalarType) is `true`.
+ *
+ * @return `false` if any values were invalid, or out of range.
+ */
+bool Message::decodePackedValues(const char * const begin, const char * const end,
+                                 const quint64 fieldLength, const CompiledField &field,
+                                 PackedFields &packedFields)
+{
+    switch (field.fieldInfo.scalarType) {
+    case Types::Uint32:
+        return decodePackedVarints(begin, end,
+            packedFields.unsignedIntegers[field.tagPath], decodeUnsignedVarint);
+    case Types::Fixed32:
+        return decodePackedFixedNumbers(begin, end, fieldLength,
+            packedFields.unsignedIntegers[field.tagPath]);
+    case Types::Int32:
+    case Types::Enumerator:
+        return decodePackedVarints(begin, end,
+            packedFields.signedIntegers[field.tagPath], decodeStandardVarint);
+    case Types::Sint32:
+        return decodePackedVarints(begin, end,
+            packedFields.signedIntegers[field.tagPath], decodeSignedVarint);
+    case Types::Sfixed32:
+        return decodePackedFixedNumbers(begin, end, fieldLength,
+            packedFields.signedIntegers[field.tagPath]);
+    case Types::Float:
+        return decodePackedFixedNumbers(begin, end, fieldLength,
+            packedFields.floats[field.tagPath]);
+    case Types::Double:
+        return decodePackedFixedNumbers(begin, end, fieldLength,
+            packedFields.doubles[field.tagPath]);
+    default:
+        Q_ASSERT_X(false, "Message::decodePackedValues", "unsupported scalar type");
+    }
+    return false;
+}
+
+/**
+ * @brief Find the compiled info for field @a tag within @a table.
+ *
+ * @return The field's info, or `NULL` if the field is unknown.
+ */
+const Message::CompiledField * Message::findField(const FieldTable * const table,
+                                                  const quint32 tag) const
+{
+    if (table != NULL) {
+        const FieldTable::const_iterator iter = table->constFind(tag);
+        if (iter != table->constEnd()) {
+            return &iter.value();
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Find the field table for fields within @a tagPathPrefix.
+ *
+ * @param tagPathPrefix Empty for top-level fields, otherwise a tag path
+ *                      terminated with the path separator, such as "9/2/".
+ *
+ * @return The index of the matching table in fieldTables, or -1 if there is
+ *         no field info for any fields within @a tagPathPrefix.
+ */
+int Message::findFieldTable(const QString &tagPathPrefix) const
+{
+    if (tagPathPrefix.isEmpty()) {
+        return 0;
+    }
+    if (!tagPathPrefix.endsWith(pathSeparator)) {
+        return -1;
+    }
+    int table = 0;
+    foreach (const QString &component, tagPathPrefix.left(
+             tagPathPrefix.size() - pathSeparator.size()).split(pathSeparator)) {
+        bool ok;
+        const quint32 tag = component.toUInt(&ok);
+        const FieldTable::const_iterator field = fieldTables.at(table).constFind(tag);
+        if ((!ok) || (component != QString::number(tag)) ||
+            (field == fieldTables.at(table).constEnd()) || (field->childTable < 0)) {
+            return -1;
+        }
+        table = field->childTable;
+    }
+    return table;
+}
+
+QVariantMap Message::parse(const char * &position, const char * const end,
+                           const int fieldTable, PackedFields * const packedFields) const
+{
+    const FieldTable * const table = (fieldTable < 0) ? NULL : &fieldTables.at(fieldTable);
     QVariantMap parsedFields;
-    while (!data.atEnd()) {
+    while (position < end) {
         // Fetch the next field's tag index and wire type.
-        QPair<quint32, quint8> tagAndType = parseTagAndType(data);
+        QPair<quint32, quint8> tagAndType = parseTagAndType(position, end);
         if (tagAndType.first == 0) {
             qWarning() << "Invalid tag:" << tagAndType.first;
             return QVariantMap();
@@ -57,47 +547,218 @@ QVariantMap Message::parse(QIODevice &data, const QString &tagPathPrefix) const
         }
 
         // Get the (optional) field name and type hint for this field.
-        const QString tagPath = QString::fromLatin1("%1%2").arg(tagPathPrefix).arg(tagAndType.first);
-        FieldInfo fieldInfo = this->fieldInfo.value(tagPath); // Note intentional fallback to default-constructed.
-        if (fieldInfo.fieldName.isEmpty()) {
-            fieldInfo.fieldName = QString::fromLatin1("%1").arg(tagAndType.first);
+        const CompiledField * field = findField(table, tagAndType.first);
+        CompiledField unknownField;
+        if (field == NULL) {
+            unknownField.fieldInfo.fieldName = QString::number(tagAndType.first);
+            field = &unknownField;
         }
 
-        // Parse the field value.
-        const QVariant value = parseValue(data, tagAndType.second, fieldInfo.scalarType, tagPath);
-        if (!value.isValid()) {
+        if (!parseField(position, end, tagAndType.second, *field, packedFields, parsedFields)) {
             return QVariantMap();
         }
+    }
+    return parsedFields;
+}
+
+/**
+ * @brief Parse a single field's value, adding it to @a parsedFields.
+ *
+ * @return `false` if the value could not be parsed.
+ */
+bool Message::parseField(const char * &position, const char * const end, const quint8 wireType,
+                         const CompiledField &field, PackedFields * const packedFields,
+                         QVariantMap &parsedFields) const
+{
+    // Decode packed repeated values into typed arrays, if requested.
+    if ((packedFields != NULL) && (wireType == Types::LengthDelimeted) &&
+        (isPackedArrayType(field.fieldInfo.scalarType))) {
+        return parsePackedValues(position, end, field, *packedFields);
+    }
+
+    // Parse the field value.
+    const QVariant value = parseValue(position, end, wireType, field, packedFields);
+    if (!value.isValid()) {
+        return false;
+    }
+
+    // Add the parsed value(s) to the parsed fields map. The map's variant
+    // is cleared first so that appending does not detach (copy) the list.
+    QVariant &parsedField = parsedFields[field.fieldInfo.fieldName];
+    QVariantList list = parsedField.toList();
+    parsedField.clear();
+    if (static_cast<QMetaType::Type>(value.type()) == QMetaType::QVariantList) {
+        list << value.toList();
+    } else {
+        list << value;
+    }
+    parsedField = list;
+    return true;
+}
+
+/**
+ * @brief Decode a packed repeated field directly into @a packedFields.
+ *
+ * Values are appended to the array for the field's tag path, so that
+ * identically named fields in different (embedded) messages stay distinct.
+ *
+ * @pre isPackedArrayType(field.fieldInfo.scalarType) is `true`.
+ *
+ * @return `false` if the field's length-delimited value could not be read.
+ */
+bool Message::parsePackedValues(const char * &position, const char * const end,
+                                const CompiledField &field, PackedFields &packedFields) const
+{
+    int length;
+    const char * const value = readLengthDelimitedValue(position, end, length);
+    if (value == NULL) {
+        qWarning() << "Failed to read packed values for" << field.fieldInfo.fieldName;
+        return false;
+    }
 
-        // Add the parsed value(s) to the parsed fields map.
-        QVariantList list = parsedFields[fieldInfo.fieldName].toList();
-        if (static_cast<QMetaType::Type>(value.type()) == QMetaType::QVariantList) {
-            list << value.toList();
-        } else {
-            list << value;
+    if (!decodePackedValues(value, value + length, length, field, packedFields)) {
+        qWarning() << "Ignoring invalid or out-of-range packed values for"
+                   << field.fieldInfo.fieldName << '(' << field.tagPath << ')';
+    }
+    return true;
+}
+
+/**
+ * @brief Decode a packed repeated field into @a packedFields, a chunk at a time.
+ *
+ * Only whole values are decoded from each chunk; any value split across
+ * chunks is carried over to the next, so the field is never buffered whole.
+ *
+ * @pre isPackedArrayType(field.fieldInfo.scalarType) is `true`.
+ *
+ * @return `false` if the field's length-delimited value could not be read.
+ */
+bool Message::parsePackedValues(StreamBuffer &buffer, const CompiledField &field,
+                                PackedFields &packedFields) const
+{
+    const int prefixLength = buffer.varintLength();
+    quint64 remaining;
+    if ((prefixLength == 0) ||
+        (decodeUnsignedVarint(buffer.begin(), buffer.end(), remaining) == 0)) {
+        qWarning() << "Failed to read packed values for" << field.fieldInfo.fieldName;
+        return false;
+    }
+    buffer.consume(prefixLength);
+
+    bool ok = true;
+    while (remaining > 0) {
+        const int available = static_cast<int>(
+            qMin(static_cast<quint64>(buffer.size()), remaining));
+        const int length = (static_cast<quint64>(available) == remaining) ? available :
+            completePackedLength(buffer.begin(), buffer.begin() + available,
+                                 field.fieldInfo.scalarType);
+        if (length == 0) {
+            if (!buffer.fill(available + 1)) {
+                qWarning() << "Failed to read packed values for" << field.fieldInfo.fieldName;
+                return false;
+            }
+            continue;
+        }
+        if (ok) {
+            ok = decodePackedValues(buffer.begin(), buffer.begin() + length, remaining,
+                                    field, packedFields);
         }
-        parsedFields[fieldInfo.fieldName] = list;
+        buffer.consume(length);
+        remaining -= length;
+    }
+    if (!ok) {
+        qWarning() << "Ignoring invalid or out-of-range packed values for"
+                   << field.fieldInfo.fieldName << '(' << field.tagPath << ')';
+    }
+    return true;
+}
+
+/**
+ * @brief Parse a message as it is read from @a data, a chunk at a time.
+ *
+ * Packed repeated fields decoded into @a packedFields (such as Polar's
+ * per-sample fields) are decoded as they are read, so are never buffered
+ * whole. All other fields are buffered whole, then parsed as per usual; those
+ * are small in practice, though embedded messages are buffered entirely,
+ * including any packed fields within them.
+ */
+QVariantMap Message::parseStream(QIODevice &data, const int fieldTable,
+                                 PackedFields * const packedFields) const
+{
+    const FieldTable * const table = (fieldTable < 0) ? NULL : &fieldTables.at(fieldTable);
+    StreamBuffer buffer(data);
+    QVariantMap parsedFields;
+    while (buffer.fill(1)) {
+        // Fetch the next field's tag index and wire type.
+        const int tagLength = buffer.varintLength();
+        const char * position = buffer.begin();
+        const QPair<quint32, quint8> tagAndType = (tagLength == 0) ?
+            QPair<quint32, quint8>(0, 0) : parseTagAndType(position, buffer.end());
+        if (tagAndType.first == 0) {
+            qWarning() << "Invalid tag:" << tagAndType.first;
+            return QVariantMap();
+        }
+        buffer.consume(tagLength);
+
+        // If this is a (deprecated) "end group", return the parsed group.
+        if (tagAndType.second == Types::EndGroup) {
+            return parsedFields;
+        }
+
+        // Get the (optional) field name and type hint for this field.
+        const CompiledField * field = findField(table, tagAndType.first);
+        CompiledField unknownField;
+        if (field == NULL) {
+            unknownField.fieldInfo.fieldName = QString::number(tagAndType.first);
+            field = &unknownField;
+        }
+
+        // Decode packed repeated values into typed arrays, as they are read.
+        if ((packedFields != NULL) && (tagAndType.second == Types::LengthDelimeted) &&
+            (isPackedArrayType(field->fieldInfo.scalarType))) {
+            if (!parsePackedValues(buffer, *field, *packedFields)) {
+                return QVariantMap();
+            }
+            continue;
+        }
+
+        // Otherwise, buffer the field's whole value, and parse it from memory.
+        if (!buffer.fillValue(tagAndType.second)) {
+            qWarning() << "Failed to read value for" << field->fieldInfo.fieldName;
+            return QVariantMap();
+        }
+        position = buffer.begin();
+        if (!parseField(position, buffer.end(), tagAndType.second, *field,
+                        packedFields, parsedFields)) {
+            return QVariantMap();
+        }
+        buffer.consume(position - buffer.begin());
     }
     return parsedFields;
 }
 
-QPair<quint32, quint8> Message::parseTagAndType(QIODevice &data) const
+QPair<quint32, quint8> Message::parseTagAndType(const char * &position,
+                                                const char * const end) const
 {
-    QVariant tagAndType = parseUnsignedVarint(data);
-    return tagAndType.isValid()
-        ? QPair<quint32, quint8>(tagAndType.toULongLong() >> 3, tagAndType.toULongLong() & 0x07)
-        : QPair<quint32, quint8>(0, 0);
+    quint64 tagAndType;
+    const int length = decodeUnsignedVarint(position, end, tagAndType);
+    if (length == 0) {
+        return QPair<quint32, quint8>(0, 0);
+    }
+    position += length;
+    return QPair<quint32, quint8>(tagAndType >> 3, tagAndType & 0x07);
 }
 
-QVariant Message::parseValue(QIODevice &data, const quint8 wireType,
-                             const Types::ScalarType scalarType,
-                             const QString &tagPath) const
+QVariant Message::parseValue(const char * &position, const char * const end,
+                             const quint8 wireType, const CompiledField &field,
+                             PackedFields * const packedFields) const
 {
     // A small sanity check. In this case, the wireType will take precedence.
+    const Types::ScalarType scalarType = field.fieldInfo.scalarType;
     if ((scalarType != Types::Unknown) &&
         (wireType != Types::LengthDelimeted) &&
         (wireType != Types::getWireType(scalarType))) {
-        qWarning() << tagPath << "wire type" << wireType << "does not match "
+        qWarning() << field.fieldInfo.fieldName << "wire type" << wireType << "does not match "
             "expected wire type" << Types::getWireType(scalarType) << "for "
             "scalar type" << scalarType << '.';
     }
@@ -105,57 +766,59 @@ QVariant Message::parseValue(QIODevice &data, const quint8 wireType,
     switch (wireType) {
     case Types::Varint: // int32, int64, uint32, uint64, sint32, sint64, bool, enum.
         switch (scalarType) {
-        case Types::Int32:      return parseStandardVarint(data);
-        case Types::Int64:      return parseStandardVarint(data);
-        case Types::Uint32:     return parseUnsignedVarint(data);
-        case Types::Uint64:     return parseUnsignedVarint(data);
-        case Types::Sint32:     return parseSignedVarint(data);
-        case Types::Sint64:     return parseSignedVarint(data);
-        case Types::Bool:       return parseStandardVarint(data);
-        case Types::Enumerator: return parseStandardVarint(data);
-        default:                return parseStandardVarint(data);
+        case Types::Int32:      return readVarint(position, end, decodeStandardVarint);
+        case Types::Int64:      return readVarint(position, end, decodeStandardVarint);
+        case Types::Uint32:     return readVarint(position, end, decodeUnsignedVarint);
+        case Types::Uint64:     return readVarint(position, end, decodeUnsignedVarint);
+        case Types::Sint32:     return readVarint(position, end, decodeSignedVarint);
+        case Types::Sint64:     return readVarint(position, end, decodeSignedVarint);
+        case Types::Bool:       return readVarint(position, end, decodeStandardVarint);
+        case Types::Enumerator: return readVarint(position, end, decodeStandardVarint);
+        default:                return readVarint(position, end, decodeStandardVarint);
         }
         break;
     case Types::SixtyFourBit: // fixed64, sfixed64, double.
         switch (scalarType) {
-        case Types::Fixed64:  return parseFixedNumber<quint64>(data);
-        case Types::Sfixed64: return parseFixedNumber<qint64>(data);
-        case Types::Double:   return parseFixedNumber<double>(data);
-        default:              return data.read(8); // The raw 8-byte sequence.
+        case Types::Fixed64:  return readFixedNumber<quint64>(position, end);
+        case Types::Sfixed64: return readFixedNumber<qint64>(position, end);
+        case Types::Double:   return readFixedNumber<double>(position, end);
+        default:              return readRawBytes(position, end, 8); // The raw 8-byte sequence.
         }
         break;
     case Types::LengthDelimeted: // string, bytes, embedded messages, packed repeated fields.
-        return parseLengthDelimitedValue(data, scalarType, tagPath);
+        return parseLengthDelimitedValue(position, end, field, packedFields);
     case Types::StartGroup: // deprecated.
-        return parse(data, tagPath + pathSeparator);
+        return parse(position, end, field.childTable, packedFields);
     case Types::EndGroup: // deprecated.
         return QVariant(); // Caller will need to end the group started previously.
     case Types::ThirtyTwoBit: // fixed32, sfixed32, float.
         switch (scalarType) {
-        case Types::Fixed32:  return parseFixedNumber<quint32>(data);
-        case Types::Sfixed32: return parseFixedNumber<qint32>(data);
-        case Types::Float:    return parseFixedNumber<float>(data);
-        default:              return data.read(4); // The raw 4-byte sequence.
+        case Types::Fixed32:  return readFixedNumber<quint32>(position, end);
+        case Types::Sfixed32: return readFixedNumber<qint32>(position, end);
+        case Types::Float:    return readFixedNumber<float>(position, end);
+        default:              return readRawBytes(position, end, 4); // The raw 4-byte sequence.
         }
         break;
     }
-    qWarning() << "Invalid wireType:" << wireType << "(tagPath:" << tagPath << ')';
+    qWarning() << "Invalid wireType:" << wireType << "(field:" << field.fieldInfo.fieldName << ')';
     return QVariant();
 }
 
-QVariant Message::parseLengthDelimitedValue(QIODevice &data,
-                                            const Types::ScalarType scalarType,
-                                            const QString &tagPath) const
+QVariant Message::parseLengthDelimitedValue(const char * &position, const char * const end,
+                                            const CompiledField &field,
+                                            PackedFields * const packedFields) const
 {
-    const QVariant value = readLengthDelimitedValue(data);
-    if (!value.isValid()) {
+    const Types::ScalarType scalarType = field.fieldInfo.scalarType;
+    int length;
+    const char * const value = readLengthDelimitedValue(position, end, length);
+    if (value == NULL) {
         qWarning() << "Failed to read prefix-delimited value.";
         return QVariant();
     }
 
     // Return bytes and unknowns as-is.
     if ((scalarType == Types::Bytes) || (scalarType == Types::Unknown)) {
-        return value;
+        return QByteArray(value, length);
     }
 
     // Assume strings are UTF-8, which works fine for Polar data. If other
@@ -163,41 +826,55 @@ QVariant Message::parseLengthDelimitedValue(QIODevice &data,
     // and convert to QString upon return. This is also consistent with the
     // `protoc --decode_raw` output.
     if (scalarType == Types::String ) {
-        return QString::fromUtf8(value.toByteArray());
+        return QString::fromUtf8(value, length);
     }
 
-    // Parse embedded messages recursively.
+    // Parse embedded messages recursively, directly from the enclosing buffer.
+    const char * valuePosition = value;
     if (scalarType == Types::EmbeddedMessage) {
-        QByteArray array = value.toByteArray();
-        return parse(array, tagPath + pathSeparator);
+        return parse(valuePosition, value + length, field.childTable, packedFields);
     }
 
     // Parse packed repeated values into a list.
     QVariantList list;
-    QByteArray array = value.toByteArray();
-    QBuffer buffer(&array);
-    buffer.open(QIODevice::ReadOnly);
-    for (QVariant item(0); item.isValid();) {
-        item = parseValue(buffer, Types::getWireType(scalarType), scalarType,
-                          tagPath + pathSeparator);
-        if (item.isValid()) {
-            list << item;
+    switch (Types::getWireType(scalarType)) {
+    case Types::SixtyFourBit: list.reserve(length / 8); break;
+    case Types::ThirtyTwoBit: list.reserve(length / 4); break;
+    default: break;
+    }
+    while (valuePosition < value + length) {
+        const QVariant item = parseValue(valuePosition, value + length,
+                                         Types::getWireType(scalarType), field, NULL);
+        if (!item.isValid()) {
+            break;
         }
+        list << item;
     }
     return list;
 }
 
-QVariant Message::readLengthDelimitedValue(QIODevice &data) const
+const char * Message::readLengthDelimitedValue(const char * &position,
+                                               const char * const end,
+                                               int &length) const
 {
     // Note: We're assuming length-delimited values use unsigned varints for lengths.
     // I haven't found any Protocl Buffers documentation to support / dispute this.
-    const QVariant length = parseUnsignedVarint(data);
-    if (!length.isValid()) {
+    quint64 valueLength;
+    const int lengthLength = decodeUnsignedVarint(position, end, valueLength);
+    if (lengthLength == 0) {
         qWarning() << "Failed to read prefix-delimited length.";
-        return QVariant();
+        return NULL;
+    }
+    position += lengthLength;
+
+    // Never return a truncated value.
+    if (valueLength > static_cast<quint64>(end - position)) {
+        return NULL;
     }
-    const QByteArray value = data.read(length.toULongLong());
-    return (value.length() == length.toInt()) ? value : QVariant();
+    const char * const value = position;
+    length = static_cast<int>(valueLength);
+    position += length;
+    return value;
 }
 
 }
@@ -23,9 +23,11 @@
 #include "types.h"
 
 #include <QByteArray>
+#include <QHash>
 #include <QIODevice>
 #include <QPair>
 #include <QVariantList>
+#include <QVector>
 
 namespace ProtoBuf {
 
@@ -54,26 +56,88 @@ public:
 
     typedef QMap<QString, FieldInfo> FieldInfoMap;
 
+    /// Packed repeated fields decoded into contiguous arrays, keyed by tag path (eg "9/2").
+    struct PackedFields {
+        QMap<QString, QVector<quint32> > unsignedIntegers; ///< Uint32 and Fixed32 fields.
+        QMap<QString, QVector<qint32> > signedIntegers;    ///< Int32, Sint32, Sfixed32 and Enumerator fields.
+        QMap<QString, QVector<float> > floats;             ///< Float fields.
+        QMap<QString, QVector<double> > doubles;           ///< Double fields.
+    };
+
     Message(const FieldInfoMap &fieldInfo, const QString pathSeparator = QLatin1String("/"));
 
     QVariantMap parse(QByteArray &data, const QString &tagPathPrefix = QString()) const;
+    QVariantMap parse(const char * const begin, const char * const end,
+                      const QString &tagPathPrefix = QString()) const;
     QVariantMap parse(QIODevice &data, const QString &tagPathPrefix = QString()) const;
 
+    QVariantMap parse(QByteArray &data, PackedFields &packedFields,
+                      const QString &tagPathPrefix = QString()) const;
+    QVariantMap parse(QIODevice &data, PackedFields &packedFields,
+                      const QString &tagPathPrefix = QString()) const;
+
 protected:
-    FieldInfoMap fieldInfo;
+    /// A field's info and tag path, plus the index of the table describing
+    /// its child fields (if any).
+    struct CompiledField {
+        FieldInfo fieldInfo;
+        QString tagPath;
+        int childTable;
+
+        CompiledField(const FieldInfo &fieldInfo = FieldInfo(), const int childTable = -1)
+            : fieldInfo(fieldInfo), childTable(childTable)
+        {
+
+        }
+    };
+
+    typedef QHash<quint32, CompiledField> FieldTable;
+
+    class StreamBuffer;
+
+    QVector<FieldTable> fieldTables; ///< Tag-indexed field tables; the first is the top level.
     QString pathSeparator;
 
-    QPair<quint32, quint8> parseTagAndType(QIODevice &data) const;
+    void compileFieldInfo(const FieldInfoMap &fieldInfo);
+
+    int findFieldTable(const QString &tagPathPrefix) const;
+
+    static bool decodePackedValues(const char * const begin, const char * const end,
+                                   const quint64 fieldLength, const CompiledField &field,
+                                   PackedFields &packedFields);
+
+    const CompiledField * findField(const FieldTable * const table, const quint32 tag) const;
+
+    QVariantMap parse(const char * &position, const char * const end,
+                      const int fieldTable, PackedFields * const packedFields) const;
+
+    bool parseField(const char * &position, const char * const end, const quint8 wireType,
+                    const CompiledField &field, PackedFields * const packedFields,
+                    QVariantMap &parsedFields) const;
+
+    bool parsePackedValues(const char * &position, const char * const end,
+                           const CompiledField &field, PackedFields &packedFields) const;
+
+    bool parsePackedValues(StreamBuffer &buffer, const CompiledField &field,
+                           PackedFields &packedFields) const;
+
+    QVariantMap parseStream(QIODevice &data, const int fieldTable,
+                            PackedFields * const packedFields) const;
+
+    QPair<quint32, quint8> parseTagAndType(const char * &position,
+                                           const char * const end) const;
 
-    QVariant parseLengthDelimitedValue(QIODevice &data,
-                                       const Types::ScalarType scalarType,
-                                       const QString &tagPath) const;
+    QVariant parseLengthDelimitedValue(const char * &position, const char * const end,
+                                       const CompiledField &field,
+                                       PackedFields * const packedFields) const;
 
-    QVariant parseValue(QIODevice &data, const quint8 wireType,
-                        const Types::ScalarType scalarType,
-                        const QString &tagPath) const;
+    QVariant parseValue(const char * &position, const char * const end,
+                        const quint8 wireType, const CompiledField &field,
+                        PackedFields * const packedFields) const;
 
-    QVariant readLengthDelimitedValue(QIODevice &data) const;
+    const char * readLengthDelimitedValue(const char * &position,
+                                          const char * const end,
+                                          int &length) const;
 
 };
 
@@ -19,40 +19,55 @@
 
 #include "varint.h"
 
-#include <QBuffer>
 #include <QDebug>
 
 namespace ProtoBuf {
 
-QVariant parseSignedVarint(QByteArray data)
-{
-    QBuffer buffer(&data);
-    buffer.open(QIODevice::ReadOnly);
-    return parseSignedVarint(buffer);
-}
+namespace {
 
-QVariant parseSignedVarint(QIODevice &data)
+/// The maximum number of bytes in a (64-bit) varint.
+const int maxVarintLength = 10;
+
+template<typename Type>
+QVariant readVarint(QIODevice &data,
+                    int (*decode)(const char * const, const char * const, Type &))
 {
-    const QVariant variant = parseUnsignedVarint(data);
-    if (!variant.isValid()) {
+    char buffer[maxVarintLength];
+    const qint64 size = data.peek(buffer, sizeof(buffer));
+    Type value;
+    const int length = (size > 0) ? decode(buffer, buffer + size, value) : 0;
+    if (length == 0) {
         return QVariant();
     }
-    const quint64 result = variant.toULongLong();
-    return static_cast<qint64>(result >> 1) * ((result & 0x1) ? -1 : 1) + ((result & 0x1) ? -1 : 0);
+    data.read(buffer, length); // Consume just the bytes we decoded.
+    return value;
 }
 
-QVariantList parseSignedVarints(QByteArray data, int maxItems)
+template<typename Type>
+QVariantList decodeVarints(const QByteArray &data, int maxItems,
+                           int (*decode)(const char * const, const char * const, Type &))
 {
-    QBuffer buffer(&data);
-    buffer.open(QIODevice::ReadOnly);
-    return parseSignedVarints(buffer, maxItems);
+    QVariantList list;
+    const char * position = data.constData();
+    const char * const end = position + data.size();
+    for (Type value; (maxItems < 0) || (list.size() < maxItems);) {
+        const int length = decode(position, end, value);
+        if (length == 0) {
+            break;
+        }
+        list << value;
+        position += length;
+    }
+    return list;
 }
 
-QVariantList parseSignedVarints(QIODevice &data, int maxItems)
+template<typename Type>
+QVariantList readVarints(QIODevice &data, int maxItems,
+                         int (*decode)(const char * const, const char * const, Type &))
 {
     QVariantList list;
     for (; (maxItems < 0) || (list.size() < maxItems);) {
-        const QVariant item = parseSignedVarint(data);
+        const QVariant item = readVarint(data, decode);
         if (item.isValid()) {
             list << item;
         } else {
@@ -62,81 +77,126 @@ QVariantList parseSignedVarints(QIODevice &data, int maxItems)
     return list;
 }
 
+}
+
+/**
+ * @brief Decode a zigzag-encoded (sint32, sint64) varint from a buffer.
+ *
+ * @see decodeUnsignedVarint
+ */
+int decodeSignedVarint(const char * const begin, const char * const end, qint64 &value)
+{
+    quint64 result;
+    const int length = decodeUnsignedVarint(begin, end, result);
+    if (length > 0) {
+        value = static_cast<qint64>((result >> 1) ^ (~(result & 0x1) + 1));
+    }
+    return length;
+}
+
+/**
+ * @brief Decode a standard (int32, int64, bool, enum) varint from a buffer.
+ *
+ * @see decodeUnsignedVarint
+ */
+int decodeStandardVarint(const char * const begin, const char * const end, qint64 &value)
+{
+    quint64 result;
+    const int length = decodeUnsignedVarint(begin, end, result);
+    if (length > 0) {
+        value = static_cast<qint64>(result);
+    }
+    return length;
+}
+
+/**
+ * @brief Decode an unsigned (uint32, uint64) varint from a buffer.
+ *
+ * @param begin Pointer to the first byte of the varint.
+ * @param end   Pointer to one past the last readable byte.
+ * @param value Set to the decoded value on success; untouched otherwise.
+ *
+ * @return The number of bytes consumed, or 0 if the buffer does not begin with
+ *         a complete varint of at most 10 bytes.
+ */
+int decodeUnsignedVarint(const char * const begin, const char * const end, quint64 &value)
+{
+    quint64 result = 0;
+    for (int index = 0; (index < maxVarintLength) && (begin + index < end); ++index) {
+        const uchar byte = static_cast<uchar>(begin[index]);
+        result |= (byte & Q_UINT64_C(0x7F)) << (7 * index);
+        if (byte < 0x80) {
+            value = result;
+            return index + 1;
+        }
+    }
+    return 0;
+}
+
+QVariant parseSignedVarint(QByteArray data)
+{
+    qint64 value;
+    return (decodeSignedVarint(data.constData(), data.constData() + data.size(), value) > 0)
+        ? QVariant(value) : QVariant();
+}
+
+QVariant parseSignedVarint(QIODevice &data)
+{
+    return readVarint(data, decodeSignedVarint);
+}
+
+QVariantList parseSignedVarints(QByteArray data, int maxItems)
+{
+    return decodeVarints(data, maxItems, decodeSignedVarint);
+}
+
+QVariantList parseSignedVarints(QIODevice &data, int maxItems)
+{
+    return readVarints(data, maxItems, decodeSignedVarint);
+}
+
 QVariant parseStandardVarint(QByteArray data)
 {
-    QBuffer buffer(&data);
-    buffer.open(QIODevice::ReadOnly);
-    return parseStandardVarint(buffer);
+    qint64 value;
+    return (decodeStandardVarint(data.constData(), data.constData() + data.size(), value) > 0)
+        ? QVariant(value) : QVariant();
 }
 
 QVariant parseStandardVarint(QIODevice &data)
 {
-    const QVariant variant = parseUnsignedVarint(data);
-    if (!variant.isValid()) {
-        return QVariant();
-    }
-    return static_cast<qint64>(variant.toULongLong());
+    return readVarint(data, decodeStandardVarint);
 }
 
 QVariantList parseStandardVarints(QByteArray data, int maxItems)
 {
-    QBuffer buffer(&data);
-    buffer.open(QIODevice::ReadOnly);
-    return parseStandardVarints(buffer, maxItems);
+    return decodeVarints(data, maxItems, decodeStandardVarint);
 }
 
 QVariantList parseStandardVarints(QIODevice &data, int maxItems)
 {
-    QVariantList list;
-    for (; (maxItems < 0) || (list.size() < maxItems);) {
-        const QVariant item = parseStandardVarint(data);
-        if (item.isValid()) {
-            list << item;
-        } else {
-            maxItems = 0;
-        }
-    }
-    return list;
+    return readVarints(data, maxItems, decodeStandardVarint);
 }
 
 QVariant parseUnsignedVarint(QByteArray data)
 {
-    QBuffer buffer(&data);
-    buffer.open(QIODevice::ReadOnly);
-    return parseUnsignedVarint(buffer);
+    quint64 value;
+    return (decodeUnsignedVarint(data.constData(), data.constData() + data.size(), value) > 0)
+        ? QVariant(value) : QVariant();
 }
 
 QVariant parseUnsignedVarint(QIODevice &data)
 {
-    quint64 result = 0;
-    for (uchar byte = 0xFF, index = 0; byte >= 0x80; ++index) {
-        const QByteArray array = data.read(1);
-        if (array.isEmpty()) return QVariant();
-        byte = static_cast<uchar>(array.at(0));
-        result += (byte & Q_UINT64_C(0x7F)) << (7 * index);
-    }
-    return result;
+    return readVarint(data, decodeUnsignedVarint);
 }
 
 QVariantList parseUnsignedVarints(QByteArray data, int maxItems)
 {
-    QBuffer buffer(&data);
-    buffer.open(QIODevice::ReadOnly);
-    return parseUnsignedVarints(buffer, maxItems);
+    return decodeVarints(data, maxItems, decodeUnsignedVarint);
 }
 
 QVariantList parseUnsignedVarints(QIODevice &data, int maxItems)
 {
-    QVariantList list;
-    for (; (maxItems < 0) || (list.size() < maxItems);) {
-        const QVariant item = parseUnsignedVarint(data);
-        if (item.isValid()) {
-            list << item;
-        } else {
-            maxItems = 0;
-        }
-    }
-    return list;
+    return readVarints(data, maxItems, decodeUnsignedVarint);
 }
 
 }
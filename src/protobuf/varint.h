@@ -26,6 +26,10 @@
 
 namespace ProtoBuf {
 
+int decodeSignedVarint(const char * const begin, const char * const end, qint64 &value);
+int decodeStandardVarint(const char * const begin, const char * const end, qint64 &value);
+int decodeUnsignedVarint(const char * const begin, const char * const end, quint64 &value);
+
 QVariant parseSignedVarint(QByteArray data);
 QVariant parseSignedVarint(QIODevice &data);
 QVariantList parseSignedVarints(QByteArray data, int maxItems = -1);
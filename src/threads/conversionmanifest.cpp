@@ -0,0 +1,313 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "conversionmanifest.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 1, 0))
+#include <QSaveFile>
+#endif
+#include <QStandardPaths>
+
+ConversionManifest::ConversionManifest(const QString &fileName)
+    : fileName(fileName)
+{
+
+}
+
+bool ConversionManifest::contains(const QString &baseName) const
+{
+    QMutexLocker locker(&mutex);
+    return sessions.contains(baseName);
+}
+
+/**
+ * @brief Check if a session's recorded conversion is still current.
+ *
+ * Input files whose sizes and modification times match those recorded are
+ * also hashed, and compared to the recorded content hashes, so same-size
+ * rewrites within the file system's timestamp resolution are not missed.
+ *
+ * @param baseName Base name of the training session.
+ * @param inputs   Current input fingerprints, as per fingerprintInputs().
+ * @param options  Current conversion options.
+ *
+ * @return \c true if the session was previously converted from identical
+ *         inputs, with identical options, and all of its recorded output
+ *         files still exist; \c false otherwise.
+ */
+bool ConversionManifest::isUpToDate(const QString &baseName, const QJsonObject &inputs,
+                                    const QJsonObject &options) const
+{
+    QJsonObject session;
+    {
+        QMutexLocker locker(&mutex);
+        session = sessions.value(baseName).toObject();
+    }
+    if ((session.isEmpty()) ||
+        (session.value(QLatin1String("options")).toObject() != options)) {
+        return false;
+    }
+
+    const QJsonArray outputs = session.value(QLatin1String("outputs")).toArray();
+    if (outputs.isEmpty()) {
+        return false;
+    }
+    foreach (const QJsonValue &output, outputs) {
+        if (!QFile::exists(output.toString())) {
+            return false;
+        }
+    }
+
+    // Compare the cheap fingerprints first, and only then the content hashes.
+    const QJsonObject recordedInputs = session.value(QLatin1String("inputs")).toObject();
+    if (recordedInputs.keys() != inputs.keys()) {
+        return false;
+    }
+    for (QJsonObject::const_iterator input = inputs.constBegin();
+         input != inputs.constEnd(); ++input) {
+        QJsonObject recorded = recordedInputs.value(input.key()).toObject();
+        const QString recordedHash = recorded.take(QLatin1String("sha1")).toString();
+        if ((recorded != input.value().toObject()) || (recordedHash.isEmpty())) {
+            return false;
+        }
+    }
+    const QDir dir = QFileInfo(baseName).dir();
+    for (QJsonObject::const_iterator input = inputs.constBegin();
+         input != inputs.constEnd(); ++input) {
+        if (hashFile(dir.filePath(input.key())) !=
+            recordedInputs.value(input.key()).toObject().value(QLatin1String("sha1")).toString()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Get the output naming details recorded for a session.
+ *
+ * @param baseName Base name of the training session.
+ * @param inputs   Current input fingerprints, as per fingerprintInputs().
+ *
+ * @return The naming details recorded by update(), provided the session's
+ *         create file is unchanged since; an empty object otherwise.
+ */
+QJsonObject ConversionManifest::naming(const QString &baseName, const QJsonObject &inputs) const
+{
+    QJsonObject session;
+    {
+        QMutexLocker locker(&mutex);
+        session = sessions.value(baseName).toObject();
+    }
+    const QFileInfo baseInfo(baseName);
+    const QString createFileName = baseInfo.fileName() + QLatin1String("-create");
+    QJsonObject recorded = session.value(QLatin1String("inputs")).toObject()
+        .value(createFileName).toObject();
+    const QString recordedHash = recorded.take(QLatin1String("sha1")).toString();
+    if ((recorded.isEmpty()) || (recorded != inputs.value(createFileName).toObject()) ||
+        (recordedHash != hashFile(baseInfo.dir().filePath(createFileName)))) {
+        return QJsonObject();
+    }
+    return session.value(QLatin1String("naming")).toObject();
+}
+
+/**
+ * @brief Record a session's conversion.
+ *
+ * The content hash of each input file is recorded along with its fingerprint,
+ * for isUpToDate() to verify later.
+ *
+ * @param baseName        Base name of the training session.
+ * @param inputs          Input fingerprints, as per fingerprintInputs().
+ * @param options         Conversion options used.
+ * @param outputFileNames Output files written.
+ * @param naming          Session details used to name the output files.
+ */
+void ConversionManifest::update(const QString &baseName, const QJsonObject &inputs,
+                                const QJsonObject &options,
+                                const QStringList &outputFileNames,
+                                const QJsonObject &naming)
+{
+    const QDir dir = QFileInfo(baseName).dir();
+    QJsonObject hashedInputs;
+    for (QJsonObject::const_iterator input = inputs.constBegin();
+         input != inputs.constEnd(); ++input) {
+        QJsonObject hashedInput = input.value().toObject();
+        hashedInput.insert(QLatin1String("sha1"), hashFile(dir.filePath(input.key())));
+        hashedInputs.insert(input.key(), hashedInput);
+    }
+
+    QJsonObject session;
+    session.insert(QLatin1String("inputs"), hashedInputs);
+    session.insert(QLatin1String("options"), options);
+    session.insert(QLatin1String("outputs"), QJsonArray::fromStringList(outputFileNames));
+    if (!naming.isEmpty()) {
+        session.insert(QLatin1String("naming"), naming);
+    }
+    QMutexLocker locker(&mutex);
+    sessions.insert(baseName, session);
+}
+
+bool ConversionManifest::load()
+{
+    QMutexLocker locker(&mutex);
+    sessions = QJsonObject();
+    QFile file(fileName);
+    if (!file.exists()) {
+        return true; // Nothing converted yet.
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open" << QDir::toNativeSeparators(fileName);
+        return false;
+    }
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if (error.error != QJsonParseError::NoError) {
+        qWarning() << "Failed to parse" << QDir::toNativeSeparators(fileName)
+                   << error.errorString();
+        return false;
+    }
+    sessions = document.object().value(QLatin1String("sessions")).toObject();
+    return true;
+}
+
+/**
+ * @brief Save the manifest, atomically replacing any previous manifest file.
+ *
+ * @return \c true if the manifest was saved; \c false otherwise, in which
+ *         case any previous manifest file is left intact.
+ */
+bool ConversionManifest::save() const
+{
+    QJsonObject manifest;
+    manifest.insert(QLatin1String("version"), 2);
+    QMutexLocker locker(&mutex);
+    const QString fileName = this->fileName;
+    manifest.insert(QLatin1String("sessions"), sessions);
+    locker.unlock();
+
+    const QFileInfo fileInfo(fileName);
+    if (!fileInfo.dir().exists() && !QDir().mkpath(fileInfo.absolutePath())) {
+        qWarning() << "Failed to create" << QDir::toNativeSeparators(fileInfo.absolutePath());
+        return false;
+    }
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 1, 0))
+    QSaveFile file(fileName);
+#else
+    QFile file(fileName + QLatin1String(".tmp"));
+#endif
+    if (!file.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+        qWarning() << "Failed to open" << QDir::toNativeSeparators(file.fileName());
+        return false;
+    }
+    const QByteArray json = QJsonDocument(manifest).toJson();
+    if (file.write(json) != json.size()) {
+        qWarning() << "Failed to write" << QDir::toNativeSeparators(file.fileName());
+        return false;
+    }
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 1, 0))
+    if (!file.commit()) {
+#else
+    file.close();
+    QFile::remove(fileName);
+    if (!file.rename(fileName)) {
+#endif
+        qWarning() << "Failed to save" << QDir::toNativeSeparators(fileName);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Set the file the manifest is loaded from, and saved to.
+ *
+ * @param fileName Manifest file name; does not take effect until the next
+ *                 load() or save().
+ */
+void ConversionManifest::setFileName(const QString &fileName)
+{
+    QMutexLocker locker(&mutex);
+    this->fileName = fileName;
+}
+
+QString ConversionManifest::defaultFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::DataLocation) +
+        QLatin1String("/conversions.json");
+}
+
+/**
+ * @brief Fingerprint the input files of a training session.
+ *
+ * @param baseName Base name of the training session.
+ *
+ * @return The size and last-modified time (in milliseconds since the epoch)
+ *         of each of the session's files, keyed by file name.
+ */
+QJsonObject ConversionManifest::fingerprintInputs(const QString &baseName)
+{
+    const QFileInfo baseInfo(baseName);
+    return fingerprintInputs(baseInfo.dir().entryInfoList(
+        QStringList(baseInfo.fileName() + QLatin1String("-*")), QDir::Files));
+}
+
+/**
+ * @brief Fingerprint an already-listed set of training session input files.
+ *
+ * @param fileInfoList The session's files, eg as found by a single listing of
+ *                     the input directory shared by many sessions.
+ *
+ * @return The size and last-modified time of each file, keyed by file name.
+ */
+QJsonObject ConversionManifest::fingerprintInputs(const QFileInfoList &fileInfoList)
+{
+    QJsonObject inputs;
+    foreach (const QFileInfo &info, fileInfoList) {
+        QJsonObject input;
+        input.insert(QLatin1String("size"), info.size());
+        input.insert(QLatin1String("modified"), info.lastModified().toMSecsSinceEpoch());
+        inputs.insert(info.fileName(), input);
+    }
+    return inputs;
+}
+
+/**
+ * @brief Hash a file's content.
+ *
+ * @param fileName Name of the file to hash.
+ *
+ * @return The file's SHA-1 hash, in hex, or an empty string on error.
+ */
+QString ConversionManifest::hashFile(const QString &fileName)
+{
+    QFile file(fileName);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if ((!file.open(QIODevice::ReadOnly)) || (!hash.addData(&file))) {
+        qWarning() << "Failed to hash" << QDir::toNativeSeparators(fileName);
+        return QString();
+    }
+    return QString::fromLatin1(hash.result().toHex());
+}
@@ -0,0 +1,69 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __CONVERSION_MANIFEST__
+#define __CONVERSION_MANIFEST__
+
+#include <QFileInfo>
+#include <QJsonObject>
+#include <QMutex>
+#include <QStringList>
+
+/**
+ * @brief Persistent record of previously converted training sessions.
+ *
+ * For each converted session, the manifest records the size, modification
+ * time and content hash of every input file, the conversion options used, and
+ * the output files written. This allows a session to be skipped, without being
+ * parsed, if none of its inputs or options have changed, and its outputs still
+ * exist. The session details used to name output files are recorded too, so
+ * that output file names can be resolved without parsing the session again.
+ *
+ * All public methods are thread-safe.
+ */
+class ConversionManifest {
+
+public:
+    ConversionManifest(const QString &fileName = defaultFileName());
+
+    bool contains(const QString &baseName) const;
+    bool isUpToDate(const QString &baseName, const QJsonObject &inputs,
+                    const QJsonObject &options) const;
+    QJsonObject naming(const QString &baseName, const QJsonObject &inputs) const;
+    void update(const QString &baseName, const QJsonObject &inputs,
+                const QJsonObject &options, const QStringList &outputFileNames,
+                const QJsonObject &naming = QJsonObject());
+
+    bool load();
+    bool save() const;
+    void setFileName(const QString &fileName);
+
+    static QString defaultFileName();
+    static QJsonObject fingerprintInputs(const QString &baseName);
+    static QJsonObject fingerprintInputs(const QFileInfoList &fileInfoList);
+    static QString hashFile(const QString &fileName);
+
+protected:
+    QString fileName;
+    mutable QMutex mutex;
+    QJsonObject sessions;
+
+};
+
+#endif // __CONVERSION_MANIFEST__
@@ -0,0 +1,113 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "conversionoptions.h"
+
+#include <QSettings>
+#include <QThread>
+
+ConversionOptions::ConversionOptions()
+    : hrmOptions(polar::v2::TrainingSession::RrFiles|polar::v2::TrainingSession::LapNames),
+      tcxOptions(polar::v2::TrainingSession::ForceTcxUTC),
+      concurrentParsing(AutomaticConcurrentParsing),
+      threadCount(QThread::idealThreadCount())
+{
+
+}
+
+/**
+ * @brief Read conversion options from the application's settings, as written
+ *        by the GUI.
+ */
+ConversionOptions ConversionOptions::fromSettings()
+{
+    QSettings settings;
+    ConversionOptions options;
+
+    options.inputFolders = settings.value(QLatin1String("inputFolders")).toStringList();
+    options.outputFolder =
+        (settings.value(QLatin1String("outputFolderIndex")).toInt() == 0) ?
+            QString() : settings.value(QLatin1String("outputFolder")).toString();
+    options.outputFileNameFormat =
+        settings.value(QLatin1String("outputFileNameFormat")).toString();
+
+    if (settings.value(QLatin1String("gpxEnabled")).toBool()) {
+        options.outputFormats |= polar::v2::TrainingSession::GpxOutput;
+    }
+    if (settings.value(QLatin1String("hrmEnabled")).toBool()) {
+        options.outputFormats |= polar::v2::TrainingSession::HrmOutput;
+    }
+    if (settings.value(QLatin1String("tcxEnabled")).toBool()) {
+        options.outputFormats |= polar::v2::TrainingSession::TcxOutput;
+    }
+
+    if (settings.contains(QLatin1String("concurrentParsing"))) {
+        options.concurrentParsing =
+            settings.value(QLatin1String("concurrentParsing")).toBool() ?
+                AlwaysConcurrentParsing : NeverConcurrentParsing;
+    }
+    options.threadCount = qMax(1, settings.value(QLatin1String("threadCount"),
+                                                 options.threadCount).toInt());
+
+    settings.beginGroup(QLatin1String("hrm"));
+    options.hrmOptions = polar::v2::TrainingSession::HrmOptions();
+    if (settings.value(QLatin1String("rrFiles"), true).toBool()) {
+        options.hrmOptions |= polar::v2::TrainingSession::RrFiles;
+    }
+    if (settings.value(QLatin1String("lapNamesExt"), true).toBool()) {
+        options.hrmOptions |= polar::v2::TrainingSession::LapNames;
+    }
+    settings.endGroup();
+
+    settings.beginGroup(QLatin1String("tcx"));
+    options.tcxOptions = polar::v2::TrainingSession::TcxOptions();
+    if (settings.value(QLatin1String("utcOnly"), true).toBool()) {
+        options.tcxOptions |= polar::v2::TrainingSession::ForceTcxUTC;
+    }
+    settings.endGroup();
+
+    return options;
+}
+
+/**
+ * @brief Get the options that affect conversion output, for the conversion
+ *        manifest.
+ *
+ * A session converted with different options than these is reconverted. The
+ * keys match the corresponding settings names.
+ */
+QJsonObject ConversionOptions::toJson() const
+{
+    QJsonObject json;
+    json.insert(QLatin1String("gpxEnabled"),
+                outputFormats.testFlag(polar::v2::TrainingSession::GpxOutput));
+    json.insert(QLatin1String("hrmEnabled"),
+                outputFormats.testFlag(polar::v2::TrainingSession::HrmOutput));
+    json.insert(QLatin1String("tcxEnabled"),
+                outputFormats.testFlag(polar::v2::TrainingSession::TcxOutput));
+    json.insert(QLatin1String("outputFolder"), outputFolder);
+    json.insert(QLatin1String("outputFileNameFormat"), outputFileNameFormat);
+    json.insert(QLatin1String("hrm/rrFiles"),
+                hrmOptions.testFlag(polar::v2::TrainingSession::RrFiles));
+    json.insert(QLatin1String("hrm/lapNamesExt"),
+                hrmOptions.testFlag(polar::v2::TrainingSession::LapNames));
+    json.insert(QLatin1String("tcx/utcOnly"),
+                tcxOptions.testFlag(polar::v2::TrainingSession::ForceTcxUTC));
+    return json;
+}
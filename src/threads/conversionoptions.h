@@ -0,0 +1,59 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __CONVERSION_OPTIONS__
+#define __CONVERSION_OPTIONS__
+
+#include "trainingsession.h"
+
+#include <QJsonObject>
+#include <QStringList>
+
+/**
+ * @brief Snapshot of all options that affect a conversion run.
+ *
+ * The options are captured once, before any training sessions are processed,
+ * so that worker threads never need to read (nor lock) QSettings, and so that
+ * conversions can be run without any settings at all, such as from the
+ * command line.
+ */
+struct ConversionOptions {
+    enum ConcurrentParsing {
+        AutomaticConcurrentParsing, ///< Only when there are fewer sessions than threads.
+        AlwaysConcurrentParsing,
+        NeverConcurrentParsing
+    };
+
+    QStringList inputFolders;
+    QString outputFolder;         ///< Empty means alongside the input files.
+    QString outputFileNameFormat;
+    polar::v2::TrainingSession::OutputFormats outputFormats;
+    polar::v2::TrainingSession::HrmOptions hrmOptions;
+    polar::v2::TrainingSession::TcxOptions tcxOptions;
+    ConcurrentParsing concurrentParsing;
+    int threadCount;
+    QString manifestFileName;     ///< Empty means ConversionManifest::defaultFileName().
+
+    ConversionOptions();
+
+    static ConversionOptions fromSettings();
+    QJsonObject toJson() const;
+};
+
+#endif // __CONVERSION_OPTIONS__
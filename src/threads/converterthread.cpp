@@ -23,17 +23,89 @@
 
 #include <QDebug>
 #include <QDir>
-#include <QSettings>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+
+class ConverterThread::SessionRunnable : public QRunnable {
+
+public:
+    SessionRunnable(ConverterThread * const converter, const int index)
+        : converter(converter), index(index)
+    {
+
+    }
+
+    virtual void run()
+    {
+        converter->proccessSession(converter->baseNames.at(index));
+        converter->sessionFinished(index);
+    }
+
+protected:
+    ConverterThread * const converter;
+    const int index;
+
+};
+
+// Convert session naming details to, and from, their manifest representation.
+static QJsonObject namingToJson(const polar::v2::TrainingSession::OutputNaming &naming)
+{
+    QJsonObject json;
+    if (naming.startTime.isValid()) {
+        json.insert(QLatin1String("start"), naming.startTime.toMSecsSinceEpoch());
+        #if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
+        json.insert(QLatin1String("utcOffset"), naming.startTime.offsetFromUtc());
+        #else
+        json.insert(QLatin1String("utcOffset"), naming.startTime.utcOffset());
+        #endif
+    }
+    json.insert(QLatin1String("sessionName"), naming.sessionName);
+    return json;
+}
+
+static polar::v2::TrainingSession::OutputNaming namingFromJson(const QJsonObject &json)
+{
+    polar::v2::TrainingSession::OutputNaming naming;
+    if (json.contains(QLatin1String("start"))) {
+        const qint64 start = static_cast<qint64>(json.value(QLatin1String("start")).toDouble());
+        const int utcOffset = json.value(QLatin1String("utcOffset")).toInt();
+        #if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
+        naming.startTime = QDateTime::fromMSecsSinceEpoch(start, Qt::OffsetFromUTC, utcOffset);
+        #else
+        naming.startTime = QDateTime::fromMSecsSinceEpoch(start).toUTC().addSecs(utcOffset);
+        naming.startTime.setUtcOffset(utcOffset);
+        #endif
+    }
+    naming.sessionName = json.value(QLatin1String("sessionName")).toString();
+    return naming;
+}
 
 ConverterThread::ConverterThread(QObject * const parent)
-    : QThread(parent), cancelled(false)
+    : QThread(parent), cancelled(0), sessionsIndexed(false), optionsFromSettings(true)
+{
+
+}
+
+/**
+ * @brief Construct a converter with fixed options, rather than options read
+ *        from the application's settings when the conversion starts.
+ */
+ConverterThread::ConverterThread(const ConversionOptions &options, QObject * const parent)
+    : QThread(parent), cancelled(0), sessionsIndexed(false), options(options),
+      optionsFromSettings(false)
 {
 
 }
 
 bool ConverterThread::isCancelled() const
 {
-    return cancelled;
+    return (cancelled.load() != 0);
+}
+
+const ConversionOptions &ConverterThread::conversionOptions() const
+{
+    return options;
 }
 
 const QStringList &ConverterThread::sessionBaseNames() const
@@ -41,67 +113,75 @@ const QStringList &ConverterThread::sessionBaseNames() const
     return baseNames;
 }
 
+/**
+ * @brief Limit conversion to the given, already indexed, training sessions.
+ *
+ * The input folders are then not listed at all, so callers that have already
+ * indexed the relevant folders (such as SessionWatcher) need not pay for that
+ * again. Must be called before the thread is started.
+ *
+ * @param index Index of the sessions to convert. If never set, all sessions
+ *              found in the input folders are converted.
+ */
+void ConverterThread::setSessionIndex(const polar::v2::SessionIndex &index)
+{
+    Q_ASSERT(!isRunning());
+    sessionIndex = index;
+    sessionsIndexed = true;
+}
+
 // Public slots.
 
 void ConverterThread::cancel()
 {
-    cancelled = true;
+    cancelled.store(1);
+    QMutexLocker locker(&progressMutex);
+    progressCondition.wakeAll();
 }
 
 // Protected methods.
 
 void ConverterThread::findSessionBaseNames()
 {
-    QSettings settings;
-
-    QRegExp regex(QLatin1String("(v2-users-[^-]+-training-sessions-[^-]+)-.*"));
-    foreach (const QString &folder,
-             settings.value(QLatin1String("inputFolders")).toStringList()) {
-        QDir dir(folder);
-        foreach (const QFileInfo &info, dir.entryInfoList()) {
-            if (regex.exactMatch(info.fileName())) {
-                const QString baseName = dir.absoluteFilePath(regex.cap(1));
-                if (!baseNames.contains(baseName)) {
-                    baseNames.append(baseName);
-                }
-            }
+    // Index each input folder just once, grouping files by session and exercise,
+    // so that sessions need not each list the (potentially large) folder again.
+    if (!sessionsIndexed) {
+        foreach (const QString &folder, options.inputFolders) {
+            sessionIndex.addFolder(folder);
         }
     }
+    baseNames = sessionIndex.baseNames();
 
     emit sessionBaseNamesChanged(baseNames.size());
 }
 
 void ConverterThread::proccessSession(const QString &baseName)
 {
-    if (cancelled) return;
+    if (isCancelled()) return;
     qDebug() << QDir::toNativeSeparators(baseName);
 
-    // Build the set of file formats to be exported.
-    QSettings settings;
-    polar::v2::TrainingSession::OutputFormats outputDataFormats;
-    if (settings.value(QLatin1String("gpxEnabled")).toBool()) {
-        outputDataFormats |= polar::v2::TrainingSession::GpxOutput;
-    }
-    if (settings.value(QLatin1String("hrmEnabled")).toBool()) {
-        outputDataFormats |= polar::v2::TrainingSession::HrmOutput;
-    }
-    if (settings.value(QLatin1String("tcxEnabled")).toBool()) {
-        outputDataFormats |= polar::v2::TrainingSession::TcxOutput;
+    // Skip sessions already converted from the same inputs, with the same
+    // options, without even parsing them.
+    const polar::v2::SessionFiles inputFiles = sessionIndex.value(baseName);
+    const QJsonObject inputs = ConversionManifest::fingerprintInputs(inputFiles.files);
+    const QJsonObject outputOptions = options.toJson();
+    if (manifest.isUpToDate(baseName, inputs, outputOptions)) {
+        sessions.skipped.ref();
+        return;
     }
 
-    // Load the output directory setting (empty == auto).
-    const QString outputDir =
-        (settings.value(QLatin1String("outputFolderIndex")).toInt() == 0) ?
-            QString() : settings.value(QLatin1String("outputFolder")).toString();
-
-    // Check for pre-existing output files.
-    const QString outputFileNameFormat =
-        settings.value(QLatin1String("outputFileNameFormat")).toString();
+    // Check for pre-existing output files, named from the details recorded by
+    // the last conversion, if any, rather than parsing the create file again.
     polar::v2::TrainingSession session(baseName);
+    session.setInputFiles(inputFiles);
     setTrainingSessionOptions(&session);
+    const QJsonObject naming = manifest.naming(baseName, inputs);
+    if (!naming.isEmpty()) {
+        session.setOutputNaming(namingFromJson(naming));
+    }
     {
         QStringList outputFileNames = session.getOutputFileNames(
-            outputFileNameFormat, outputDataFormats, outputDir);
+            options.outputFileNameFormat, options.outputFormats, options.outputFolder);
         bool foundNonExistentOutputFileName = false;
         for (int index = 0;
              (index < outputFileNames.count()) && (!foundNonExistentOutputFileName);
@@ -111,92 +191,161 @@ void ConverterThread::proccessSession(const QString &baseName)
                 foundNonExistentOutputFileName = true;
             }
         }
-        if ((!outputFileNames.isEmpty()) && (!foundNonExistentOutputFileName)) {
-            sessions.skipped++;
+        // Sessions converted before the manifest existed are assumed to be
+        // up to date if all of their output files exist.
+        if ((!outputFileNames.isEmpty()) && (!foundNonExistentOutputFileName) &&
+            (!manifest.contains(baseName))) {
+            manifest.update(baseName, inputs, outputOptions, outputFileNames,
+                            namingToJson(session.getOutputNaming()));
+            sessions.skipped.ref();
             return; // No need to process this training session.
         }
     }
 
     // Parse the training session.
     if (!session.parse()) {
-        sessions.failed++;
+        sessions.failed.ref();
         return;
     }
 
-    // Write the relevant output files.
+    // Resolve the output file names first, since that may update the session.
+    const QString outputBaseName = QString::fromLatin1("%1/%2")
+        .arg(options.outputFolder.isEmpty() ?
+             QFileInfo(baseName).dir().absolutePath() : options.outputFolder)
+        .arg(session.getOutputBaseFileName(options.outputFileNameFormat));
+
+    // Write the relevant output files, all formats concurrently.
+    typedef bool (polar::v2::TrainingSession::*FileWriter)(const QString &) const;
+    typedef QStringList (polar::v2::TrainingSession::*FilesWriter)(const QString &) const;
+    QFuture<bool> gpxWritten, tcxWritten;
+    QFuture<QStringList> hrmWritten;
+    if (options.outputFormats.testFlag(polar::v2::TrainingSession::GpxOutput)) {
+        gpxWritten = QtConcurrent::run(&session, static_cast<FileWriter>(
+            &polar::v2::TrainingSession::writeGPX), outputBaseName + QLatin1String(".gpx"));
+    }
+    if (options.outputFormats.testFlag(polar::v2::TrainingSession::HrmOutput)) {
+        hrmWritten = QtConcurrent::run(&session, static_cast<FilesWriter>(
+            &polar::v2::TrainingSession::writeHRM), outputBaseName);
+    }
+    if (options.outputFormats.testFlag(polar::v2::TrainingSession::TcxOutput)) {
+        tcxWritten = QtConcurrent::run(&session, static_cast<FileWriter>(
+            &polar::v2::TrainingSession::writeTCX), outputBaseName + QLatin1String(".tcx"));
+    }
+
     bool anyFailed = false;
-    if (settings.value(QLatin1String("gpxEnabled")).toBool()) {
-        const QString fileName = session.writeGPX(outputFileNameFormat, outputDir);
-        if (!fileName.isEmpty()) {
+    QStringList writtenFileNames;
+    if (options.outputFormats.testFlag(polar::v2::TrainingSession::GpxOutput)) {
+        const QString fileName = outputBaseName + QLatin1String(".gpx");
+        if (gpxWritten.result()) {
             qDebug() << "Wrote" << QDir::toNativeSeparators(fileName);
-            files.written++;
+            writtenFileNames.append(fileName);
+            files.written.ref();
         } else {
             anyFailed = true;
-            files.failed++;
+            files.failed.ref();
         }
     }
-    if (settings.value(QLatin1String("hrmEnabled")).toBool()) {
-        const QStringList fileNames = session.writeHRM(outputFileNameFormat, outputDir);
+    if (options.outputFormats.testFlag(polar::v2::TrainingSession::HrmOutput)) {
+        const QStringList fileNames = hrmWritten.result();
         foreach (const QString &fileName, fileNames) {
             qDebug() << "Wrote" << QDir::toNativeSeparators(fileName);
-            files.written++;
+            files.written.ref();
         }
+        writtenFileNames.append(fileNames);
         const int failedFilesCount = (fileNames.size() - (2 * session.exerciseCount()));
         if (failedFilesCount > 0) {
             anyFailed = true;
-            files.failed += failedFilesCount;
+            files.failed.fetchAndAddRelaxed(failedFilesCount);
         }
     }
-    if (settings.value(QLatin1String("tcxEnabled")).toBool()) {
-        const QString fileName = session.writeTCX(outputFileNameFormat, outputDir);
-        if (!fileName.isEmpty()) {
+    if (options.outputFormats.testFlag(polar::v2::TrainingSession::TcxOutput)) {
+        const QString fileName = outputBaseName + QLatin1String(".tcx");
+        if (tcxWritten.result()) {
             qDebug() << "Wrote" << QDir::toNativeSeparators(fileName);
-            files.written++;
+            writtenFileNames.append(fileName);
+            files.written.ref();
         } else {
             anyFailed = true;
-            files.failed++;
+            files.failed.ref();
         }
     }
     if (anyFailed) {
-        sessions.failed++;
+        sessions.failed.ref();
     } else {
-        sessions.processed++;
+        manifest.update(baseName, inputs, outputOptions, writtenFileNames,
+                        namingToJson(session.getOutputNaming()));
+        sessions.processed.ref();
     }
 }
 
 void ConverterThread::run()
 {
     // Reset counters.
-    memset(&files,    0, sizeof(files));
-    memset(&sessions, 0, sizeof(sessions));
+    files.failed.store(0);
+    files.written.store(0);
+    sessions.failed.store(0);
+    sessions.processed.store(0);
+    sessions.skipped.store(0);
+
+    // Snapshot the options once, so sessions never need to read the settings.
+    if (optionsFromSettings) {
+        options = ConversionOptions::fromSettings();
+    }
 
     // Find the base name of training sessions to consider for processing.
     findSessionBaseNames();
+    if (!options.manifestFileName.isEmpty()) {
+        manifest.setFileName(options.manifestFileName);
+    }
+    manifest.load();
 
-    // Process all found training sessions.
-    for (int index = 0; (index < baseNames.size()) && (!cancelled); ++index) {
-        emit progress(index);
-        proccessSession(baseNames.at(index));
+    // Process all found training sessions, spread across a pool of threads.
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, options.threadCount));
+    finishedSessions.fill(false, baseNames.size());
+    for (int index = 0; index < baseNames.size(); ++index) {
+        pool.start(new SessionRunnable(this, index));
     }
+
+    // Report progress in session order, as each becomes the first unfinished.
+    {
+        QMutexLocker locker(&progressMutex);
+        for (int index = 0; (index < baseNames.size()) && (!isCancelled()); ++index) {
+            emit progress(index);
+            while ((!finishedSessions.testBit(index)) && (!isCancelled())) {
+                progressCondition.wait(&progressMutex);
+            }
+        }
+    }
+
+    // Drop any sessions not yet started, and wait for the rest to finish.
+    if (isCancelled()) {
+        pool.clear();
+    }
+    pool.waitForDone();
+
+    // Record what was converted, so unchanged sessions can be skipped next time.
+    manifest.save();
+}
+
+void ConverterThread::sessionFinished(const int index)
+{
+    QMutexLocker locker(&progressMutex);
+    finishedSessions.setBit(index);
+    progressCondition.wakeAll();
 }
 
 void ConverterThread::setTrainingSessionOptions(polar::v2::TrainingSession * const session)
 {
     Q_CHECK_PTR(session);
-    QSettings settings;
-
-    settings.beginGroup(QLatin1String("gpx"));
-    settings.endGroup();
-
-    settings.beginGroup(QLatin1String("hrm"));
-    session->setHrmOption(polar::v2::TrainingSession::RrFiles,
-        settings.value(QLatin1String("rrFiles"), true).toBool());
-    session->setHrmOption(polar::v2::TrainingSession::LapNames,
-        settings.value(QLatin1String("lapNamesExt"), true).toBool());
-    settings.endGroup();
-
-    settings.beginGroup(QLatin1String("tcx"));
-    session->setTcxOption(polar::v2::TrainingSession::ForceTcxUTC,
-        settings.value(QLatin1String("utcOnly"), true).toBool());
-    settings.endGroup();
+
+    // Parsing each session's files concurrently only pays off when there are
+    // too few sessions to keep the session thread pool busy.
+    session->setParseOption(polar::v2::TrainingSession::ConcurrentParsing,
+        (options.concurrentParsing == ConversionOptions::AutomaticConcurrentParsing) ?
+            (baseNames.size() < QThread::idealThreadCount()) :
+            (options.concurrentParsing == ConversionOptions::AlwaysConcurrentParsing));
+
+    session->setHrmOptions(options.hrmOptions);
+    session->setTcxOptions(options.tcxOptions);
 }
@@ -20,8 +20,16 @@
 #ifndef __CONVERTER_THREAD__
 #define __CONVERTER_THREAD__
 
+#include "conversionmanifest.h"
+#include "conversionoptions.h"
+#include "sessionindex.h"
+
+#include <QAtomicInt>
+#include <QBitArray>
+#include <QMutex>
 #include <QStringList>
 #include <QThread>
+#include <QWaitCondition>
 
 namespace polar { namespace v2 { class TrainingSession; } }
 
@@ -31,23 +39,39 @@ class ConverterThread : public QThread {
     Q_PROPERTY(QStringList baseNames READ sessionBaseNames NOTIFY sessionBaseNamesChanged)
 
 public:
-    struct { int failed, written; } files;
-    struct { int failed, processed, skipped; } sessions;
+    struct { QAtomicInt failed, written; } files;
+    struct { QAtomicInt failed, processed, skipped; } sessions;
 
     ConverterThread(QObject * const parent = 0);
+    ConverterThread(const ConversionOptions &options, QObject * const parent = 0);
     bool isCancelled() const;
+    const ConversionOptions &conversionOptions() const;
     const QStringList &sessionBaseNames() const;
+    void setSessionIndex(const polar::v2::SessionIndex &index);
 
 public slots:
     void cancel();
 
 protected:
-    bool cancelled;
+    class SessionRunnable;
+    friend class SessionRunnable;
+
+    QAtomicInt cancelled;
     QStringList baseNames;
+    polar::v2::SessionIndex sessionIndex;
+    bool sessionsIndexed; ///< If set, sessionIndex was given; don't list input folders.
+    ConversionManifest manifest;
+    ConversionOptions options;
+    bool optionsFromSettings;
+
+    QMutex progressMutex;
+    QWaitCondition progressCondition;
+    QBitArray finishedSessions;
 
     void findSessionBaseNames();
     void proccessSession(const QString &baseName);
     virtual void run();
+    void sessionFinished(const int index);
     virtual void setTrainingSessionOptions(polar::v2::TrainingSession * const session);
 
 signals:
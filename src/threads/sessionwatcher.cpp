@@ -0,0 +1,158 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sessionwatcher.h"
+
+#include "conversionmanifest.h"
+#include "converterthread.h"
+
+#include <QDebug>
+#include <QDir>
+
+SessionWatcher::SessionWatcher(const ConversionOptions &options, QObject * const parent)
+    : QObject(parent), options(options), converter(NULL)
+{
+    debounceTimer.setInterval(5000);
+    debounceTimer.setSingleShot(true);
+    connect(&debounceTimer, SIGNAL(timeout()), this, SLOT(convertPendingSessions()));
+    connect(&watcher, SIGNAL(directoryChanged(QString)), this, SLOT(folderChanged(QString)));
+}
+
+SessionWatcher::~SessionWatcher()
+{
+    if (converter) {
+        converter->cancel();
+        converter->wait();
+    }
+}
+
+int SessionWatcher::debounceInterval() const
+{
+    return debounceTimer.interval();
+}
+
+/**
+ * @brief Set how long the input folders must be quiet before queued sessions
+ *        are converted.
+ *
+ * @param msec Debounce interval, in milliseconds.
+ */
+void SessionWatcher::setDebounceInterval(const int msec)
+{
+    debounceTimer.setInterval(msec);
+}
+
+/**
+ * @brief Begin watching the input folders.
+ *
+ * All sessions already present are queued too, and converted immediately, so
+ * that nothing synced while not watching is missed. Sessions converted
+ * previously are skipped cheaply, via the conversion manifest.
+ *
+ * @return \c true if at least one input folder is being watched.
+ */
+bool SessionWatcher::start()
+{
+    foreach (const QString &folder, options.inputFolders) {
+        if (watcher.addPath(folder)) {
+            qDebug() << "Watching" << QDir::toNativeSeparators(folder);
+            scanFolder(folder);
+        } else {
+            qWarning() << "Failed to watch" << QDir::toNativeSeparators(folder);
+        }
+    }
+    convertPendingSessions();
+    return !watcher.directories().isEmpty();
+}
+
+/**
+ * @brief Index a single input folder, queuing any sessions that are new, or
+ *        whose files have changed since the folder was last indexed.
+ *
+ * @param folder Input folder to index.
+ *
+ * @return The number of sessions found to be new or changed.
+ */
+int SessionWatcher::scanFolder(const QString &folder)
+{
+    polar::v2::SessionIndex index;
+    index.addFolder(folder);
+
+    int count = 0;
+    foreach (const QString &baseName, index.baseNames()) {
+        const QJsonObject inputs =
+            ConversionManifest::fingerprintInputs(index.value(baseName).files);
+        QHash<QString, QJsonObject>::iterator fingerprint = fingerprints.find(baseName);
+        if (fingerprint == fingerprints.end()) {
+            fingerprints.insert(baseName, inputs);
+        } else if (fingerprint.value() != inputs) {
+            fingerprint.value() = inputs;
+        } else {
+            continue; // Unchanged since last seen.
+        }
+        pendingSessions.insert(baseName, index.value(baseName));
+        ++count;
+    }
+    return count;
+}
+
+// Protected slots.
+
+void SessionWatcher::convertPendingSessions()
+{
+    if ((converter) || (pendingSessions.isEmpty())) {
+        return; // Pending sessions will be converted once the converter finishes.
+    }
+
+    // Hand the files already found to the converter, in base name order.
+    polar::v2::SessionIndex index;
+    for (QMap<QString, polar::v2::SessionFiles>::const_iterator session =
+         pendingSessions.constBegin(); session != pendingSessions.constEnd(); ++session) {
+        foreach (const QFileInfo &fileInfo, session.value().files) {
+            index.addFile(session.key(), fileInfo);
+        }
+    }
+    pendingSessions.clear();
+    qDebug() << "Converting" << index.baseNames().size() << "changed training session(s)";
+
+    converter = new ConverterThread(options, this);
+    converter->setSessionIndex(index);
+    connect(converter, SIGNAL(finished()), this, SLOT(converterFinished()));
+    converter->start();
+}
+
+void SessionWatcher::converterFinished()
+{
+    Q_CHECK_PTR(converter);
+    emit conversionFinished(converter);
+    converter->deleteLater();
+    converter = NULL;
+
+    // Sessions may have changed again while converting.
+    if (!pendingSessions.isEmpty()) {
+        debounceTimer.start();
+    }
+}
+
+void SessionWatcher::folderChanged(const QString &folder)
+{
+    if (scanFolder(folder) > 0) {
+        debounceTimer.start(); // (Re)start the quiet period.
+    }
+}
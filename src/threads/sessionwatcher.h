@@ -0,0 +1,83 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SESSION_WATCHER__
+#define __SESSION_WATCHER__
+
+#include "conversionoptions.h"
+#include "sessionindex.h"
+
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QJsonObject>
+#include <QMap>
+#include <QObject>
+#include <QTimer>
+
+class ConverterThread;
+
+/**
+ * @brief Watches input folders, converting training sessions as they change.
+ *
+ * Each change to an input folder re-indexes just that folder, and queues any
+ * sessions whose files are new or have changed since last seen, along with the
+ * files found, so the converter need not list the folders again. Since the
+ * FlowSync hook writes a session's files one at a time, queued sessions are
+ * only converted once the folders have been quiet for the debounce interval.
+ *
+ * Note, QFileSystemWatcher::directoryChanged is only emitted when files are
+ * added to, removed from or renamed within a folder, not when an existing file
+ * is rewritten in place. Such rewrites are picked up by the next change to the
+ * same folder (or the next start()), since each scan compares every session's
+ * file sizes and modification times. Watching every session file as well would
+ * soon exhaust the platform's watch limits (eg inotify's) for large folders.
+ */
+class SessionWatcher : public QObject {
+    Q_OBJECT
+
+public:
+    SessionWatcher(const ConversionOptions &options, QObject * const parent = 0);
+    virtual ~SessionWatcher();
+
+    int debounceInterval() const;
+    void setDebounceInterval(const int msec);
+
+    bool start();
+
+signals:
+    void conversionFinished(const ConverterThread * converter);
+
+protected:
+    ConversionOptions options;
+    QFileSystemWatcher watcher;
+    QTimer debounceTimer;
+    QHash<QString, QJsonObject> fingerprints;
+    QMap<QString, polar::v2::SessionFiles> pendingSessions; ///< Keyed by base name.
+    ConverterThread * converter;
+
+    int scanFolder(const QString &folder);
+
+protected slots:
+    void convertPendingSessions();
+    void converterFinished();
+    void folderChanged(const QString &folder);
+
+};
+
+#endif // __SESSION_WATCHER__
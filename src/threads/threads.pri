@@ -1,4 +1,4 @@
 INCLUDEPATH += $$PWD
 VPATH += $$PWD
-HEADERS += converterthread.h
-SOURCES += converterthread.cpp
+HEADERS += conversionmanifest.h   conversionoptions.h   converterthread.h   sessionwatcher.h
+SOURCES += conversionmanifest.cpp conversionoptions.cpp converterthread.cpp sessionwatcher.cpp
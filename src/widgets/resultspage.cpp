@@ -183,22 +183,22 @@ void ResultsPage::conversionFinished()
     } else {
         qDebug() << "Processing finished.";
         setTitle(tr("Processing Finished"));
-        if ((converter->sessions.failed == 0) &&
-            (converter->sessions.processed == 0)) {
+        if ((converter->sessions.failed.load() == 0) &&
+            (converter->sessions.processed.load() == 0)) {
             setSubTitle(tr("Found no new training sessions to process."));
         } else {
             setSubTitle(tr("Successfully processed %1 of %2 new training sessions.")
-                        .arg(converter->sessions.processed)
-                        .arg(converter->sessions.processed + converter->sessions.failed));
+                        .arg(converter->sessions.processed.load())
+                        .arg(converter->sessions.processed.load() + converter->sessions.failed.load()));
         }
         progressBar->setValue(progressBar->maximum());
         qDebug() << tr("Skipped %1 training sessions processed previsouly.")
-                    .arg(converter->sessions.skipped).toUtf8().constData();
+                    .arg(converter->sessions.skipped.load()).toUtf8().constData();
         qDebug() << tr("Wrote %1 of %2 files for %3 of %4 new training sessions.")
-                    .arg(converter->files.written)
-                    .arg(converter->files.written + converter->files.failed)
-                    .arg(converter->sessions.processed)
-                    .arg(converter->sessions.processed + converter->sessions.failed)
+                    .arg(converter->files.written.load())
+                    .arg(converter->files.written.load() + converter->files.failed.load())
+                    .arg(converter->sessions.processed.load())
+                    .arg(converter->sessions.processed.load() + converter->sessions.failed.load())
                     .toUtf8().constData();
     }
     setButtonText(QWizard::FinishButton, tr("Close"));
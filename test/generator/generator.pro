@@ -0,0 +1,27 @@
+# Create a console application for generating synthetic training sessions.
+TARGET = sessiongenerator
+TEMPLATE = app
+CONFIG += console warn_on
+CONFIG -= app_bundle
+QT -= gui
+SOURCES += main.cpp
+
+# QCommandLineParser was added in Qt 5.2.
+lessThan(QT_MAJOR_VERSION,5)|lessThan(QT_MINOR_VERSION,2): error(sessiongenerator requires Qt 5.2 or later)
+
+# Disable automatic ASCII conversions (best practice for internationalization).
+DEFINES += QT_NO_CAST_FROM_ASCII QT_NO_CAST_TO_ASCII
+
+# Neaten the output directories.
+CONFIG(debug,debug|release) DESTDIR = debug
+CONFIG(release,debug|release) DESTDIR = release
+MOC_DIR = $$DESTDIR/tmp
+OBJECTS_DIR = $$DESTDIR/tmp
+RCC_DIR = $$DESTDIR/tmp
+UI_DIR = $$DESTDIR/tmp
+
+# Share the generator (but none of the test helpers) with the test target.
+INCLUDEPATH += ../tools
+VPATH += ../tools
+HEADERS += sessiongenerator.h
+SOURCES += sessiongenerator.cpp
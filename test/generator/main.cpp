@@ -0,0 +1,143 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sessiongenerator.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+
+#include <stdio.h>
+
+// Exit codes.
+#define EXIT_OK           0
+#define EXIT_WRITE_FAILED 1
+#define EXIT_INVALID_ARGS 2
+
+// Get an integer option value of at least minimum, or -1 if invalid.
+static int intValue(const QCommandLineParser &parser, const QCommandLineOption &option,
+                    const int minimum = 0)
+{
+    bool ok = false;
+    const int value = parser.value(option).toInt(&ok);
+    if ((!ok) || (value < minimum)) {
+        fprintf(stderr, "%s\n", qPrintable(QCoreApplication::translate("main",
+            "Invalid %1 value: %2").arg(option.names().last()).arg(parser.value(option))));
+        return -1;
+    }
+    return value;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    // Parse the command line.
+    QCommandLineParser parser;
+    parser.setApplicationDescription(app.translate("main",
+        "Generate synthetic Polar v2 training sessions, for scale testing."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QLatin1String("folder"), app.translate("main",
+        "Folder to write the training sessions to."));
+    const QCommandLineOption sessionsOption(QStringList()
+        << QLatin1String("s") << QLatin1String("sessions"), app.translate("main",
+        "Number of training sessions to generate."), QLatin1String("count"), QLatin1String("1"));
+    const QCommandLineOption durationOption(QStringList()
+        << QLatin1String("d") << QLatin1String("duration"), app.translate("main",
+        "Duration of each exercise, in seconds."), QLatin1String("seconds"), QLatin1String("3600"));
+    const QCommandLineOption intervalOption(QStringList()
+        << QLatin1String("i") << QLatin1String("interval"), app.translate("main",
+        "Sample interval, in milliseconds."), QLatin1String("msec"), QLatin1String("1000"));
+    const QCommandLineOption exercisesOption(QStringList()
+        << QLatin1String("e") << QLatin1String("exercises"), app.translate("main",
+        "Number of exercises in each session."), QLatin1String("count"), QLatin1String("1"));
+    const QCommandLineOption lapsOption(QStringList()
+        << QLatin1String("l") << QLatin1String("laps"), app.translate("main",
+        "Number of manual laps in each exercise."), QLatin1String("count"), QLatin1String("1"));
+    const QCommandLineOption offlineOption(QLatin1String("offline"), app.translate("main",
+        "Number of sensor dropouts in each exercise."), QLatin1String("count"), QLatin1String("0"));
+    const QCommandLineOption offlineLengthOption(QLatin1String("offline-length"),
+        app.translate("main", "Number of samples in each sensor dropout."),
+        QLatin1String("count"), QLatin1String("30"));
+    const QCommandLineOption gzipOption(QStringList()
+        << QLatin1String("z") << QLatin1String("gzip"), app.translate("main",
+        "Gzip the generated files, as FlowSync does."));
+    const QCommandLineOption noRouteOption(QLatin1String("no-route"),
+        app.translate("main", "Do not generate GPS routes."));
+    const QCommandLineOption noRrOption(QLatin1String("no-rr"),
+        app.translate("main", "Do not generate R-R interval samples."));
+    parser.addOption(sessionsOption);
+    parser.addOption(durationOption);
+    parser.addOption(intervalOption);
+    parser.addOption(exercisesOption);
+    parser.addOption(lapsOption);
+    parser.addOption(offlineOption);
+    parser.addOption(offlineLengthOption);
+    parser.addOption(gzipOption);
+    parser.addOption(noRouteOption);
+    parser.addOption(noRrOption);
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1) {
+        fprintf(stderr, "%s\n", qPrintable(app.translate("main",
+            "Exactly one output folder is required.")));
+        return EXIT_INVALID_ARGS;
+    }
+    const QDir folder(parser.positionalArguments().first());
+    if (!folder.exists()) {
+        fprintf(stderr, "%s\n", qPrintable(app.translate("main",
+            "Output folder does not exist: %1").arg(folder.path())));
+        return EXIT_INVALID_ARGS;
+    }
+
+    const int sessions      = intValue(parser, sessionsOption);
+    const int duration      = intValue(parser, durationOption, 1);
+    const int interval      = intValue(parser, intervalOption, 1);
+    const int exercises     = intValue(parser, exercisesOption, 1);
+    const int laps          = intValue(parser, lapsOption);
+    const int offline       = intValue(parser, offlineOption);
+    const int offlineLength = intValue(parser, offlineLengthOption);
+    if ((sessions < 0) || (duration < 0) || (interval < 0) || (exercises < 0) ||
+        (laps < 0) || (offline < 0) || (offlineLength < 0)) {
+        return EXIT_INVALID_ARGS;
+    }
+
+    tools::SessionGenerator generator;
+    generator.setDuration(duration);
+    generator.setExerciseCount(exercises);
+    generator.setGzipped(parser.isSet(gzipOption));
+    generator.setLapCount(laps);
+    generator.setOfflineRanges(offline, offlineLength);
+    generator.setRoute(!parser.isSet(noRouteOption));
+    generator.setRrSamples(!parser.isSet(noRrOption));
+    generator.setSampleInterval(interval);
+
+    // Sessions start a day apart, so their output file names never collide.
+    const QDateTime startTime(QDate(2014, 10, 1), QTime(6, 0));
+    for (int session = 0; session < sessions; ++session) {
+        generator.setStartTime(startTime.addDays(session), 600);
+        const QString baseName = folder.absoluteFilePath(QString::fromLatin1(
+            "v2-users-0000000-training-sessions-%1").arg(1000001 + session));
+        const QStringList fileNames = generator.write(baseName);
+        if (fileNames.isEmpty()) {
+            return EXIT_WRITE_FAILED;
+        }
+        fprintf(stdout, "%s\n", qPrintable(QDir::toNativeSeparators(baseName)));
+    }
+    return EXIT_OK;
+}
@@ -0,0 +1,246 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchtrainingsession.h"
+
+#include "../../src/polar/v2/inflatedevice.h"
+#include "../../src/polar/v2/trainingsession.h"
+#include "../../tools/sessiongenerator.h"
+
+#include <QBuffer>
+#include <QDebug>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+// The real capture benchmarked alongside the synthetic sessions.
+#define SOURCE_SESSION  "training-sessions-22165267"
+#define SOURCE_EXERCISE "-exercises-22141894"
+
+// The (first) exercise of each generated session.
+#define SYNTHETIC_EXERCISE "-exercises-1000001"
+
+// Exposes TrainingSession's protected parsers and state for benchmarking.
+class BenchmarkSession : public polar::v2::TrainingSession {
+public:
+    BenchmarkSession(const QString &baseName) : TrainingSession(baseName) { }
+    using TrainingSession::isGzipped;
+    using TrainingSession::parsedExercises;
+    using TrainingSession::parseRoute;
+    using TrainingSession::parseSamples;
+};
+
+// Read a (possibly gzipped) testdata file, uncompressed.
+static QByteArray readUncompressed(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open" << fileName;
+        return QByteArray();
+    }
+    if (!BenchmarkSession::isGzipped(file)) {
+        return file.readAll();
+    }
+    polar::v2::InflateDevice inflater(&file);
+    return (inflater.open(QIODevice::ReadOnly)) ? inflater.readAll() : QByteArray();
+}
+
+BenchTrainingSession::BenchTrainingSession() : syntheticDir(NULL)
+{
+
+}
+
+/**
+ * @brief Add benchmark rows for an exercise file of the given type, from both
+ *        the real testdata session and the synthetic 24-hour session.
+ *
+ * Each file is benchmarked as production reads it (gzipped, from a local
+ * file), and pre-inflated in memory, to separate decoding from inflating.
+ */
+void BenchTrainingSession::addExerciseFileRows(const char * const type)
+{
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<bool>("preInflate");
+
+    const QString sourceFileName = QFINDTESTDATA(
+        QLatin1String("testdata/" SOURCE_SESSION SOURCE_EXERCISE "-") + QLatin1String(type));
+    const QString syntheticFileName = syntheticDir->path() +
+        QLatin1String("/synthetic-24h" SYNTHETIC_EXERCISE "-") + QLatin1String(type);
+    QTest::newRow(SOURCE_SESSION)                << sourceFileName    << false;
+    QTest::newRow(SOURCE_SESSION ":inflated")    << sourceFileName    << true;
+    QTest::newRow("synthetic-24h")               << syntheticFileName << false;
+    QTest::newRow("synthetic-24h:inflated")      << syntheticFileName << true;
+}
+
+/**
+ * @brief Add benchmark rows for all real testdata sessions, and synthetic
+ *        sessions of 1, 6 and 24 hours.
+ */
+void BenchTrainingSession::addSessionRows()
+{
+    QTest::addColumn<QString>("baseName");
+
+    #define ADD_TESTDATA_ROW(name) { \
+        QString baseName = QFINDTESTDATA("testdata/" name "-create"); \
+        baseName.chop(7); \
+        QTest::newRow(name) << baseName; \
+    }
+    ADD_TESTDATA_ROW("training-sessions-19401412");
+    ADD_TESTDATA_ROW("training-sessions-19946380");
+    ADD_TESTDATA_ROW("training-sessions-22165267");
+    #undef ADD_TESTDATA_ROW
+
+    QTest::newRow("synthetic-1h")  << syntheticDir->path() + QLatin1String("/synthetic-1h");
+    QTest::newRow("synthetic-6h")  << syntheticDir->path() + QLatin1String("/synthetic-6h");
+    QTest::newRow("synthetic-24h") << syntheticDir->path() + QLatin1String("/synthetic-24h");
+}
+
+/**
+ * @brief Generate synthetic long sessions, with 1 Hz samples and GPS, R-R
+ *        intervals, hourly laps and a few sensor dropouts.
+ */
+void BenchTrainingSession::initTestCase()
+{
+    syntheticDir = new QTemporaryDir;
+    QVERIFY(syntheticDir->isValid());
+
+    const int hours[] = { 1, 6, 24 };
+    for (size_t index = 0; index < sizeof(hours)/sizeof(hours[0]); ++index) {
+        tools::SessionGenerator generator;
+        generator.setDuration(hours[index] * 3600);
+        generator.setGzipped(true);
+        generator.setLapCount(hours[index]);
+        generator.setOfflineRanges(hours[index], 30);
+        QVERIFY(!generator.write(QString::fromLatin1("%1/synthetic-%2h")
+            .arg(syntheticDir->path()).arg(hours[index])).isEmpty());
+    }
+}
+
+void BenchTrainingSession::cleanupTestCase()
+{
+    delete syntheticDir;
+    syntheticDir = NULL;
+}
+
+void BenchTrainingSession::parseRoute_data()
+{
+    addExerciseFileRows("route");
+}
+
+void BenchTrainingSession::parseRoute()
+{
+    QFETCH(QString, fileName);
+    QFETCH(bool, preInflate);
+    QByteArray data = (preInflate) ? readUncompressed(fileName) : QByteArray();
+    const BenchmarkSession session(QLatin1String("ignored"));
+    polar::v2::ExerciseData::Route route;
+    QBENCHMARK {
+        if (preInflate) {
+            QBuffer buffer(&data);
+            buffer.open(QIODevice::ReadOnly);
+            session.parseRoute(buffer, route);
+        } else {
+            QFile file(fileName);
+            file.open(QIODevice::ReadOnly);
+            session.parseRoute(file, route);
+        }
+    }
+    QVERIFY(!route.isEmpty());
+}
+
+void BenchTrainingSession::parseSamples_data()
+{
+    addExerciseFileRows("samples");
+}
+
+void BenchTrainingSession::parseSamples()
+{
+    QFETCH(QString, fileName);
+    QFETCH(bool, preInflate);
+    QByteArray data = (preInflate) ? readUncompressed(fileName) : QByteArray();
+    const BenchmarkSession session(QLatin1String("ignored"));
+    polar::v2::ExerciseData::Samples samples;
+    QBENCHMARK {
+        if (preInflate) {
+            QBuffer buffer(&data);
+            buffer.open(QIODevice::ReadOnly);
+            session.parseSamples(buffer, samples);
+        } else {
+            QFile file(fileName);
+            file.open(QIODevice::ReadOnly);
+            session.parseSamples(file, samples);
+        }
+    }
+    QVERIFY(!samples.isEmpty());
+}
+
+void BenchTrainingSession::writeGPX_data()
+{
+    addSessionRows();
+}
+
+void BenchTrainingSession::writeGPX()
+{
+    QFETCH(QString, baseName);
+    BenchmarkSession session(baseName);
+    QVERIFY(session.parse());
+    const QDateTime creationTime = QDateTime::currentDateTimeUtc();
+    QBENCHMARK {
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        session.writeGPX(buffer, creationTime);
+    }
+}
+
+void BenchTrainingSession::writeHRM_data()
+{
+    addSessionRows();
+}
+
+void BenchTrainingSession::writeHRM()
+{
+    QFETCH(QString, baseName);
+    BenchmarkSession session(baseName);
+    QVERIFY(session.parse());
+    const QStringList exerciseIds = session.parsedExercises.keys();
+    QBENCHMARK {
+        foreach (const QString &exerciseId, exerciseIds) {
+            QBuffer buffer;
+            buffer.open(QIODevice::WriteOnly);
+            session.writeHRM(buffer, exerciseId);
+        }
+    }
+}
+
+void BenchTrainingSession::writeTCX_data()
+{
+    addSessionRows();
+}
+
+void BenchTrainingSession::writeTCX()
+{
+    QFETCH(QString, baseName);
+    BenchmarkSession session(baseName);
+    QVERIFY(session.parse());
+    QBENCHMARK {
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        session.writeTCX(buffer);
+    }
+}
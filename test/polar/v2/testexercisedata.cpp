@@ -0,0 +1,194 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testexercisedata.h"
+
+#include "../../src/polar/v2/exercisedata.h"
+
+#include <QTest>
+
+namespace {
+
+QVariantMap offlineEntry(const quint64 startIndex, const quint64 stopIndex)
+{
+    QVariantMap entry;
+    entry.insert(QLatin1String("start-index"), QVariantList() << startIndex);
+    entry.insert(QLatin1String("stop-index"), QVariantList() << stopIndex);
+    return entry;
+}
+
+}
+
+void TestExerciseData::exerciseData()
+{
+    QVariantMap route;
+    route.insert(QLatin1String("duration"), QVariantList() << Q_UINT64_C(0) << Q_UINT64_C(1000));
+    route.insert(QLatin1String("latitude"), QVariantList() << -37.784721666666667 << -37.7848);
+    route.insert(QLatin1String("altitude"), QVariantList() << Q_INT64_C(-5) << Q_INT64_C(12));
+
+    QVariantMap samples;
+    samples.insert(QLatin1String("heartrate"), QVariantList() << Q_UINT64_C(80) << Q_UINT64_C(81));
+    samples.insert(QLatin1String("heartrate-offline"), QVariantList() << offlineEntry(1, 1));
+    samples.insert(QLatin1String("speed"), QVariantList() << 1.5f << 2.25f << 3.0f);
+
+    QVariantMap rrSamples;
+    rrSamples.insert(QLatin1String("value"), QVariantList() << Q_UINT64_C(750) << Q_UINT64_C(760));
+
+    QVariantMap exercise;
+    exercise.insert(QLatin1String("route"), route);
+    exercise.insert(QLatin1String("rrsamples"), rrSamples);
+    exercise.insert(QLatin1String("samples"), samples);
+
+    const polar::v2::ExerciseData data(exercise);
+    QCOMPARE(data.route.duration.size(), 2);
+    QCOMPARE(data.route.duration.at(1), 1000u);
+    QCOMPARE(data.route.latitude.at(0), -37.784721666666667);
+    QCOMPARE(data.route.altitude.at(0), -5);
+    QVERIFY(data.route.longitude.isEmpty());
+    QVERIFY(data.route.satellites.isEmpty());
+
+    QCOMPARE(data.samples.heartrate.size(), 2);
+    QCOMPARE(data.samples.heartrate.at(0), 80u);
+    QVERIFY(!data.samples.heartrate.isOffline(0));
+    QVERIFY(data.samples.heartrate.isOffline(1));
+    QCOMPARE(data.samples.speed.size(), 3);
+    QCOMPARE(data.samples.speed.at(1), 2.25f);
+    QVERIFY(data.samples.altitude.isEmpty());
+    QVERIFY(data.samples.cadence.isEmpty());
+
+    QCOMPARE(data.rrSamples, QVector<quint32>() << 750 << 760);
+}
+
+void TestExerciseData::sampleChannel_data()
+{
+    QTest::addColumn<QVariantList>("list");
+    QTest::addColumn<QStringList>("strings");
+
+    QTest::newRow("empty") << QVariantList() << QStringList();
+
+    QTest::newRow("uint64") << (QVariantList()
+        << Q_UINT64_C(0) << Q_UINT64_C(1) << Q_UINT64_C(123) << Q_UINT64_C(4294967295))
+        << (QStringList() << QLatin1String("0") << QLatin1String("1")
+                          << QLatin1String("123") << QLatin1String("4294967295"));
+
+    QTest::newRow("float") << (QVariantList()
+        << 0.0f << 1.5f << -123.456f << 9.8765432f)
+        << (QStringList() << QLatin1String("0") << QLatin1String("1.5")
+                          << QLatin1String("-123.456") << QLatin1String("9.87654"));
+}
+
+void TestExerciseData::sampleChannel()
+{
+    QFETCH(QVariantList, list);
+    QFETCH(QStringList, strings);
+
+    // Typed channels, however built, should format values to their types' precisions.
+    if ((list.isEmpty()) || (list.first().type() == QVariant::ULongLong)) {
+        const polar::v2::SampleChannel<quint32> channel(list);
+        QVector<quint32> values;
+        foreach (const QVariant &value, list) {
+            values.append(value.toUInt());
+        }
+        const polar::v2::SampleChannel<quint32> fromVector(values);
+        QCOMPARE(channel.size(), list.size());
+        QCOMPARE(channel.isEmpty(), list.isEmpty());
+        QCOMPARE(fromVector.size(), list.size());
+        for (int index = 0; index < list.size(); ++index) {
+            QCOMPARE(channel.at(index), list.at(index).toUInt());
+            QCOMPARE(channel.toString(index), strings.at(index));
+            QCOMPARE(fromVector.at(index), channel.at(index));
+            QCOMPARE(fromVector.toString(index), strings.at(index));
+            QVERIFY(!channel.isOffline(index));
+        }
+    } else {
+        const polar::v2::SampleChannel<float> channel(list);
+        QVector<float> values;
+        foreach (const QVariant &value, list) {
+            values.append(value.toFloat());
+        }
+        const polar::v2::SampleChannel<float> fromVector(values);
+        QCOMPARE(channel.size(), list.size());
+        QCOMPARE(channel.isEmpty(), list.isEmpty());
+        QCOMPARE(fromVector.size(), list.size());
+        for (int index = 0; index < list.size(); ++index) {
+            QCOMPARE(channel.at(index), list.at(index).toFloat());
+            QCOMPARE(channel.toString(index), strings.at(index));
+            QCOMPARE(fromVector.at(index), channel.at(index));
+            QCOMPARE(fromVector.toString(index), strings.at(index));
+            QVERIFY(!channel.isOffline(index));
+        }
+    }
+}
+
+void TestExerciseData::sampleChannelOffline_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<QVariantList>("offline");
+    QTest::addColumn<QBitArray>("expected");
+    QTest::addColumn<bool>("haveAnyOnline");
+
+    QTest::newRow("empty") << 0 << QVariantList() << QBitArray() << false;
+
+    QTest::newRow("online") << 3 << QVariantList() << QBitArray(3) << true;
+
+    {
+        QBitArray expected(4);
+        expected.setBit(1);
+        expected.setBit(3);
+        QTest::newRow("start-index")
+            << 4 << (QVariantList() << offlineEntry(1, 2) << offlineEntry(3, 3))
+            << expected << true;
+    }
+
+    {
+        QBitArray expected(2);
+        expected.setBit(0);
+        expected.setBit(1);
+        QTest::newRow("all offline")
+            << 2 << (QVariantList() << offlineEntry(0, 0) << offlineEntry(1, 1))
+            << expected << false;
+    }
+
+    {
+        QBitArray expected(2);
+        expected.setBit(1);
+        QTest::newRow("out of range")
+            << 2 << (QVariantList() << offlineEntry(1, 1) << offlineEntry(5, 5))
+            << expected << true;
+    }
+}
+
+void TestExerciseData::sampleChannelOffline()
+{
+    QFETCH(int, size);
+    QFETCH(QVariantList, offline);
+    QFETCH(QBitArray, expected);
+    QFETCH(bool, haveAnyOnline);
+
+    QVariantList list;
+    for (int index = 0; index < size; ++index) {
+        list << Q_UINT64_C(100);
+    }
+
+    const polar::v2::SampleChannel<quint32> channel(list, offline);
+    for (int index = 0; index < size + 2; ++index) {
+        QCOMPARE(channel.isOffline(index), (index < size) && (expected.testBit(index)));
+    }
+    QCOMPARE(channel.haveAnyOnline(), haveAnyOnline);
+}
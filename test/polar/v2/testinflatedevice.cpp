@@ -0,0 +1,162 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testinflatedevice.h"
+
+#include "../../src/polar/v2/inflatedevice.h"
+
+#include <QBuffer>
+#include <QFile>
+#include <QFileInfo>
+#include <QTest>
+
+void TestInflateDevice::readAll_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<QByteArray>("expected");
+    QTest::addColumn<int>("chunkSize");
+
+    #define LOAD_TEST_DATA(name, chunkSize) { \
+        QFile dataFile(QFINDTESTDATA("testdata/" name ".gz")); \
+        dataFile.open(QIODevice::ReadOnly); \
+        QFile expectedFile(QFINDTESTDATA("testdata/" name)); \
+        expectedFile.open(QIODevice::ReadOnly); \
+        QTest::newRow(name ":" #chunkSize) \
+            << dataFile.readAll() << expectedFile.readAll() << chunkSize; \
+    }
+
+    LOAD_TEST_DATA("lorem-ipsum.txt", 1);
+    LOAD_TEST_DATA("lorem-ipsum.txt", 16384);
+    LOAD_TEST_DATA("random-bytes", 1);
+    LOAD_TEST_DATA("random-bytes", 16384);
+
+    #undef LOAD_TEST_DATA
+
+    // Every member of a multi-member stream is inflated, in order.
+    {
+        QFile loremFile(QFINDTESTDATA("testdata/lorem-ipsum.txt.gz"));
+        loremFile.open(QIODevice::ReadOnly);
+        QFile randomFile(QFINDTESTDATA("testdata/random-bytes.gz"));
+        randomFile.open(QIODevice::ReadOnly);
+        const QByteArray data = loremFile.readAll() + randomFile.readAll();
+        QFile loremExpected(QFINDTESTDATA("testdata/lorem-ipsum.txt"));
+        loremExpected.open(QIODevice::ReadOnly);
+        QFile randomExpected(QFINDTESTDATA("testdata/random-bytes"));
+        randomExpected.open(QIODevice::ReadOnly);
+        const QByteArray expected = loremExpected.readAll() + randomExpected.readAll();
+        QTest::newRow("multi-member:1") << data << expected << 1;
+        QTest::newRow("multi-member:16384") << data << expected << 16384;
+    }
+}
+
+void TestInflateDevice::readAll()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(QByteArray, expected);
+    QFETCH(int, chunkSize);
+
+    QVERIFY2(!data.isEmpty(), "failed to load testdata");
+    QVERIFY2(!expected.isEmpty(), "failed to load testdata");
+
+    QBuffer source(&data);
+    QVERIFY(source.open(QIODevice::ReadOnly));
+    polar::v2::InflateDevice inflater(&source, NULL, chunkSize);
+    QVERIFY(inflater.open(QIODevice::ReadOnly));
+    QVERIFY(inflater.isSequential());
+    QCOMPARE(inflater.readAll(), expected);
+    QVERIFY(inflater.atEnd());
+    QCOMPARE(inflater.inflatedSize(), qint64(expected.size()));
+
+    // Inflating straight from memory should give the same result.
+    polar::v2::InflateDevice memoryInflater(data);
+    QVERIFY(memoryInflater.open(QIODevice::ReadOnly));
+    QCOMPARE(memoryInflater.readAll(), expected);
+    QVERIFY(memoryInflater.atEnd());
+    QCOMPARE(memoryInflater.inflatedSize(), qint64(expected.size()));
+}
+
+void TestInflateDevice::readTruncated_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QFile dataFile(QFINDTESTDATA("testdata/lorem-ipsum.txt.gz"));
+    dataFile.open(QIODevice::ReadOnly);
+    const QByteArray data = dataFile.readAll();
+
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("header") << data.left(10);
+    QTest::newRow("no trailer") << data.left(data.size() - 8);
+    QTest::newRow("truncated member") << (data + data.left(10));
+    QTest::newRow("trailing garbage") << (data + QByteArray(32, 'x'));
+}
+
+void TestInflateDevice::readTruncated()
+{
+    QFETCH(QByteArray, data);
+
+    QBuffer source(&data);
+    QVERIFY(source.open(QIODevice::ReadOnly));
+    polar::v2::InflateDevice inflater(&source);
+    QVERIFY(inflater.open(QIODevice::ReadOnly));
+    inflater.readAll();
+    QVERIFY(!inflater.atEnd());
+
+    polar::v2::InflateDevice memoryInflater(data);
+    QVERIFY(memoryInflater.open(QIODevice::ReadOnly));
+    memoryInflater.readAll();
+    QVERIFY(!memoryInflater.atEnd());
+}
+
+void TestInflateDevice::uncompressedSizeHint_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<qint64>("expected");
+
+    QFile loremFile(QFINDTESTDATA("testdata/lorem-ipsum.txt.gz"));
+    loremFile.open(QIODevice::ReadOnly);
+    const QByteArray lorem = loremFile.readAll();
+    QFile randomFile(QFINDTESTDATA("testdata/random-bytes.gz"));
+    randomFile.open(QIODevice::ReadOnly);
+    const QByteArray random = randomFile.readAll();
+
+    QTest::newRow("lorem-ipsum.txt")
+        << lorem << qint64(QFileInfo(QFINDTESTDATA("testdata/lorem-ipsum.txt")).size());
+    QTest::newRow("random-bytes")
+        << random << qint64(QFileInfo(QFINDTESTDATA("testdata/random-bytes")).size());
+    QTest::newRow("multi-member") // Last member's size.
+        << (lorem + random) << qint64(QFileInfo(QFINDTESTDATA("testdata/random-bytes")).size());
+    QTest::newRow("empty") << QByteArray() << qint64(-1);
+    QTest::newRow("not gzip") << QByteArray(32, 'x') << qint64(-1);
+    QTest::newRow("implausible size")
+        << (lorem.left(lorem.size() - 4) + QByteArray("\xff\xff\xff\x7f")) << qint64(-1);
+}
+
+void TestInflateDevice::uncompressedSizeHint()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(qint64, expected);
+
+    QCOMPARE(polar::v2::InflateDevice::uncompressedSizeHint(data), expected);
+
+    // Random-access devices should give the same result, and not move.
+    QBuffer buffer(&data);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    QCOMPARE(polar::v2::InflateDevice::uncompressedSizeHint(buffer), expected);
+    QCOMPARE(buffer.pos(), Q_INT64_C(0));
+}
@@ -0,0 +1,121 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testsessionindex.h"
+
+#include "../../src/polar/v2/sessionindex.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+void TestSessionIndex::addFile_data()
+{
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<QString>("exerciseId");
+    QTest::addColumn<QString>("fileType");
+
+    QTest::newRow("create")
+        << QString::fromLatin1("v2-users-1-training-sessions-2-create")
+        << QString() << QString();
+    QTest::newRow("physical-information")
+        << QString::fromLatin1("v2-users-1-training-sessions-2-physical-information")
+        << QString() << QString();
+    QTest::newRow("exercise-create")
+        << QString::fromLatin1("v2-users-1-training-sessions-2-exercises-3-create")
+        << QString::fromLatin1("3") << QString::fromLatin1("create");
+    QTest::newRow("exercise-samples")
+        << QString::fromLatin1("v2-users-1-training-sessions-2-exercises-3-samples")
+        << QString::fromLatin1("3") << QString::fromLatin1("samples");
+}
+
+void TestSessionIndex::addFile()
+{
+    QFETCH(QString, fileName);
+    QFETCH(QString, exerciseId);
+    QFETCH(QString, fileType);
+
+    const QString baseName = QLatin1String("dir/v2-users-1-training-sessions-2");
+    const QFileInfo fileInfo(QLatin1String("dir/") + fileName);
+
+    polar::v2::SessionIndex index;
+    index.addFile(baseName, fileInfo);
+    QCOMPARE(index.baseNames(), QStringList(baseName));
+    QVERIFY(index.contains(baseName));
+
+    const polar::v2::SessionFiles files = index.value(baseName);
+    QCOMPARE(files.files.size(), 1);
+    QCOMPARE(files.files.first(), fileInfo);
+    if (exerciseId.isEmpty()) {
+        QVERIFY(files.exercises.isEmpty());
+    } else {
+        QCOMPARE(QStringList(files.exercises.keys()), QStringList(exerciseId));
+        QCOMPARE(files.exercises.value(exerciseId).value(fileType), fileInfo.filePath());
+    }
+}
+
+void TestSessionIndex::addFolder()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    QStringList fileNames;
+    fileNames << QLatin1String("notes.txt")
+              << QLatin1String("v2-users-1-training-sessions-2-create")
+              << QLatin1String("v2-users-1-training-sessions-2-exercises-3-create")
+              << QLatin1String("v2-users-1-training-sessions-2-exercises-3-samples")
+              << QLatin1String("v2-users-1-training-sessions-2-exercises-4-create")
+              << QLatin1String("v2-users-1-training-sessions-5-create");
+    foreach (const QString &fileName, fileNames) {
+        QFile file(dir.path() + QLatin1Char('/') + fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+    }
+
+    polar::v2::SessionIndex index;
+    QCOMPARE(index.addFolder(dir.path()), fileNames.size() - 1);
+
+    const QString session1 = dir.path() + QLatin1String("/v2-users-1-training-sessions-2");
+    const QString session2 = dir.path() + QLatin1String("/v2-users-1-training-sessions-5");
+    QCOMPARE(index.baseNames(), QStringList() << session1 << session2);
+
+    const polar::v2::SessionFiles files1 = index.value(session1);
+    QCOMPARE(files1.files.size(), 4);
+    QCOMPARE(QStringList(files1.exercises.keys()),
+             QStringList() << QLatin1String("3") << QLatin1String("4"));
+    QCOMPARE(QStringList(files1.exercises.value(QLatin1String("3")).keys()),
+             QStringList() << QLatin1String("create") << QLatin1String("samples"));
+
+    const polar::v2::SessionFiles files2 = index.value(session2);
+    QCOMPARE(files2.files.size(), 1);
+    QVERIFY(files2.exercises.isEmpty());
+
+    QVERIFY(!index.contains(dir.path() + QLatin1String("/notes.txt")));
+}
+
+void TestSessionIndex::listSession()
+{
+    QString baseName = QFINDTESTDATA("testdata/training-sessions-19401412-exercises-19344289-create");
+    baseName.chop(QString::fromLatin1("-exercises-19344289-create").size());
+
+    const polar::v2::SessionFiles files = polar::v2::SessionIndex::listSession(baseName);
+    QVERIFY(!files.isEmpty());
+    QVERIFY(files.exercises.contains(QLatin1String("19344289")));
+    QCOMPARE(files.exercises.value(QLatin1String("19344289")).value(QLatin1String("create")),
+             baseName + QLatin1String("-exercises-19344289-create"));
+}
@@ -20,17 +20,26 @@
 #include "testtrainingsession.h"
 
 #include "../../src/polar/v2/trainingsession.h"
+#include "../../tools/sessiongenerator.h"
 #include "../../tools/variant.h"
 
+#include <QBitArray>
+#include <QBuffer>
 #include <QDebug>
+#include <QDir>
 #include <QDomDocument>
 #include <QFile>
+#include <QTemporaryDir>
 #include <QTest>
 #include <QXmlSchema>
 #include <QXmlSchemaValidator>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
 
 Q_DECLARE_METATYPE(polar::v2::TrainingSession::OutputFormat)
 Q_DECLARE_METATYPE(polar::v2::TrainingSession::OutputFormats)
+Q_DECLARE_METATYPE(polar::v2::TrainingSession::GpxOptions)
+Q_DECLARE_METATYPE(polar::v2::TrainingSession::TcxOptions)
 
 // Qt's QDomDocument comparisons are based on references, and always fail when
 // comparing two separate documents.  Additionally, the QDomDocument::toString
@@ -111,6 +120,82 @@ void compare(const QDomDocument &a, const QDomDocument &b)
     QCOMPARE(a.nodeType(), b.nodeType());
 }
 
+// The expected GPX and TCX files were written via QDomDocument, whose attribute
+// order is arbitrary. So to compare streamed output byte for byte, re-serialise
+// both documents the same way, with each element's attributes in name order.
+QByteArray canonicalXml(const QByteArray &xml)
+{
+    QByteArray result;
+    QBuffer buffer(&result);
+    buffer.open(QIODevice::WriteOnly);
+    QXmlStreamReader reader(xml);
+    reader.setNamespaceProcessing(false);
+    QXmlStreamWriter writer(&buffer);
+    writer.setAutoFormatting(true);
+    writer.setAutoFormattingIndent(2);
+    while (!reader.atEnd()) {
+        switch (reader.readNext()) {
+        case QXmlStreamReader::StartDocument:
+            writer.writeProcessingInstruction(QLatin1String("xml"),
+                QString::fromLatin1("version='%1' encoding='%2'")
+                    .arg(reader.documentVersion().toString())
+                    .arg(reader.documentEncoding().toString()));
+            break;
+        case QXmlStreamReader::StartElement: {
+            writer.writeStartElement(reader.qualifiedName().toString());
+            QMap<QString, QString> attributes;
+            foreach (const QXmlStreamAttribute &attribute, reader.attributes()) {
+                attributes.insert(attribute.qualifiedName().toString(),
+                                  attribute.value().toString());
+            }
+            for (QMap<QString, QString>::const_iterator attribute = attributes.constBegin();
+                 attribute != attributes.constEnd(); ++attribute) {
+                writer.writeAttribute(attribute.key(), attribute.value());
+            }
+            break;
+        }
+        case QXmlStreamReader::EndElement:
+            writer.writeEndElement();
+            break;
+        case QXmlStreamReader::Characters:
+            if (!reader.isWhitespace()) {
+                writer.writeCharacters(reader.text().toString());
+            }
+            break;
+        case QXmlStreamReader::Comment:
+            writer.writeComment(reader.text().toString());
+            break;
+        default:
+            break;
+        }
+    }
+    if (reader.hasError()) {
+        qWarning() << "Failed to read XML:" << reader.errorString();
+        return QByteArray();
+    }
+    return result;
+}
+
+// Typed sample channels should hold exactly the same values (and offline
+// ranges) as built from the generic QVariant parse.
+template<typename Type>
+void compare(const polar::v2::SampleChannel<Type> &a, const polar::v2::SampleChannel<Type> &b)
+{
+    QCOMPARE(a.size(), b.size());
+    for (int index = 0; index < a.size(); ++index) {
+        QCOMPARE(a.at(index), b.at(index));
+        QCOMPARE(a.isOffline(index), b.isOffline(index));
+    }
+}
+
+// Typed parses return just the generic parse's non-sample fields.
+void compareFields(const QVariantMap &fields, const QVariantMap &expected)
+{
+    for (QVariantMap::const_iterator iter = fields.constBegin(); iter != fields.constEnd(); ++iter) {
+        QCOMPARE(iter.value(), expected.value(iter.key()));
+    }
+}
+
 void TestTrainingSession::getOutputBaseFileName_data()
 {
     QTest::addColumn<QString>("input");
@@ -207,11 +292,19 @@ void TestTrainingSession::getOutputBaseFileName()
     QFETCH(QString, input);
     QFETCH(QString, format);
     QFETCH(QString, output);
-    if (input.endsWith(QLatin1String("-create"))) {
+    const bool hasCreateFile = input.endsWith(QLatin1String("-create"));
+    if (hasCreateFile) {
         input.chop(7);
     }
     polar::v2::TrainingSession session(input);
     QCOMPARE(session.getOutputBaseFileName(format), output);
+
+    // Recorded naming details should give the same name, without the create file.
+    if (hasCreateFile) {
+        polar::v2::TrainingSession named(QLatin1String("missing/") + QFileInfo(input).fileName());
+        named.setOutputNaming(session.getOutputNaming());
+        QCOMPARE(named.getOutputBaseFileName(format), output);
+    }
 }
 
 void TestTrainingSession::getOutputFileNames_data()
@@ -331,6 +424,19 @@ void TestTrainingSession::getOutputFileNames()
     session.setHrmOption(polar::v2::TrainingSession::RrFiles);
     QCOMPARE(session.getOutputFileNames(outputFileNameFormat, outputFileFormats,
              outputDirName), outputFileNames);
+
+    // Input files indexed up front should give the same output names.
+    const QFileInfo baseInfo(inputBaseName);
+    polar::v2::SessionIndex index;
+    foreach (const QFileInfo &info, baseInfo.dir().entryInfoList(
+             QStringList(baseInfo.fileName() + QLatin1String("-*")), QDir::Files)) {
+        index.addFile(inputBaseName, info);
+    }
+    polar::v2::TrainingSession listedSession(inputBaseName);
+    listedSession.setHrmOption(polar::v2::TrainingSession::RrFiles);
+    listedSession.setInputFiles(index.value(inputBaseName));
+    QCOMPARE(listedSession.getOutputFileNames(outputFileNameFormat, outputFileFormats,
+             outputDirName), outputFileNames);
 }
 
 void TestTrainingSession::isGzipped_data()
@@ -363,6 +469,41 @@ void TestTrainingSession::isGzipped()
     QCOMPARE(polar::v2::TrainingSession::isGzipped(data), expected);
 }
 
+void TestTrainingSession::parseConcurrently_data()
+{
+    QTest::addColumn<QString>("baseName");
+
+    #define LOAD_TEST_DATA(name) { \
+        QString baseName(QFINDTESTDATA("testdata/" name ".gpx")); \
+        baseName.chop(4); \
+        QTest::newRow(name) << baseName; \
+    }
+
+    LOAD_TEST_DATA("training-sessions-1");
+    LOAD_TEST_DATA("training-sessions-2");
+    LOAD_TEST_DATA("training-sessions-19401412");
+    LOAD_TEST_DATA("training-sessions-19946380");
+    LOAD_TEST_DATA("training-sessions-22165267");
+
+    #undef LOAD_TEST_DATA
+}
+
+void TestTrainingSession::parseConcurrently()
+{
+    QFETCH(QString, baseName);
+
+    polar::v2::TrainingSession expected(baseName);
+    QVERIFY(expected.parse());
+
+    // Concurrent parsing should give exactly the same result as sequential.
+    polar::v2::TrainingSession session(baseName);
+    session.setParseOption(polar::v2::TrainingSession::ConcurrentParsing);
+    QVERIFY(session.parse());
+    QCOMPARE(session.parsedExercises, expected.parsedExercises);
+    QCOMPARE(session.parsedPhysicalInformation, expected.parsedPhysicalInformation);
+    QCOMPARE(session.parsedSession, expected.parsedSession);
+}
+
 void TestTrainingSession::parseCreateExercise_data()
 {
     QTest::addColumn<QString>("fileName");
@@ -444,6 +585,97 @@ void TestTrainingSession::parseCreateSession()
     QCOMPARE(result, expected);
 }
 
+void TestTrainingSession::parseGeneratedSession_data()
+{
+    QTest::addColumn<int>("exerciseCount");
+    QTest::addColumn<int>("lapCount");
+    QTest::addColumn<int>("offlineCount");
+    QTest::addColumn<int>("offlineLength");
+
+    QTest::newRow("1 exercise")   << 1 << 1 << 0 << 0;
+    QTest::newRow("2 exercises")  << 2 << 3 << 2 << 30;
+    QTest::newRow("3 exercises")  << 3 << 5 << 4 << 1;
+    QTest::newRow("long dropout") << 2 << 2 << 1 << 1000;
+}
+
+void TestTrainingSession::parseGeneratedSession()
+{
+    QFETCH(int, exerciseCount);
+    QFETCH(int, lapCount);
+    QFETCH(int, offlineCount);
+    QFETCH(int, offlineLength);
+
+    // Generate a gzipped, ten minute per exercise, session.
+    const int sampleCount = 600;
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString baseName = dir.path() +
+        QLatin1String("/v2-users-0000000-training-sessions-1234567");
+    tools::SessionGenerator generator;
+    generator.setDuration(sampleCount);
+    generator.setExerciseCount(exerciseCount);
+    generator.setGzipped(true);
+    generator.setLapCount(lapCount);
+    generator.setOfflineRanges(offlineCount, offlineLength);
+    QVERIFY(!generator.write(baseName).isEmpty());
+
+    polar::v2::TrainingSession session(baseName);
+    QVERIFY(session.parse());
+    QCOMPARE(session.exerciseCount(), exerciseCount);
+    QCOMPARE(session.exerciseData.size(), exerciseCount);
+
+    // The same sample indexes the generator marks offline.
+    QBitArray offline(sampleCount);
+    for (int range = 0; range < offlineCount; ++range) {
+        const int start = (range + 1) * sampleCount / (offlineCount + 1);
+        offline.fill(true, start, qMin(start + offlineLength, sampleCount));
+    }
+
+    for (int exercise = 0; exercise < exerciseCount; ++exercise) {
+        const QString exerciseId = QString::number(1000001 + exercise);
+        QVERIFY(session.exerciseData.contains(exerciseId));
+        const polar::v2::ExerciseData &data = session.exerciseData[exerciseId];
+
+        // Check the sample and route counts.
+        QCOMPARE(data.samples.heartrate.size(), sampleCount);
+        QCOMPARE(data.samples.cadence.size(), sampleCount);
+        QCOMPARE(data.samples.speed.size(), sampleCount);
+        QCOMPARE(data.samples.distance.size(), sampleCount);
+        QCOMPARE(data.samples.altitude.size(), sampleCount);
+        QCOMPARE(data.samples.temperature.size(), sampleCount);
+        QCOMPARE(data.route.latitude.size(), sampleCount);
+        QCOMPARE(data.route.longitude.size(), sampleCount);
+        QVERIFY(!data.rrSamples.isEmpty());
+
+        // Check the offline masks.
+        for (int index = 0; index < sampleCount; ++index) {
+            QCOMPARE(data.samples.heartrate.isOffline(index), offline.testBit(index));
+            QCOMPARE(data.samples.cadence.isOffline(index), offline.testBit(index));
+            QCOMPARE(data.samples.speed.isOffline(index), offline.testBit(index));
+            QCOMPARE(data.samples.distance.isOffline(index), offline.testBit(index));
+            QCOMPARE(data.samples.altitude.isOffline(index), offline.testBit(index));
+            QCOMPARE(data.samples.temperature.isOffline(index), offline.testBit(index));
+        }
+
+        // Check the manual lap count.
+        const QVariantMap map = session.parsedExercises.value(exerciseId).toMap();
+        QCOMPARE(map.value(QLatin1String("laps")).toMap()
+                    .value(QLatin1String("laps")).toList().size(), lapCount);
+
+        // Check that HRM output can be written.
+        QBuffer hrm;
+        QVERIFY(hrm.open(QIODevice::WriteOnly));
+        QVERIFY(session.writeHRM(hrm, exerciseId));
+        QVERIFY(!hrm.data().isEmpty());
+    }
+
+    // Check that TCX output can be written.
+    QBuffer tcx;
+    QVERIFY(tcx.open(QIODevice::WriteOnly));
+    QVERIFY(session.writeTCX(tcx));
+    QVERIFY(!tcx.data().isEmpty());
+}
+
 void TestTrainingSession::parseLaps_data()
 {
     QTest::addColumn<QString>("fileName");
@@ -567,6 +799,20 @@ void TestTrainingSession::parseRoute()
 
     // Compare the result.
     QCOMPARE(result, expected);
+
+    // The typed parse should give the same samples, and remaining fields.
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    polar::v2::ExerciseData data;
+    compareFields(session.parseRoute(file, data.route), expected);
+    QVariantMap exercise;
+    exercise.insert(QLatin1String("route"), expected);
+    const polar::v2::ExerciseData expectedData(exercise);
+    compare(data.route.duration,   expectedData.route.duration);
+    compare(data.route.latitude,   expectedData.route.latitude);
+    compare(data.route.longitude,  expectedData.route.longitude);
+    compare(data.route.altitude,   expectedData.route.altitude);
+    compare(data.route.satellites, expectedData.route.satellites);
 }
 
 void TestTrainingSession::parseRRSamples_data()
@@ -607,6 +853,15 @@ void TestTrainingSession::parseRRSamples()
 
     // Compare the result.
     QCOMPARE(result, expected);
+
+    // The typed parse should give the same samples, and remaining fields.
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    polar::v2::ExerciseData data;
+    compareFields(session.parseRRSamples(file, data.rrSamples), expected);
+    QVariantMap exercise;
+    exercise.insert(QLatin1String("rrsamples"), expected);
+    QCOMPARE(data.rrSamples, polar::v2::ExerciseData(exercise).rrSamples);
 }
 
 void TestTrainingSession::parseSamples_data()
@@ -650,6 +905,21 @@ void TestTrainingSession::parseSamples()
 
     // Compare the result.
     QCOMPARE(result, expected);
+
+    // The typed parse should give the same samples, and remaining fields.
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    polar::v2::ExerciseData data;
+    compareFields(session.parseSamples(file, data.samples), expected);
+    QVariantMap exercise;
+    exercise.insert(QLatin1String("samples"), expected);
+    const polar::v2::ExerciseData expectedData(exercise);
+    compare(data.samples.altitude,    expectedData.samples.altitude);
+    compare(data.samples.cadence,     expectedData.samples.cadence);
+    compare(data.samples.distance,    expectedData.samples.distance);
+    compare(data.samples.heartrate,   expectedData.samples.heartrate);
+    compare(data.samples.speed,       expectedData.samples.speed);
+    compare(data.samples.temperature, expectedData.samples.temperature);
 }
 
 void TestTrainingSession::parseStatistics_data()
@@ -1530,34 +1800,163 @@ void TestTrainingSession::toTCX_UTC()
     QVERIFY(validator.validate(tcx.toByteArray()));
 }
 
-void TestTrainingSession::unzip_data()
+void TestTrainingSession::writeGPX_data()
 {
-    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<QString>("baseName");
+    QTest::addColumn<polar::v2::TrainingSession::GpxOptions>("options");
     QTest::addColumn<QByteArray>("expected");
 
+    #define LOAD_TEST_FILE(name, suffix, options) { \
+        QFile expectedFile(QFINDTESTDATA("testdata/" name suffix ".gpx")); \
+        QString baseName(expectedFile.fileName()); \
+        baseName.chop(sizeof(suffix ".gpx") - 1); \
+        expectedFile.open(QIODevice::ReadOnly); \
+        QTest::newRow(name suffix) << baseName \
+            << polar::v2::TrainingSession::GpxOptions(options) << expectedFile.readAll(); \
+    }
+
+    #define LOAD_TEST_DATA(name) \
+        LOAD_TEST_FILE(name, "", 0) \
+        LOAD_TEST_FILE(name, ".all-extensions", \
+            polar::v2::TrainingSession::CluetrustGpxExtension| \
+            polar::v2::TrainingSession::GarminTrackPointExtension) \
+        LOAD_TEST_FILE(name, ".cluetrust", \
+            polar::v2::TrainingSession::CluetrustGpxExtension) \
+        LOAD_TEST_FILE(name, ".garmin-trackpoint", \
+            polar::v2::TrainingSession::GarminTrackPointExtension)
+
+    LOAD_TEST_DATA("training-sessions-1");
+    LOAD_TEST_DATA("training-sessions-2");
+    LOAD_TEST_DATA("training-sessions-19401412");
+    LOAD_TEST_DATA("training-sessions-19946380");
+    LOAD_TEST_DATA("training-sessions-22165267");
+
+    #undef LOAD_TEST_DATA
+    #undef LOAD_TEST_FILE
+}
+
+void TestTrainingSession::writeGPX()
+{
+    QFETCH(QString, baseName);
+    QFETCH(polar::v2::TrainingSession::GpxOptions, options);
+    QFETCH(QByteArray, expected);
+
+    polar::v2::TrainingSession session(baseName);
+    QVERIFY(session.parse());
+    session.setGpxOptions(options);
+
+    // Stream the document, exactly as it would be written to file.
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    QVERIFY(session.writeGPX(buffer, QDateTime::fromString(
+        QLatin1String("2014-07-15T12:34:56Z"), Qt::ISODate)));
+
+    const QByteArray expectedXml = canonicalXml(expected);
+    QVERIFY2(!expectedXml.isEmpty(), "failed to load testdata");
+    QCOMPARE(canonicalXml(buffer.data()), expectedXml);
+}
+
+void TestTrainingSession::writeHRM_data()
+{
+    QTest::addColumn<QString>("baseName");
+    QTest::addColumn<QByteArray>("expectedHrm");
+    QTest::addColumn<QByteArray>("expectedRr");
+
     #define LOAD_TEST_DATA(name) { \
-        QFile dataFile(QFINDTESTDATA("testdata/" name ".gz")); \
-        dataFile.open(QIODevice::ReadOnly); \
-        QFile expectedFile(QFINDTESTDATA("testdata/" name)); \
+        QFile hrmFile(QFINDTESTDATA("testdata/" name ".LapNames.hrm")); \
+        QFile rrFile(QFINDTESTDATA("testdata/" name ".rr.LapNames.hrm")); \
+        hrmFile.open(QIODevice::ReadOnly); \
+        rrFile.open(QIODevice::ReadOnly); \
+        QString baseName = hrmFile.fileName(); \
+        baseName.chop(13); \
+        QTest::newRow(name) << baseName << hrmFile.readAll() << rrFile.readAll(); \
+    }
+
+    LOAD_TEST_DATA("training-sessions-19401412");
+    LOAD_TEST_DATA("training-sessions-19946380");
+    LOAD_TEST_DATA("training-sessions-22165267");
+
+    #undef LOAD_TEST_DATA
+}
+
+void TestTrainingSession::writeHRM()
+{
+    QFETCH(QString, baseName);
+    QFETCH(QByteArray, expectedHrm);
+    QFETCH(QByteArray, expectedRr);
+
+    polar::v2::TrainingSession session(baseName);
+    QVERIFY(session.parse());
+    session.setHrmOption(polar::v2::TrainingSession::LapNames);
+    session.setHrmOption(polar::v2::TrainingSession::RrFiles);
+
+    // Both files are written in a single pass, so must match toHRM()'s output.
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString outputBaseName = dir.path() + QLatin1String("/output");
+    QStringList expectedFileNames;
+    expectedFileNames << (outputBaseName + QLatin1String(".hrm"))
+                      << (outputBaseName + QLatin1String(".rr.hrm"));
+    QCOMPARE(session.writeHRM(outputBaseName), expectedFileNames);
+
+    QFile hrmFile(expectedFileNames.at(0));
+    QVERIFY(hrmFile.open(QIODevice::ReadOnly));
+    QCOMPARE(hrmFile.readAll(), expectedHrm);
+    QFile rrFile(expectedFileNames.at(1));
+    QVERIFY(rrFile.open(QIODevice::ReadOnly));
+    QCOMPARE(rrFile.readAll(), expectedRr);
+}
+
+void TestTrainingSession::writeTCX_data()
+{
+    QTest::addColumn<QString>("baseName");
+    QTest::addColumn<polar::v2::TrainingSession::TcxOptions>("options");
+    QTest::addColumn<QByteArray>("expected");
+
+    #define LOAD_TEST_FILE(name, suffix, options) { \
+        QFile expectedFile(QFINDTESTDATA("testdata/" name suffix ".tcx")); \
+        QString baseName(expectedFile.fileName()); \
+        baseName.chop(sizeof(suffix ".tcx") - 1); \
         expectedFile.open(QIODevice::ReadOnly); \
-        QTest::newRow(name) << dataFile.readAll() << expectedFile.readAll(); \
+        QTest::newRow(name suffix) << baseName \
+            << polar::v2::TrainingSession::TcxOptions(options) << expectedFile.readAll(); \
     }
 
-    LOAD_TEST_DATA("lorem-ipsum.txt");
-    LOAD_TEST_DATA("random-bytes");
+    #define LOAD_TEST_DATA(name) \
+        LOAD_TEST_FILE(name, "", 0) \
+        LOAD_TEST_FILE(name, ".all-extensions", \
+            polar::v2::TrainingSession::GarminActivityExtension) \
+        LOAD_TEST_FILE(name, ".garmin-activity", \
+            polar::v2::TrainingSession::GarminActivityExtension) \
+        LOAD_TEST_FILE(name, ".utc", \
+            polar::v2::TrainingSession::ForceTcxUTC)
+
+    LOAD_TEST_DATA("training-sessions-1");
+    LOAD_TEST_DATA("training-sessions-2");
+    LOAD_TEST_DATA("training-sessions-19401412");
+    LOAD_TEST_DATA("training-sessions-19946380");
+    LOAD_TEST_DATA("training-sessions-22165267");
 
     #undef LOAD_TEST_DATA
+    #undef LOAD_TEST_FILE
 }
 
-void TestTrainingSession::unzip()
+void TestTrainingSession::writeTCX()
 {
-    QFETCH(QByteArray, data);
+    QFETCH(QString, baseName);
+    QFETCH(polar::v2::TrainingSession::TcxOptions, options);
     QFETCH(QByteArray, expected);
 
-    QVERIFY2(!data.isEmpty(), "failed to load testdata");
-    QVERIFY2(!expected.isEmpty(), "failed to load testdata");
+    polar::v2::TrainingSession session(baseName);
+    QVERIFY(session.parse());
+    session.setTcxOptions(options);
 
-    const polar::v2::TrainingSession session(QLatin1String("ignored"));
-    QCOMPARE(session.unzip(data), expected);   // Default initial buffer size.
-    QCOMPARE(session.unzip(data,1), expected); // Tiny initial buffer size.
+    // Stream the document, exactly as it would be written to file.
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    QVERIFY(session.writeTCX(buffer, QLatin1String("Jul 17 2014 21:02:38")));
+
+    const QByteArray expectedXml = canonicalXml(expected);
+    QVERIFY2(!expectedXml.isEmpty(), "failed to load testdata");
+    QCOMPARE(canonicalXml(buffer.data()), expectedXml);
 }
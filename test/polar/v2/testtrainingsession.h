@@ -32,12 +32,18 @@ private slots:
     void isGzipped_data();
     void isGzipped();
 
+    void parseConcurrently_data();
+    void parseConcurrently();
+
     void parseCreateExercise_data();
     void parseCreateExercise();
 
     void parseCreateSession_data();
     void parseCreateSession();
 
+    void parseGeneratedSession_data();
+    void parseGeneratedSession();
+
     void parseLaps_data();
     void parseLaps();
 
@@ -95,7 +101,13 @@ private slots:
     void toTCX_UTC_data();
     void toTCX_UTC();
 
-    void unzip_data();
-    void unzip();
+    void writeGPX_data();
+    void writeGPX();
+
+    void writeHRM_data();
+    void writeHRM();
+
+    void writeTCX_data();
+    void writeTCX();
 
 };
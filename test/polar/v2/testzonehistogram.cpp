@@ -0,0 +1,106 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testzonehistogram.h"
+
+#include "../../src/polar/v2/zonehistogram.h"
+
+#include <QTest>
+
+// Count samples per zone the simple way, via an if/else ladder.
+QVector<int> ladderCounts(const QVector<quint32> &samples, const QVector<quint32> &limits)
+{
+    QVector<int> counts(limits.size() + 1);
+    foreach (const quint32 sample, samples) {
+        int zone = 0;
+        while ((zone < limits.size()) && (sample <= limits.at(zone))) {
+            ++zone;
+        }
+        counts[zone]++;
+    }
+    return counts;
+}
+
+void TestZoneHistogram::counts_data()
+{
+    QTest::addColumn<QVector<quint32> >("samples");
+    QTest::addColumn<QVector<quint32> >("limits");
+
+    QVector<quint32> heartrates;
+    for (quint32 hr = 40; hr <= 210; ++hr) {
+        heartrates << hr << hr << (250 - hr);
+    }
+
+    QTest::newRow("no-samples") << QVector<quint32>()
+        << (QVector<quint32>() << 190 << 160 << 120 << 60);
+    QTest::newRow("no-limits") << heartrates << QVector<quint32>();
+    QTest::newRow("sorted") << heartrates
+        << (QVector<quint32>() << 190 << 160 << 120 << 60);
+    QTest::newRow("unsorted") << heartrates
+        << (QVector<quint32>() << 190 << 120 << 160 << 60);
+    QTest::newRow("zero-maximum") << heartrates
+        << (QVector<quint32>() << 0 << 160 << 120 << 60);
+    QTest::newRow("equal-limits") << heartrates
+        << (QVector<quint32>() << 150 << 150 << 150 << 150);
+    QTest::newRow("boundaries") << (QVector<quint32>() << 59 << 60 << 61 << 190 << 191)
+        << (QVector<quint32>() << 190 << 160 << 120 << 60);
+}
+
+void TestZoneHistogram::counts()
+{
+    QFETCH(QVector<quint32>, samples);
+    QFETCH(QVector<quint32>, limits);
+
+    polar::v2::ZoneHistogram histogram;
+    const int zoneSet = histogram.addZones(limits);
+    QCOMPARE(zoneSet, 0);
+    histogram.addSamples(samples.constData(), samples.size());
+    QCOMPARE(histogram.sampleCount(), samples.size());
+    QCOMPARE(histogram.counts(zoneSet), ladderCounts(samples, limits));
+}
+
+void TestZoneHistogram::multipleZoneSets()
+{
+    // More samples than a single processing block, added in several parts.
+    QVector<quint32> samples;
+    for (int index = 0; index < 5000; ++index) {
+        samples << (60 + (index * 7) % 140);
+    }
+
+    const QVector<quint32> summary123 = QVector<quint32>() << 190 << 170 << 130 << 50;
+    const QVector<quint32> summaryTh  = QVector<quint32>() << 190 << 165 << 140 << 50;
+
+    polar::v2::ZoneHistogram histogram;
+    QCOMPARE(histogram.addZones(summary123), 0);
+    QCOMPARE(histogram.addZones(summaryTh), 1);
+    histogram.addSamples(samples.constData(), 1500);
+    histogram.addSamples(samples.constData() + 1500, samples.size() - 1500);
+    QCOMPARE(histogram.sampleCount(), samples.size());
+    QCOMPARE(histogram.counts(0), ladderCounts(samples, summary123));
+    QCOMPARE(histogram.counts(1), ladderCounts(samples, summaryTh));
+}
+
+void TestZoneHistogram::quint16Samples()
+{
+    const quint16 samples[] = { 50, 100, 150, 200, 250 };
+    polar::v2::ZoneHistogram histogram;
+    const int zoneSet = histogram.addZones(QVector<quint32>() << 200 << 100);
+    histogram.addSamples(samples, sizeof(samples)/sizeof(samples[0]));
+    QCOMPARE(histogram.counts(zoneSet), QVector<int>() << 1 << 2 << 2);
+}
@@ -1,5 +1,5 @@
 VPATH += $$PWD
-HEADERS += testtrainingsession.h
-SOURCES += testtrainingsession.cpp
+HEADERS += benchtrainingsession.h   testexercisedata.h   testinflatedevice.h   testsessionindex.h   testtrainingsession.h   testzonehistogram.h
+SOURCES += benchtrainingsession.cpp testexercisedata.cpp testinflatedevice.cpp testsessionindex.cpp testtrainingsession.cpp testzonehistogram.cpp
 
 include(../../../src/polar/v2/v2.pri)
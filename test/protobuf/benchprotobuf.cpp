@@ -0,0 +1,146 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchprotobuf.h"
+
+#include "../../src/protobuf/fixnum.h"
+#include "../../src/protobuf/varint.h"
+
+#include <QTest>
+#include <QtEndian>
+
+#include <cstring>
+
+// Synthetic packed arrays are sized as if sampled at 1 Hz for these durations.
+#define ADD_DURATION_ROWS(generator) \
+    QTest::newRow("1h")  << generator(3600); \
+    QTest::newRow("6h")  << generator(6 * 3600); \
+    QTest::newRow("24h") << generator(24 * 3600);
+
+static QByteArray encodeUnsignedVarint(quint64 value)
+{
+    QByteArray data;
+    do {
+        const char byte = static_cast<char>(value & 0x7F);
+        value >>= 7;
+        data.append((value == 0) ? byte : static_cast<char>(byte | 0x80));
+    } while (value != 0);
+    return data;
+}
+
+// Speed-like float values, as found in samples files.
+static QByteArray fixedFloats(const int count)
+{
+    QByteArray data(count * static_cast<int>(sizeof(float)), '\0');
+    for (int index = 0; index < count; ++index) {
+        const float value = 10.0f + (index % 100) / 10.0f;
+        quint32 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        qToLittleEndian(bits, reinterpret_cast<uchar *>(data.data()) + index * sizeof(bits));
+    }
+    return data;
+}
+
+// Altitude-like signed (zig-zag encoded) values, as found in route files.
+static QByteArray signedVarints(const int count)
+{
+    QByteArray data;
+    for (int index = 0; index < count; ++index) {
+        const qint64 value = (index % 3000) - 50;
+        data.append(encodeUnsignedVarint((value << 1) ^ (value >> 63)));
+    }
+    return data;
+}
+
+// Heart-rate-like unsigned values, as found in samples files.
+static QByteArray unsignedVarints(const int count)
+{
+    QByteArray data;
+    for (int index = 0; index < count; ++index) {
+        data.append(encodeUnsignedVarint(60 + (index % 140)));
+    }
+    return data;
+}
+
+void BenchProtobuf::parseFixedNumbers_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    ADD_DURATION_ROWS(fixedFloats)
+}
+
+void BenchProtobuf::parseFixedNumbers()
+{
+    QFETCH(QByteArray, data);
+    QVariantList result;
+    QBENCHMARK {
+        QByteArray copy(data.constData(), data.size());
+        result = ProtoBuf::parseFixedNumbers<float>(copy);
+    }
+    QVERIFY(!result.isEmpty());
+}
+
+void BenchProtobuf::parseSignedVarints_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    ADD_DURATION_ROWS(signedVarints)
+}
+
+void BenchProtobuf::parseSignedVarints()
+{
+    QFETCH(QByteArray, data);
+    QVariantList result;
+    QBENCHMARK {
+        result = ProtoBuf::parseSignedVarints(data);
+    }
+    QVERIFY(!result.isEmpty());
+}
+
+void BenchProtobuf::parseUnsignedVarint_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::newRow("1 byte")   << encodeUnsignedVarint(Q_UINT64_C(0x7F));
+    QTest::newRow("5 bytes")  << encodeUnsignedVarint(Q_UINT64_C(0xFFFFFFFF));
+    QTest::newRow("10 bytes") << encodeUnsignedVarint(Q_UINT64_C(0xFFFFFFFFFFFFFFFF));
+}
+
+void BenchProtobuf::parseUnsignedVarint()
+{
+    QFETCH(QByteArray, data);
+    QVariant result;
+    QBENCHMARK {
+        result = ProtoBuf::parseUnsignedVarint(data);
+    }
+    QVERIFY(result.isValid());
+}
+
+void BenchProtobuf::parseUnsignedVarints_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    ADD_DURATION_ROWS(unsignedVarints)
+}
+
+void BenchProtobuf::parseUnsignedVarints()
+{
+    QFETCH(QByteArray, data);
+    QVariantList result;
+    QBENCHMARK {
+        result = ProtoBuf::parseUnsignedVarints(data);
+    }
+    QVERIFY(!result.isEmpty());
+}
@@ -1,5 +1,5 @@
 VPATH += $$PWD
-HEADERS += testfixnum.h   testmessage.h   testvarint.h
-SOURCES += testfixnum.cpp testmessage.cpp testvarint.cpp
+HEADERS += benchprotobuf.h   testfixnum.h   testmessage.h   testvarint.h
+SOURCES += benchprotobuf.cpp testfixnum.cpp testmessage.cpp testvarint.cpp
 
 include(../../src/protobuf/protobuf.pri)
@@ -24,10 +24,56 @@
 
 #include <QDebug>
 #include <QFile>
+#include <QTemporaryFile>
 #include <QTest>
 
 Q_DECLARE_METATYPE(ProtoBuf::Message::FieldInfoMap)
 
+namespace {
+
+// A sequential device that returns at most a few bytes per read, so that
+// streamed values are split across as many reads as possible.
+class TrickleDevice : public QIODevice {
+public:
+    TrickleDevice(const QByteArray &data, const int maxReadSize)
+        : data(data), maxReadSize(maxReadSize), position(0)
+    {
+        open(QIODevice::ReadOnly|QIODevice::Unbuffered);
+    }
+
+    virtual bool isSequential() const
+    {
+        return true;
+    }
+
+protected:
+    virtual qint64 readData(char * buffer, qint64 maxSize)
+    {
+        const int size = static_cast<int>(qMin(qMin(maxSize, static_cast<qint64>(maxReadSize)),
+                                               static_cast<qint64>(data.size() - position)));
+        if (size <= 0) {
+            return -1;
+        }
+        memcpy(buffer, data.constData() + position, size);
+        position += size;
+        return size;
+    }
+
+    virtual qint64 writeData(const char * data, qint64 maxSize)
+    {
+        Q_UNUSED(data);
+        Q_UNUSED(maxSize);
+        return -1;
+    }
+
+private:
+    const QByteArray data;
+    const int maxReadSize;
+    int position;
+};
+
+}
+
 ProtoBuf::Message::FieldInfoMap loadFieldInfoMap(const QString &name, const QString &subTest)
 {
     ProtoBuf::Message::FieldInfoMap fields;
@@ -121,3 +167,143 @@ void TestMessage::parse()
     // Compare the result.
     QCOMPARE(result, expected);
 }
+
+void TestMessage::parseMappedFile_data()
+{
+    parse_data();
+}
+
+void TestMessage::parseMappedFile()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(ProtoBuf::Message::FieldInfoMap, fieldInfo);
+    QFETCH(QVariantMap, expected);
+
+    QVERIFY2(!data.isEmpty(), "failed to load testdata");
+
+    // Local files are parsed from a memory mapping, rather than read.
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    QCOMPARE(file.write(data), qint64(data.size()));
+    QVERIFY(file.seek(0));
+
+    const ProtoBuf::Message message(fieldInfo);
+    QCOMPARE(message.parse(file), expected);
+    QVERIFY(file.atEnd());
+}
+
+void TestMessage::parsePacked()
+{
+    ProtoBuf::Message::FieldInfoMap fieldInfo;
+    fieldInfo[QLatin1String("1")]   = ProtoBuf::Message::FieldInfo(QLatin1String("heartrate"),   ProtoBuf::Types::Uint32);
+    fieldInfo[QLatin1String("2")]   = ProtoBuf::Message::FieldInfo(QLatin1String("speed"),       ProtoBuf::Types::Float);
+    fieldInfo[QLatin1String("3")]   = ProtoBuf::Message::FieldInfo(QLatin1String("latitude"),    ProtoBuf::Types::Double);
+    fieldInfo[QLatin1String("4")]   = ProtoBuf::Message::FieldInfo(QLatin1String("altitude"),    ProtoBuf::Types::Sint32);
+    fieldInfo[QLatin1String("5")]   = ProtoBuf::Message::FieldInfo(QLatin1String("satellites"),  ProtoBuf::Types::Uint32);
+    fieldInfo[QLatin1String("6")]   = ProtoBuf::Message::FieldInfo(QLatin1String("nested"),      ProtoBuf::Types::EmbeddedMessage);
+    fieldInfo[QLatin1String("6/1")] = ProtoBuf::Message::FieldInfo(QLatin1String("heartrate"),   ProtoBuf::Types::Uint32);
+    fieldInfo[QLatin1String("7")]   = ProtoBuf::Message::FieldInfo(QLatin1String("cadence"),     ProtoBuf::Types::Uint32);
+
+    QByteArray data = QByteArray::fromHex(
+        "0a0401ac0202"              // heartrate: 1, 300, 2 (packed)
+        "12080000c03f000000c0"      // speed: 1.5, -2.0 (packed)
+        "1a08000000000000e03f"      // latitude: 0.5 (packed)
+        "22020102"                  // altitude: -1, 1 (packed)
+        "2807"                      // satellites: 7 (not packed)
+        "32040a020708"              // nested: { heartrate: 7, 8 (packed) }
+        "3a07018080808010" "03"     // cadence: 1, 2^32 (out of range), 3 (packed)
+        "0a0105");                  // heartrate: 5 (packed, continued)
+    const ProtoBuf::Message message(fieldInfo);
+
+    // The typed arrays should match the generic QVariant-based parse.
+    const QVariantMap expected = message.parse(data);
+    QCOMPARE(expected.value(QLatin1String("heartrate")).toList(),
+             QVariantList() << 1 << 300 << 2 << 5);
+
+    ProtoBuf::Message::PackedFields packedFields;
+    const QVariantMap result = message.parse(data, packedFields);
+    QCOMPARE(QStringList(result.keys()),
+             QStringList() << QLatin1String("nested") << QLatin1String("satellites"));
+    QCOMPARE(result.value(QLatin1String("satellites")), expected.value(QLatin1String("satellites")));
+
+    // Arrays are keyed by tag path, so same-named nested fields stay distinct.
+    QCOMPARE(QStringList(packedFields.unsignedIntegers.keys()), QStringList()
+             << QLatin1String("1") << QLatin1String("6/1") << QLatin1String("7"));
+    QCOMPARE(packedFields.unsignedIntegers.value(QLatin1String("1")),
+             QVector<quint32>() << 1 << 300 << 2 << 5);
+    QCOMPARE(packedFields.unsignedIntegers.value(QLatin1String("6/1")),
+             QVector<quint32>() << 7 << 8);
+    QCOMPARE(packedFields.floats.value(QLatin1String("2")),
+             QVector<float>() << 1.5f << -2.0f);
+    QCOMPARE(packedFields.doubles.value(QLatin1String("3")),
+             QVector<double>() << 0.5);
+    QCOMPARE(packedFields.signedIntegers.value(QLatin1String("4")),
+             QVector<qint32>() << -1 << 1);
+
+    // Values that do not fit the array type are rejected, not truncated.
+    QCOMPARE(packedFields.unsignedIntegers.value(QLatin1String("7")),
+             QVector<quint32>() << 1);
+
+    // Streamed data should give the same result, however it is split.
+    for (int maxReadSize = 1; maxReadSize <= data.size(); ++maxReadSize) {
+        TrickleDevice device(data, maxReadSize);
+        ProtoBuf::Message::PackedFields streamedFields;
+        QCOMPARE(message.parse(device, streamedFields), result);
+        QCOMPARE(streamedFields.unsignedIntegers, packedFields.unsignedIntegers);
+        QCOMPARE(streamedFields.signedIntegers, packedFields.signedIntegers);
+        QCOMPARE(streamedFields.floats, packedFields.floats);
+        QCOMPARE(streamedFields.doubles, packedFields.doubles);
+    }
+
+    // Truncated streams fail.
+    TrickleDevice truncated(data.left(data.size() - 1), 2);
+    ProtoBuf::Message::PackedFields truncatedFields;
+    QVERIFY(message.parse(truncated, truncatedFields).isEmpty());
+}
+
+void TestMessage::parseStream_data()
+{
+    parse_data();
+}
+
+void TestMessage::parseStream()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(ProtoBuf::Message::FieldInfoMap, fieldInfo);
+    QFETCH(QVariantMap, expected);
+
+    QVERIFY2(!data.isEmpty(), "failed to load testdata");
+
+    // Sequential devices are parsed a chunk at a time, as they are read.
+    const ProtoBuf::Message message(fieldInfo);
+    const int maxReadSizes[] = { 1, 3, 64, data.size() };
+    for (size_t index = 0; index < sizeof(maxReadSizes)/sizeof(maxReadSizes[0]); ++index) {
+        TrickleDevice device(data, maxReadSizes[index]);
+        QCOMPARE(message.parse(device), expected);
+    }
+}
+
+void TestMessage::parseTagPathPrefix()
+{
+    ProtoBuf::Message::FieldInfoMap fieldInfo;
+    fieldInfo[QLatin1String("1")]     = ProtoBuf::Message::FieldInfo(QLatin1String("outer"), ProtoBuf::Types::EmbeddedMessage);
+    fieldInfo[QLatin1String("1/2")]   = ProtoBuf::Message::FieldInfo(QLatin1String("inner"), ProtoBuf::Types::Uint32);
+    fieldInfo[QLatin1String("1/2.4")] = ProtoBuf::Message::FieldInfo(QLatin1String("never"), ProtoBuf::Types::Uint32);
+    const ProtoBuf::Message message(fieldInfo);
+
+    QVariantMap inner;
+    inner.insert(QLatin1String("inner"), QVariantList() << 5);
+    QVariantMap outer;
+    outer.insert(QLatin1String("outer"), QVariantList() << inner);
+
+    QByteArray data = QByteArray::fromHex("0a021005");
+    QCOMPARE(message.parse(data), outer);
+
+    data = QByteArray::fromHex("1005");
+    QCOMPARE(message.parse(data, QLatin1String("1/")), inner);
+
+    // Unknown prefixes leave all fields unnamed, and untyped.
+    QVariantMap unknown;
+    unknown.insert(QLatin1String("2"), QVariantList() << 5);
+    QCOMPARE(message.parse(data, QLatin1String("3/")), unknown);
+}
@@ -25,5 +25,11 @@ class TestMessage : public QObject {
 private slots:
     void parse_data();
     void parse();
+    void parseMappedFile_data();
+    void parseMappedFile();
+    void parsePacked();
+    void parseStream_data();
+    void parseStream();
+    void parseTagPathPrefix();
 
 };
@@ -25,6 +25,78 @@
 
 #include <limits>
 
+void TestVarint::decodeSignedInt_data()
+{
+    parseSignedInt_data();
+}
+
+void TestVarint::decodeSignedInt()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(QVariant, expected);
+
+    qint64 value;
+    QCOMPARE(ProtoBuf::decodeSignedVarint(data.constData(), data.constData() + data.size(), value),
+             data.size());
+    QCOMPARE(QVariant(value), expected);
+}
+
+void TestVarint::decodeStandardInt_data()
+{
+    parseStandardInt_data();
+}
+
+void TestVarint::decodeStandardInt()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(QVariant, expected);
+
+    qint64 value;
+    QCOMPARE(ProtoBuf::decodeStandardVarint(data.constData(), data.constData() + data.size(), value),
+             data.size());
+    QCOMPARE(QVariant(value), expected);
+}
+
+void TestVarint::decodeUnsignedInt_data()
+{
+    parseUnsignedInt_data();
+}
+
+void TestVarint::decodeUnsignedInt()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(QVariant, expected);
+
+    quint64 value;
+    QCOMPARE(ProtoBuf::decodeUnsignedVarint(data.constData(), data.constData() + data.size(), value),
+             data.size());
+    QCOMPARE(QVariant(value), expected);
+}
+
+void TestVarint::decodeTruncated_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("1000 0000") << QByteArray("\x80");
+    QTest::newRow("1010 1100") << QByteArray("\xAC");
+    QTest::newRow("uint64::max") << QByteArray("\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF");
+    QTest::newRow("too long") << QByteArray("\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\x01");
+}
+
+void TestVarint::decodeTruncated()
+{
+    QFETCH(QByteArray, data);
+
+    // Incomplete varints must be rejected without reading beyond the end.
+    qint64 signedValue;
+    quint64 unsignedValue;
+    const char * const end = data.constData() + data.size();
+    QCOMPARE(ProtoBuf::decodeSignedVarint(data.constData(), end, signedValue), 0);
+    QCOMPARE(ProtoBuf::decodeStandardVarint(data.constData(), end, signedValue), 0);
+    QCOMPARE(ProtoBuf::decodeUnsignedVarint(data.constData(), end, unsignedValue), 0);
+}
+
 void TestVarint::parseSignedInt_data()
 {
     QTest::addColumn<QByteArray>("data");
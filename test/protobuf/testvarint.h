@@ -23,6 +23,15 @@ class TestVarint : public QObject {
     Q_OBJECT
 
 private slots:
+    void decodeSignedInt_data();
+    void decodeSignedInt();
+    void decodeStandardInt_data();
+    void decodeStandardInt();
+    void decodeUnsignedInt_data();
+    void decodeUnsignedInt();
+    void decodeTruncated_data();
+    void decodeTruncated();
+
     void parseSignedInt_data();
     void parseSignedInt();
     void parseSignedInts_data();
@@ -17,10 +17,18 @@
     along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "polar/v2/benchtrainingsession.h"
+#include "polar/v2/testexercisedata.h"
+#include "polar/v2/testinflatedevice.h"
+#include "polar/v2/testsessionindex.h"
 #include "polar/v2/testtrainingsession.h"
+#include "polar/v2/testzonehistogram.h"
+#include "protobuf/benchprotobuf.h"
 #include "protobuf/testfixnum.h"
 #include "protobuf/testmessage.h"
 #include "protobuf/testvarint.h"
+#include "threads/testconversionmanifest.h"
+#include "threads/testsessionwatcher.h"
 
 #include <QTest>
 
@@ -55,22 +63,50 @@ int main(int argc, char *argv[]) {
 
     // Setup our tests factory object.
     ObjectFactory testFactory;
+    testFactory.registerClass<TestConversionManifest>();
+    testFactory.registerClass<TestExerciseData>();
     testFactory.registerClass<TestFixnum>();
+    testFactory.registerClass<TestInflateDevice>();
     testFactory.registerClass<TestMessage>();
+    testFactory.registerClass<TestSessionIndex>();
+    testFactory.registerClass<TestSessionWatcher>();
     testFactory.registerClass<TestTrainingSession>();
     testFactory.registerClass<TestVarint>();
+    testFactory.registerClass<TestZoneHistogram>();
 
-    // If the user has specified a Test* class name, execute that test class only.
+    // Benchmark classes are run only when requested, since they are slow.
+    ObjectFactory benchmarkFactory;
+    benchmarkFactory.registerClass<BenchProtobuf>();
+    benchmarkFactory.registerClass<BenchTrainingSession>();
+
+    // If the user has specified a Test* or Bench* class name, execute that class only.
     for (int index = 1; index < argc; ++index) {
         if (qstrcmp(argv[index], "-classes") == 0) {
             foreach (const QByteArray &className, testFactory.uniqueKeys()) {
                 fprintf(stdout, "%s\n", className.data());
             }
+            foreach (const QByteArray &className, benchmarkFactory.uniqueKeys()) {
+                fprintf(stdout, "%s\n", className.data());
+            }
             return EXIT_SUCCESS;
-        } else if (qstrncmp(argv[index], "Test", 4) == 0) {
+        } else if (qstrcmp(argv[index], "-benchmarks") == 0) {
+            QStringList args = app.arguments();
+            args.removeOne(QString::fromLocal8Bit(argv[index]));
+            int failedCount = 0;
+            foreach (const QByteArray &className, benchmarkFactory.uniqueKeys()) {
+                QObject * benchmarkObject = benchmarkFactory.createObject<QObject>(className);
+                if ((!benchmarkObject) || (QTest::qExec(benchmarkObject, args) != 0)) {
+                    ++failedCount;
+                }
+            }
+            return (failedCount == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+        } else if ((qstrncmp(argv[index], "Test", 4) == 0) ||
+                   (qstrncmp(argv[index], "Bench", 5) == 0)) {
             QStringList args = app.arguments();
             args.removeOne(QString::fromLocal8Bit(argv[index]));
-            QObject * testObject = testFactory.createObject<QObject>(argv[index]);
+            QObject * testObject = (argv[index][0] == 'T') ?
+                testFactory.createObject<QObject>(argv[index]) :
+                benchmarkFactory.createObject<QObject>(argv[index]);
             if (!testObject) {
                 fprintf(stderr, "test class %s is unknown\n", argv[index]);
                 return EXIT_FAILURE;
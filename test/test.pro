@@ -1,5 +1,5 @@
 TEMPLATE = app
-QT += testlib widgets xml xmlpatterns
+QT += concurrent testlib widgets xml xmlpatterns
 CONFIG += testcase
 SOURCES += test.cpp
 
@@ -48,11 +48,16 @@ unix {
                          --prefix `readlink -f ../src` --quiet \
                          --title PROJECT_NAME build/coverage.info
 
+    # Run the (otherwise skipped) benchmarks, writing XML results for tracking.
+    benchmark.depends = test
+    benchmark.commands = ./test BenchProtobuf -xml -o benchprotobuf.xml; \
+                         ./test BenchTrainingSession -xml -o benchtrainingsession.xml
+
     # Include the custom targets in the generated build scripts (eg Makefile).
-    QMAKE_EXTRA_TARGETS += coverage gcov lcov
+    QMAKE_EXTRA_TARGETS += benchmark coverage gcov lcov
 
     # Clean up files generated by the above custom targets.
-    QMAKE_CLEAN += build/*.gcda build/*.gcno build/coverage.info
+    QMAKE_CLEAN += build/*.gcda build/*.gcno build/coverage.info bench*.xml
     QMAKE_DISTCLEAN += -r coverage_html
 }
 
@@ -60,5 +65,7 @@ INCLUDEPATH += $$PWD
 INCLUDEPATH += ../src
 include(polar/v2/v2.pri)
 include(protobuf/protobuf.pri)
+include(threads/threads.pri)
 include(tools/tools.pri)
 include(../src/os/os.pri)
+include(../src/threads/threads.pri)
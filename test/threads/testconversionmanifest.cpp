@@ -0,0 +1,243 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testconversionmanifest.h"
+
+#include "../../src/threads/conversionmanifest.h"
+#include "../../src/threads/converterthread.h"
+#include "../tools/sessiongenerator.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+// Write (or overwrite) a file with the given content.
+static bool writeFile(const QString &fileName, const QByteArray &data)
+{
+    QFile file(fileName);
+    return ((file.open(QIODevice::WriteOnly|QIODevice::Truncate)) &&
+            (file.write(data) == data.size()));
+}
+
+/**
+ * @brief Verify that sessions converted before the manifest existed are
+ *        adopted, rather than reconverted, if all of their outputs exist.
+ */
+void TestConversionManifest::adoptExistingOutputs()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString baseName = dir.path() + QLatin1String("/v2-users-1-training-sessions-2");
+    tools::SessionGenerator generator;
+    generator.setDuration(60);
+    QVERIFY(!generator.write(baseName).isEmpty());
+
+    ConversionOptions options;
+    options.inputFolders = QStringList(dir.path());
+    options.outputFileNameFormat = QLatin1String("$baseName");
+    options.outputFormats = polar::v2::TrainingSession::GpxOutput;
+    options.threadCount = 1;
+    options.manifestFileName = dir.path() + QLatin1String("/conversions.json");
+
+    // All outputs exist, but the session is not in the manifest; adopt it.
+    const QString outputFileName = baseName + QLatin1String(".gpx");
+    QVERIFY(writeFile(outputFileName, QByteArray()));
+    {
+        ConverterThread converter(options);
+        converter.start();
+        QVERIFY(converter.wait(60000));
+        QCOMPARE(converter.sessions.processed.load(), 0);
+        QCOMPARE(converter.sessions.skipped.load(), 1);
+        QCOMPARE(QFileInfo(outputFileName).size(), Q_INT64_C(0));
+    }
+
+    ConversionManifest manifest(options.manifestFileName);
+    QVERIFY(manifest.load());
+    QVERIFY(manifest.contains(baseName));
+    QVERIFY(manifest.isUpToDate(baseName, ConversionManifest::fingerprintInputs(baseName),
+                                options.toJson()));
+    QVERIFY(manifest.naming(baseName, ConversionManifest::fingerprintInputs(baseName))
+            .contains(QLatin1String("start")));
+
+    // Once in the manifest, a missing output is reconverted.
+    QVERIFY(QFile::remove(outputFileName));
+    {
+        ConverterThread converter(options);
+        converter.start();
+        QVERIFY(converter.wait(60000));
+        QCOMPARE(converter.sessions.processed.load(), 1);
+        QCOMPARE(converter.sessions.skipped.load(), 0);
+        QVERIFY(QFileInfo(outputFileName).size() > 0);
+    }
+
+    // And now that all outputs exist again, nothing is converted.
+    {
+        ConverterThread converter(options);
+        converter.start();
+        QVERIFY(converter.wait(60000));
+        QCOMPARE(converter.sessions.processed.load(), 0);
+        QCOMPARE(converter.sessions.skipped.load(), 1);
+    }
+}
+
+void TestConversionManifest::isUpToDate_data()
+{
+    QTest::addColumn<QString>("change");
+    QTest::addColumn<bool>("expected");
+
+    QTest::newRow("unchanged")       << QString::fromLatin1("unchanged")       << true;
+    QTest::newRow("unknown")         << QString::fromLatin1("unknown")         << false;
+    QTest::newRow("input-added")     << QString::fromLatin1("input-added")     << false;
+    QTest::newRow("input-resized")   << QString::fromLatin1("input-resized")   << false;
+    QTest::newRow("input-modified")  << QString::fromLatin1("input-modified")  << false;
+    QTest::newRow("input-rewritten") << QString::fromLatin1("input-rewritten") << false;
+    QTest::newRow("option-changed")  << QString::fromLatin1("option-changed")  << false;
+    QTest::newRow("output-deleted")  << QString::fromLatin1("output-deleted")  << false;
+}
+
+void TestConversionManifest::isUpToDate()
+{
+    QFETCH(QString, change);
+    QFETCH(bool, expected);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString baseName = dir.path() + QLatin1String("/v2-users-1-training-sessions-2");
+    const QString createFileName = baseName + QLatin1String("-create");
+    QVERIFY(writeFile(createFileName, "create"));
+    QVERIFY(writeFile(baseName + QLatin1String("-exercises-3-samples"), "samples"));
+    const QString outputFileName = baseName + QLatin1String(".tcx");
+    QVERIFY(writeFile(outputFileName, "tcx"));
+
+    ConversionOptions options;
+    options.outputFormats = polar::v2::TrainingSession::TcxOutput;
+
+    ConversionManifest manifest(dir.path() + QLatin1String("/conversions.json"));
+    const QJsonObject inputs = ConversionManifest::fingerprintInputs(baseName);
+    QCOMPARE(inputs.size(), 2);
+    manifest.update(baseName, inputs, options.toJson(), QStringList(outputFileName));
+    QVERIFY(manifest.isUpToDate(baseName, inputs, options.toJson()));
+
+    if (change == QLatin1String("unknown")) {
+        baseName = dir.path() + QLatin1String("/v2-users-1-training-sessions-3");
+    } else if (change == QLatin1String("input-added")) {
+        QVERIFY(writeFile(baseName + QLatin1String("-exercises-3-route"), "route"));
+    } else if (change == QLatin1String("input-resized")) {
+        QVERIFY(writeFile(createFileName, "create, resized"));
+    } else if (change == QLatin1String("input-rewritten")) {
+        QVERIFY(writeFile(createFileName, "CREATE"));
+    } else if (change == QLatin1String("option-changed")) {
+        options.outputFileNameFormat = QLatin1String("$sessionId");
+    } else if (change == QLatin1String("output-deleted")) {
+        QVERIFY(QFile::remove(outputFileName));
+    }
+
+    QJsonObject currentInputs = ConversionManifest::fingerprintInputs(baseName);
+    if (change == QLatin1String("input-modified")) {
+        // Setting file times needs Qt 5.10, so fake a same-size rewrite a
+        // minute later in the fingerprint instead.
+        const QString key = QFileInfo(createFileName).fileName();
+        QJsonObject input = currentInputs.value(key).toObject();
+        input.insert(QLatin1String("modified"), QFileInfo(createFileName)
+            .lastModified().addSecs(60).toMSecsSinceEpoch());
+        currentInputs.insert(key, input);
+    } else if (change == QLatin1String("input-rewritten")) {
+        // Likewise, fake a same-size rewrite within the file system's timestamp
+        // resolution, by keeping the original fingerprint; only the content
+        // hash can tell the difference.
+        currentInputs = inputs;
+    }
+    QCOMPARE(manifest.isUpToDate(baseName, currentInputs, options.toJson()), expected);
+}
+
+void TestConversionManifest::loadSave()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString baseName = dir.path() + QLatin1String("/v2-users-1-training-sessions-2");
+    QVERIFY(writeFile(baseName + QLatin1String("-create"), "create"));
+    const QString outputFileName = baseName + QLatin1String(".gpx");
+    QVERIFY(writeFile(outputFileName, "gpx"));
+
+    const QJsonObject inputs = ConversionManifest::fingerprintInputs(baseName);
+    const QJsonObject options = ConversionOptions().toJson();
+
+    // Loading a manifest that does not exist yet succeeds, but is empty.
+    const QString fileName = dir.path() + QLatin1String("/sub/dir/conversions.json");
+    ConversionManifest manifest(fileName);
+    QVERIFY(manifest.load());
+    QVERIFY(!manifest.contains(baseName));
+
+    // Saving creates any missing parent directories.
+    manifest.update(baseName, inputs, options, QStringList(outputFileName));
+    QVERIFY(manifest.save());
+    QVERIFY(QFile::exists(fileName));
+
+    // Saving again replaces the manifest, leaving no temporary files behind.
+    QVERIFY(manifest.save());
+    QCOMPARE(QFileInfo(fileName).dir().entryList(QDir::Files),
+             QStringList(QLatin1String("conversions.json")));
+
+    ConversionManifest loaded(fileName);
+    QVERIFY(loaded.load());
+    QVERIFY(loaded.contains(baseName));
+    QVERIFY(loaded.isUpToDate(baseName, inputs, options));
+
+    // Loading replaces, rather than merges with, any in-memory sessions.
+    const QString otherBaseName = dir.path() + QLatin1String("/v2-users-1-training-sessions-3");
+    loaded.update(otherBaseName, inputs, options, QStringList(outputFileName));
+    QVERIFY(loaded.load());
+    QVERIFY(loaded.contains(baseName));
+    QVERIFY(!loaded.contains(otherBaseName));
+
+    // Unparseable manifests fail to load, leaving no sessions.
+    QVERIFY(writeFile(fileName, "{ not json"));
+    QVERIFY(!loaded.load());
+    QVERIFY(!loaded.contains(baseName));
+}
+
+void TestConversionManifest::naming()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString baseName = dir.path() + QLatin1String("/v2-users-1-training-sessions-2");
+    const QString createFileName = baseName + QLatin1String("-create");
+    QVERIFY(writeFile(createFileName, "create"));
+    QVERIFY(writeFile(baseName + QLatin1String("-exercises-3-samples"), "samples"));
+
+    QJsonObject naming;
+    naming.insert(QLatin1String("start"), 1405633736000.0);
+    naming.insert(QLatin1String("utcOffset"), 36000);
+    naming.insert(QLatin1String("sessionName"), QLatin1String("Running"));
+
+    ConversionManifest manifest(dir.path() + QLatin1String("/conversions.json"));
+    const QJsonObject inputs = ConversionManifest::fingerprintInputs(baseName);
+    QVERIFY(manifest.naming(baseName, inputs).isEmpty()); // Unknown session.
+    manifest.update(baseName, inputs, QJsonObject(), QStringList(), naming);
+    QCOMPARE(manifest.naming(baseName, inputs), naming);
+
+    // Naming details outlive changes to the session's other files.
+    QVERIFY(writeFile(baseName + QLatin1String("-exercises-3-samples"), "SAMPLES"));
+    QCOMPARE(manifest.naming(baseName, ConversionManifest::fingerprintInputs(baseName)), naming);
+
+    // But not changes to its create file.
+    QVERIFY(writeFile(createFileName, "CREATE"));
+    QVERIFY(manifest.naming(baseName, inputs).isEmpty());
+}
@@ -0,0 +1,224 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testsessionwatcher.h"
+
+#include "../../src/threads/conversionmanifest.h"
+#include "../../src/threads/converterthread.h"
+#include "../../src/threads/sessionwatcher.h"
+#include "../tools/sessiongenerator.h"
+
+#include <QFile>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+// Exposes SessionWatcher's protected state, so tests need not race its timers.
+class TestableSessionWatcher : public SessionWatcher {
+public:
+    TestableSessionWatcher(const ConversionOptions &options) : SessionWatcher(options) { }
+    using SessionWatcher::converter;
+    using SessionWatcher::debounceTimer;
+    using SessionWatcher::folderChanged;
+    using SessionWatcher::pendingSessions;
+};
+
+// Get options converting inputFolder to GPX files, and a manifest, in outputFolder.
+static ConversionOptions testOptions(const QString &inputFolder, const QString &outputFolder)
+{
+    ConversionOptions options;
+    options.inputFolders = QStringList(inputFolder);
+    options.outputFolder = outputFolder;
+    options.outputFileNameFormat = QLatin1String("$baseName");
+    options.outputFormats = polar::v2::TrainingSession::GpxOutput;
+    options.threadCount = 1;
+    options.manifestFileName = outputFolder + QLatin1String("/conversions.json");
+    return options;
+}
+
+// Check if a session's current input files have been converted.
+static bool isConverted(const ConversionOptions &options, const QString &baseName)
+{
+    ConversionManifest manifest(options.manifestFileName);
+    return ((manifest.load()) && (manifest.isUpToDate(baseName,
+        ConversionManifest::fingerprintInputs(baseName), options.toJson())));
+}
+
+// Write a short synthetic training session.
+static bool writeSession(const QString &baseName)
+{
+    tools::SessionGenerator generator;
+    generator.setDuration(60);
+    return !generator.write(baseName).isEmpty();
+}
+
+void TestSessionWatcher::initTestCase()
+{
+    qRegisterMetaType<const ConverterThread *>("const ConverterThread *");
+}
+
+/**
+ * @brief Verify that the converter converts just the sessions it is given,
+ *        without listing the input folders again.
+ */
+void TestSessionWatcher::convertIndexedSessions()
+{
+    QTemporaryDir inputDir, outputDir;
+    QVERIFY(inputDir.isValid());
+    QVERIFY(outputDir.isValid());
+    const ConversionOptions options = testOptions(inputDir.path(), outputDir.path());
+
+    const QString baseName1 = inputDir.path() + QLatin1String("/v2-users-1-training-sessions-2");
+    const QString baseName2 = inputDir.path() + QLatin1String("/v2-users-1-training-sessions-3");
+    QVERIFY(writeSession(baseName1));
+    QVERIFY(writeSession(baseName2));
+
+    polar::v2::SessionIndex index;
+    foreach (const QFileInfo &fileInfo, polar::v2::SessionIndex::listSession(baseName2).files) {
+        index.addFile(baseName2, fileInfo);
+    }
+
+    ConverterThread converter(options);
+    converter.setSessionIndex(index);
+    converter.start();
+    QVERIFY(converter.wait(60000));
+    QCOMPARE(converter.sessionBaseNames(), QStringList(baseName2));
+    QCOMPARE(converter.sessions.processed.load(), 1);
+    QVERIFY(!isConverted(options, baseName1));
+    QVERIFY(isConverted(options, baseName2));
+}
+
+/**
+ * @brief Verify that each new change restarts the debounce interval, so that
+ *        sessions written over time are converted together, just once.
+ */
+void TestSessionWatcher::debounceRestart()
+{
+    QTemporaryDir inputDir, outputDir;
+    QVERIFY(inputDir.isValid());
+    QVERIFY(outputDir.isValid());
+    const ConversionOptions options = testOptions(inputDir.path(), outputDir.path());
+
+    TestableSessionWatcher watcher(options);
+    watcher.setDebounceInterval(1000);
+    QSignalSpy spy(&watcher, SIGNAL(conversionFinished(const ConverterThread*)));
+    QVERIFY(watcher.start());
+    QVERIFY(!watcher.debounceTimer.isActive());
+
+    const QString baseName1 = inputDir.path() + QLatin1String("/v2-users-1-training-sessions-2");
+    QVERIFY(writeSession(baseName1));
+    watcher.folderChanged(inputDir.path());
+    QVERIFY(watcher.debounceTimer.isActive());
+
+    // An unchanged folder does not restart the interval.
+    QTest::qWait(500);
+    watcher.folderChanged(inputDir.path());
+    QVERIFY(watcher.debounceTimer.remainingTime() < 750);
+
+    // But a new session does.
+    const QString baseName2 = inputDir.path() + QLatin1String("/v2-users-1-training-sessions-3");
+    QVERIFY(writeSession(baseName2));
+    watcher.folderChanged(inputDir.path());
+    QVERIFY(watcher.debounceTimer.remainingTime() > 750);
+    QCOMPARE(spy.count(), 0);
+
+    QVERIFY(spy.wait(10000));
+    QCOMPARE(spy.count(), 1);
+    QVERIFY(isConverted(options, baseName1));
+    QVERIFY(isConverted(options, baseName2));
+    QVERIFY(watcher.pendingSessions.isEmpty());
+}
+
+/**
+ * @brief Verify that a session written to a watched folder is detected, and
+ *        converted once the folder is quiet.
+ */
+void TestSessionWatcher::newSession()
+{
+    QTemporaryDir inputDir, outputDir;
+    QVERIFY(inputDir.isValid());
+    QVERIFY(outputDir.isValid());
+    const ConversionOptions options = testOptions(inputDir.path(), outputDir.path());
+
+    SessionWatcher watcher(options);
+    watcher.setDebounceInterval(500);
+    QSignalSpy spy(&watcher, SIGNAL(conversionFinished(const ConverterThread*)));
+    QVERIFY(watcher.start());
+    QCOMPARE(spy.count(), 0); // Nothing to convert yet.
+
+    const QString baseName = inputDir.path() + QLatin1String("/v2-users-1-training-sessions-2");
+    QVERIFY(writeSession(baseName));
+    QVERIFY(spy.wait(10000));
+    QVERIFY(isConverted(options, baseName));
+    QVERIFY(QFile::exists(outputDir.path() + QLatin1String("/v2-users-1-training-sessions-2.gpx")));
+}
+
+/**
+ * @brief Verify that sessions changing while a conversion is running are
+ *        queued, and converted once that conversion finishes.
+ */
+void TestSessionWatcher::requeueWhileConverting()
+{
+    QTemporaryDir inputDir, outputDir;
+    QVERIFY(inputDir.isValid());
+    QVERIFY(outputDir.isValid());
+    const ConversionOptions options = testOptions(inputDir.path(), outputDir.path());
+
+    const QString baseName1 = inputDir.path() + QLatin1String("/v2-users-1-training-sessions-2");
+    QVERIFY(writeSession(baseName1));
+
+    // Sessions already present are converted immediately on start.
+    TestableSessionWatcher watcher(options);
+    watcher.setDebounceInterval(100);
+    QSignalSpy spy(&watcher, SIGNAL(conversionFinished(const ConverterThread*)));
+    QVERIFY(watcher.start());
+    QVERIFY(watcher.converter != NULL);
+
+    // The converter cannot finish (as far as the watcher knows) until the event
+    // loop runs, so these changes are guaranteed to arrive mid-conversion.
+    const QString baseName2 = inputDir.path() + QLatin1String("/v2-users-1-training-sessions-3");
+    QVERIFY(writeSession(baseName2));
+    QFile extraFile(baseName1 + QLatin1String("-exercises-1000001-sensors"));
+    QVERIFY(extraFile.open(QIODevice::WriteOnly));
+    extraFile.close();
+    watcher.folderChanged(inputDir.path());
+    QCOMPARE(watcher.pendingSessions.size(), 2);
+    QVERIFY(watcher.pendingSessions.contains(baseName1));
+    QVERIFY(watcher.pendingSessions.contains(baseName2));
+
+    // The files found are queued too, for the converter to use as is.
+    QCOMPARE(watcher.pendingSessions.value(baseName1).files.size(),
+             polar::v2::SessionIndex::listSession(baseName1).files.size());
+    QVERIFY(watcher.pendingSessions.value(baseName1).exercises
+            .value(QLatin1String("1000001")).contains(QLatin1String("sensors")));
+
+    // The running conversion is never joined by another, even if the debounce
+    // interval elapses first; the queued sessions wait for it to finish.
+    QVERIFY(spy.wait(10000));
+    QCOMPARE(spy.count(), 1);
+    QVERIFY(watcher.converter == NULL);
+    QVERIFY(watcher.debounceTimer.isActive());
+
+    // Then the queued sessions are converted in a second run.
+    QVERIFY(spy.wait(10000));
+    QCOMPARE(spy.count(), 2);
+    QVERIFY(watcher.pendingSessions.isEmpty());
+    QVERIFY(isConverted(options, baseName1));
+    QVERIFY(isConverted(options, baseName2));
+}
@@ -0,0 +1,3 @@
+VPATH += $$PWD
+HEADERS += testconversionmanifest.h   testsessionwatcher.h
+SOURCES += testconversionmanifest.cpp testsessionwatcher.cpp
@@ -0,0 +1,652 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sessiongenerator.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QVector>
+#include <QtCore/qmath.h>
+
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#include <QtZlib/zlib.h>
+#else
+#include <zlib.h>
+#endif
+
+namespace {
+
+// Minimal protobuf encoder, covering just the types Polar v2 files use.
+class Message {
+
+public:
+    Message &addVarint(const int tag, const quint64 value)
+    {
+        addKey(tag, 0);
+        appendVarint(value);
+        return *this;
+    }
+
+    Message &addInt32(const int tag, const qint32 value)
+    {
+        // Negative int32 values are sign-extended to 64 bits, as per protobuf.
+        return addVarint(tag, static_cast<quint64>(static_cast<qint64>(value)));
+    }
+
+    Message &addSint32(const int tag, const qint32 value)
+    {
+        return addVarint(tag, zigZag(value));
+    }
+
+    Message &addFloat(const int tag, const float value)
+    {
+        addKey(tag, 5);
+        appendFloat(value);
+        return *this;
+    }
+
+    Message &addDouble(const int tag, const double value)
+    {
+        addKey(tag, 1);
+        appendDouble(value);
+        return *this;
+    }
+
+    Message &addString(const int tag, const QString &value)
+    {
+        return addBytes(tag, value.toUtf8());
+    }
+
+    Message &addMessage(const int tag, const Message &value)
+    {
+        return addBytes(tag, value.data);
+    }
+
+    Message &addPacked(const int tag, const QVector<quint32> &values)
+    {
+        Message packed;
+        foreach (const quint32 value, values) {
+            packed.appendVarint(value);
+        }
+        return addBytes(tag, packed.data);
+    }
+
+    Message &addPacked(const int tag, const QVector<qint32> &values)
+    {
+        Message packed;
+        foreach (const qint32 value, values) {
+            packed.appendVarint(zigZag(value));
+        }
+        return addBytes(tag, packed.data);
+    }
+
+    Message &addPacked(const int tag, const QVector<float> &values)
+    {
+        Message packed;
+        foreach (const float value, values) {
+            packed.appendFloat(value);
+        }
+        return addBytes(tag, packed.data);
+    }
+
+    Message &addPacked(const int tag, const QVector<double> &values)
+    {
+        Message packed;
+        foreach (const double value, values) {
+            packed.appendDouble(value);
+        }
+        return addBytes(tag, packed.data);
+    }
+
+    QByteArray toByteArray() const
+    {
+        return data;
+    }
+
+protected:
+    QByteArray data;
+
+    static quint64 zigZag(const qint32 value)
+    {
+        return (static_cast<quint32>(value) << 1) ^ static_cast<quint32>(value >> 31);
+    }
+
+    Message &addBytes(const int tag, const QByteArray &value)
+    {
+        addKey(tag, 2);
+        appendVarint(value.size());
+        data.append(value);
+        return *this;
+    }
+
+    void addKey(const int tag, const int wireType)
+    {
+        appendVarint((static_cast<quint64>(tag) << 3) | wireType);
+    }
+
+    void appendFixed(quint64 value, const int size)
+    {
+        for (int index = 0; index < size; ++index, value >>= 8) {
+            data.append(static_cast<char>(value & 0xFF));
+        }
+    }
+
+    void appendDouble(const double value)
+    {
+        quint64 bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        appendFixed(bits, sizeof(bits));
+    }
+
+    void appendFloat(const float value)
+    {
+        quint32 bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        appendFixed(bits, sizeof(bits));
+    }
+
+    void appendVarint(quint64 value)
+    {
+        while (value >= 0x80) {
+            data.append(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        data.append(static_cast<char>(value));
+    }
+
+};
+
+Message dateMessage(const QDate &date)
+{
+    return Message()
+        .addVarint(1, date.year())
+        .addVarint(2, date.month())
+        .addVarint(3, date.day());
+}
+
+Message durationMessage(const qint64 msecs)
+{
+    return Message()
+        .addVarint(1, msecs / 3600000)
+        .addVarint(2, (msecs / 60000) % 60)
+        .addVarint(3, (msecs / 1000) % 60)
+        .addVarint(4, msecs % 1000);
+}
+
+Message timeMessage(const QTime &time)
+{
+    return Message()
+        .addVarint(1, time.hour())
+        .addVarint(2, time.minute())
+        .addVarint(3, time.second())
+        .addVarint(4, time.msec());
+}
+
+Message startMessage(const QDateTime &dateTime, const int utcOffset)
+{
+    return Message()
+        .addMessage(1, dateMessage(dateTime.date()))
+        .addMessage(2, timeMessage(dateTime.time()))
+        .addInt32(4, utcOffset);
+}
+
+// Compress data in gzip format, as FlowSync does for large files.
+QByteArray gzip(const QByteArray &data)
+{
+    z_stream stream = z_stream();
+    int result = deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                              15 + 16, 8, Z_DEFAULT_STRATEGY);
+    if (result != Z_OK) {
+        qWarning() << "deflateInit2 returned" << result << stream.msg;
+        return QByteArray();
+    }
+
+    QByteArray compressed(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    stream.avail_in = data.size();
+    stream.next_out = reinterpret_cast<Bytef *>(compressed.data());
+    stream.avail_out = compressed.size();
+    result = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    if (result != Z_STREAM_END) {
+        qWarning() << "deflate returned" << result << stream.msg;
+        return QByteArray();
+    }
+    compressed.resize(stream.total_out);
+    return compressed;
+}
+
+const quint32 maximumHeartRate = 190;
+const quint64 sportRunning = 1;
+
+}
+
+namespace tools {
+
+SessionGenerator::SessionGenerator()
+    : duration(3600), exerciseCount(1), gzipped(false), lapCount(1),
+      offlineCount(0), offlineLength(0), route(true), rrSamples(true),
+      sampleInterval(1000), startTime(QDate(2014, 10, 1), QTime(16, 0)),
+      utcOffset(600)
+{
+
+}
+
+/**
+ * @brief Set the duration of each generated exercise.
+ */
+void SessionGenerator::setDuration(const int seconds)
+{
+    duration = seconds;
+}
+
+void SessionGenerator::setExerciseCount(const int count)
+{
+    exerciseCount = count;
+}
+
+/**
+ * @brief Set whether to gzip the generated files, as FlowSync does.
+ */
+void SessionGenerator::setGzipped(const bool gzipped)
+{
+    this->gzipped = gzipped;
+}
+
+/**
+ * @brief Set the number of (equal length) manual laps in each exercise.
+ */
+void SessionGenerator::setLapCount(const int count)
+{
+    lapCount = count;
+}
+
+/**
+ * @brief Set the number of evenly spaced sensor dropouts in each exercise.
+ *
+ * @param count  Number of offline ranges.
+ * @param length Number of samples in each offline range.
+ */
+void SessionGenerator::setOfflineRanges(const int count, const int length)
+{
+    offlineCount = count;
+    offlineLength = length;
+}
+
+/**
+ * @brief Set whether to generate a 1 Hz GPS route for each exercise.
+ */
+void SessionGenerator::setRoute(const bool enabled)
+{
+    route = enabled;
+}
+
+/**
+ * @brief Set whether to generate R-R interval samples for each exercise.
+ */
+void SessionGenerator::setRrSamples(const bool enabled)
+{
+    rrSamples = enabled;
+}
+
+void SessionGenerator::setSampleInterval(const int msec)
+{
+    sampleInterval = msec;
+}
+
+/**
+ * @brief Set the session's start time.
+ *
+ * @param startTime Local start time, as recorded by the training computer.
+ * @param utcOffset Offset of @a startTime from UTC, in minutes.
+ */
+void SessionGenerator::setStartTime(const QDateTime &startTime, const int utcOffset)
+{
+    this->startTime = startTime;
+    this->utcOffset = utcOffset;
+}
+
+/**
+ * @brief Write a complete training session.
+ *
+ * Exercises follow each other back to back, each of the configured duration.
+ *
+ * @param baseName Base name of the session, such as
+ *                 "folder/v2-users-0000000-training-sessions-1234567".
+ *
+ * @return The names of all files written, or an empty list on failure.
+ */
+QStringList SessionGenerator::write(const QString &baseName) const
+{
+    if ((duration <= 0) || (exerciseCount <= 0) || (sampleInterval <= 0)) {
+        qWarning() << "Invalid session parameters" << duration << exerciseCount << sampleInterval;
+        return QStringList();
+    }
+    const int sampleCount = static_cast<int>(qint64(duration) * 1000 / sampleInterval);
+    if (sampleCount <= 0) {
+        qWarning() << "Session too short for sample interval" << duration << sampleInterval;
+        return QStringList();
+    }
+    const int manualLapCount = qBound(1, lapCount, sampleCount);
+    const qint64 exerciseMsecs = qint64(sampleCount) * sampleInterval;
+
+    QStringList fileNames;
+    #define WRITE_FILE(fileName, message) { \
+        if (!writeFile(fileName, message.toByteArray())) return QStringList(); \
+        fileNames.append(fileName); \
+    }
+
+    double sessionDistance = 0.0;
+    quint32 sessionMaxHeartRate = 0;
+    qint64 sessionHeartRateTotal = 0;
+    for (int exercise = 0; exercise < exerciseCount; ++exercise) {
+        const QString exerciseName = exerciseBaseName(baseName, exercise);
+        const QDateTime exerciseStart = startTime.addMSecs(exercise * exerciseMsecs);
+
+        // Generate smooth, but not entirely regular, sensor data.
+        QVector<quint32> heartRate(sampleCount), cadence(sampleCount);
+        QVector<float> altitude(sampleCount), distance(sampleCount),
+                       speed(sampleCount), temperature(sampleCount);
+        double totalDistance = 0.0;
+        for (int index = 0; index < sampleCount; ++index) {
+            const double seconds = index * sampleInterval / 1000.0;
+            heartRate[index] = qRound(130.0 + 30.0 * qSin(2.0 * M_PI * seconds / 1200.0)
+                                            + 10.0 * qSin(2.0 * M_PI * seconds / 97.0));
+            cadence[index] = 80 + (index % 7);
+            speed[index] = 10.0 + 2.0 * qSin(2.0 * M_PI * seconds / 900.0); // km/h.
+            totalDistance += speed[index] / 3.6 * sampleInterval / 1000.0;
+            distance[index] = totalDistance;
+            altitude[index] = 100.0 + 50.0 * qSin(2.0 * M_PI * seconds / 3600.0);
+            temperature[index] = 20.0 + qSin(2.0 * M_PI * seconds / 7200.0);
+        }
+
+        // Exercise samples, with any offline ranges.
+        Message samples;
+        samples.addMessage(1, durationMessage(sampleInterval))
+               .addPacked(2, heartRate)
+               .addPacked(4, cadence)
+               .addPacked(6, altitude)
+               .addPacked(8, temperature)
+               .addPacked(9, speed)
+               .addPacked(11, distance);
+        for (int range = 0; (range < offlineCount) && (offlineLength > 0); ++range) {
+            const int start = qint64(range + 1) * sampleCount / (offlineCount + 1);
+            const Message offline = Message()
+                .addVarint(1, start)
+                .addVarint(2, qMin(start + offlineLength, sampleCount) - 1);
+            const int offlineTags[] = { 3, 5, 10, 12, 18, 19 };
+            for (size_t tag = 0; tag < sizeof(offlineTags)/sizeof(offlineTags[0]); ++tag) {
+                samples.addMessage(offlineTags[tag], offline);
+            }
+        }
+        WRITE_FILE(exerciseName + QLatin1String("-samples"), samples);
+
+        // A 1 Hz GPS route, heading north-east from Sydney at the sampled speeds.
+        if (route) {
+            const int pointCount = static_cast<int>(exerciseMsecs / 1000);
+            QVector<quint32> offsets(pointCount), satellites(pointCount);
+            QVector<double> latitudes(pointCount), longitudes(pointCount);
+            QVector<qint32> altitudes(pointCount);
+            for (int index = 0; index < pointCount; ++index) {
+                const int sample = qMin(index * 1000 / sampleInterval, sampleCount - 1);
+                const double metres = distance.at(sample) * M_SQRT1_2;
+                offsets[index] = index * 1000;
+                latitudes[index] = -33.8688 + metres / 111320.0;
+                longitudes[index] = 151.2093 + metres / 92390.0;
+                altitudes[index] = qRound(altitude.at(sample));
+                satellites[index] = 8 + (index / 600) % 4;
+            }
+            const QDateTime utcStart = exerciseStart.addSecs(-utcOffset * 60);
+            Message routeMessage;
+            routeMessage.addPacked(1, offsets)
+                        .addPacked(2, latitudes)
+                        .addPacked(3, longitudes)
+                        .addPacked(4, altitudes)
+                        .addPacked(5, satellites)
+                        .addMessage(9, Message()
+                            .addMessage(1, dateMessage(utcStart.date()))
+                            .addMessage(2, timeMessage(utcStart.time())));
+            WRITE_FILE(exerciseName + QLatin1String("-route"), routeMessage);
+        }
+
+        // R-R intervals, one per beat, at the sampled heart rates.
+        if (rrSamples) {
+            QVector<quint32> intervals;
+            for (qint64 msecs = 0; msecs < exerciseMsecs; ) {
+                const int sample = static_cast<int>(msecs / sampleInterval);
+                const quint32 interval = 60000 / qMax(heartRate.at(sample), 30U);
+                intervals.append(interval);
+                msecs += interval;
+            }
+            WRITE_FILE(exerciseName + QLatin1String("-rrsamples"),
+                       Message().addPacked(1, intervals));
+        }
+
+        // Manual laps of equal duration, and autolaps every kilometre.
+        for (int lapFile = 0; lapFile < 2; ++lapFile) {
+            QList<int> lapEnds; // Exclusive sample indexes.
+            if (lapFile == 0) {
+                for (int lap = 1; lap <= manualLapCount; ++lap) {
+                    lapEnds.append(qint64(lap) * sampleCount / manualLapCount);
+                }
+            } else {
+                for (int index = 1, km = 1; index < sampleCount; ++index) {
+                    if (distance.at(index) >= km * 1000.0) {
+                        lapEnds.append(index);
+                        ++km;
+                    }
+                }
+                if (lapEnds.isEmpty() || (lapEnds.last() < sampleCount)) {
+                    lapEnds.append(sampleCount);
+                }
+            }
+
+            Message laps;
+            qint64 shortestLap = exerciseMsecs, lapsTotal = 0;
+            for (int lap = 0, lapStart = 0; lap < lapEnds.size(); lapStart = lapEnds.at(lap++)) {
+                const int lapEnd = lapEnds.at(lap);
+                quint32 minHeartRate = heartRate.at(lapStart), maxHeartRate = 0, maxCadence = 0;
+                qint64 heartRateTotal = 0, cadenceTotal = 0;
+                float maxSpeed = 0.0;
+                for (int index = lapStart; index < lapEnd; ++index) {
+                    minHeartRate = qMin(minHeartRate, heartRate.at(index));
+                    maxHeartRate = qMax(maxHeartRate, heartRate.at(index));
+                    heartRateTotal += heartRate.at(index);
+                    maxCadence = qMax(maxCadence, cadence.at(index));
+                    cadenceTotal += cadence.at(index);
+                    maxSpeed = qMax(maxSpeed, speed.at(index));
+                }
+                const int count = qMax(lapEnd - lapStart, 1);
+                const qint64 lapMsecs = qint64(lapEnd - lapStart) * sampleInterval;
+                const float lapDistance = distance.at(lapEnd - 1) -
+                    ((lapStart > 0) ? distance.at(lapStart - 1) : 0.0f);
+                shortestLap = qMin(shortestLap, lapMsecs);
+                lapsTotal += lapMsecs;
+                laps.addMessage(1, Message()
+                    .addMessage(1, Message()
+                        .addMessage(1, durationMessage(qint64(lapEnd) * sampleInterval))
+                        .addMessage(2, durationMessage(lapMsecs))
+                        .addFloat(3, lapDistance)
+                        .addFloat(4, 0.0f)
+                        .addFloat(5, 0.0f)
+                        .addVarint(6, (lapFile == 0) ? 2 : 1))
+                    .addMessage(2, Message()
+                        .addMessage(1, Message()
+                            .addVarint(1, heartRateTotal / count)
+                            .addVarint(2, maxHeartRate)
+                            .addVarint(3, minHeartRate))
+                        .addMessage(2, Message()
+                            .addFloat(1, lapDistance * 3.6f / (lapMsecs / 1000.0f))
+                            .addFloat(2, maxSpeed))
+                        .addMessage(3, Message()
+                            .addVarint(1, cadenceTotal / count)
+                            .addVarint(2, maxCadence))));
+            }
+            laps.addMessage(2, Message()
+                .addMessage(1, durationMessage(shortestLap))
+                .addMessage(2, durationMessage(lapsTotal / lapEnds.size())));
+            WRITE_FILE(exerciseName + QLatin1String((lapFile == 0) ? "-laps" : "-autolaps"), laps);
+        }
+
+        // Exercise statistics, and time spent in heart rate and speed zones.
+        quint32 minHeartRate = heartRate.first(), maxHeartRate = 0, maxCadence = 0;
+        qint64 heartRateTotal = 0, cadenceTotal = 0;
+        float minAltitude = altitude.first(), maxAltitude = altitude.first(), maxSpeed = 0.0;
+        double altitudeTotal = 0.0;
+        float minTemperature = temperature.first(), maxTemperature = temperature.first();
+        double temperatureTotal = 0.0;
+        QVector<qint64> heartRateZones(5), speedZones(5);
+        QVector<float> speedZoneDistances(5);
+        for (int index = 0; index < sampleCount; ++index) {
+            minHeartRate = qMin(minHeartRate, heartRate.at(index));
+            maxHeartRate = qMax(maxHeartRate, heartRate.at(index));
+            heartRateTotal += heartRate.at(index);
+            maxCadence = qMax(maxCadence, cadence.at(index));
+            cadenceTotal += cadence.at(index);
+            minAltitude = qMin(minAltitude, altitude.at(index));
+            maxAltitude = qMax(maxAltitude, altitude.at(index));
+            altitudeTotal += altitude.at(index);
+            maxSpeed = qMax(maxSpeed, speed.at(index));
+            minTemperature = qMin(minTemperature, temperature.at(index));
+            maxTemperature = qMax(maxTemperature, temperature.at(index));
+            temperatureTotal += temperature.at(index);
+
+            const int heartRateZone = (heartRate.at(index) * 10 / maximumHeartRate) - 5;
+            if ((heartRateZone >= 0) && (heartRateZone < heartRateZones.size())) {
+                heartRateZones[heartRateZone] += sampleInterval;
+            }
+            const int speedZone = qBound(0, static_cast<int>(speed.at(index)) - 8, 4);
+            speedZones[speedZone] += sampleInterval;
+            speedZoneDistances[speedZone] += speed.at(index) / 3.6f * sampleInterval / 1000.0f;
+        }
+        WRITE_FILE(exerciseName + QLatin1String("-statistics"), Message()
+            .addMessage(1, Message()
+                .addVarint(1, minHeartRate)
+                .addVarint(2, heartRateTotal / sampleCount)
+                .addVarint(3, maxHeartRate))
+            .addMessage(2, Message()
+                .addFloat(1, totalDistance * 3.6 / (exerciseMsecs / 1000.0))
+                .addFloat(2, maxSpeed))
+            .addMessage(3, Message()
+                .addVarint(1, cadenceTotal / sampleCount)
+                .addVarint(2, maxCadence))
+            .addMessage(4, Message()
+                .addFloat(1, minAltitude)
+                .addFloat(2, altitudeTotal / sampleCount)
+                .addFloat(3, maxAltitude))
+            .addMessage(7, Message()
+                .addFloat(1, minTemperature)
+                .addFloat(2, temperatureTotal / sampleCount)
+                .addFloat(3, maxTemperature)));
+
+        Message zones;
+        for (int zone = 0; zone < heartRateZones.size(); ++zone) {
+            zones.addMessage(1, Message()
+                .addMessage(1, Message()
+                    .addVarint(1, maximumHeartRate * (zone + 5) / 10)
+                    .addVarint(2, maximumHeartRate * (zone + 6) / 10))
+                .addMessage(2, durationMessage(heartRateZones.at(zone))));
+        }
+        for (int zone = 0; zone < speedZones.size(); ++zone) {
+            zones.addMessage(4, Message()
+                .addMessage(1, Message()
+                    .addFloat(1, zone + 8.0f)
+                    .addFloat(2, zone + 9.0f))
+                .addMessage(2, durationMessage(speedZones.at(zone)))
+                .addFloat(3, speedZoneDistances.at(zone)));
+        }
+        WRITE_FILE(exerciseName + QLatin1String("-zones"), zones);
+
+        const float ascent = qMax(maxAltitude - minAltitude, 0.0f);
+        WRITE_FILE(exerciseName + QLatin1String("-create"), Message()
+            .addMessage(1, startMessage(exerciseStart, utcOffset))
+            .addMessage(2, durationMessage(exerciseMsecs))
+            .addMessage(3, Message().addVarint(1, sportRunning))
+            .addFloat(4, totalDistance)
+            .addVarint(5, exerciseMsecs / 60000 * 10)
+            .addFloat(10, ascent)
+            .addFloat(11, ascent));
+
+        sessionDistance += totalDistance;
+        sessionMaxHeartRate = qMax(sessionMaxHeartRate, maxHeartRate);
+        sessionHeartRateTotal += heartRateTotal / sampleCount;
+    }
+
+    // Session-level files, written last so the session is complete once found.
+    WRITE_FILE(baseName + QLatin1String("-physical-information"), Message()
+        .addMessage(1, Message().addMessage(1, dateMessage(QDate(1980, 1, 1))))
+        .addMessage(2, Message().addVarint(1, 1))
+        .addMessage(3, Message().addFloat(1, 70.0f))
+        .addMessage(4, Message().addFloat(1, 175.0f))
+        .addMessage(5, Message().addVarint(1, maximumHeartRate))
+        .addMessage(6, Message().addVarint(1, 50))
+        .addMessage(8, Message().addVarint(1, 140))
+        .addMessage(9, Message().addVarint(1, 170))
+        .addMessage(10, Message().addVarint(1, 50)));
+
+    WRITE_FILE(baseName + QLatin1String("-create"), Message()
+        .addMessage(1, startMessage(startTime, utcOffset))
+        .addVarint(2, exerciseCount)
+        .addString(3, QLatin1String("00000000"))
+        .addString(4, QLatin1String("Polar V800"))
+        .addMessage(5, durationMessage(exerciseCount * exerciseMsecs))
+        .addFloat(6, sessionDistance)
+        .addVarint(7, exerciseCount * exerciseMsecs / 60000 * 10)
+        .addMessage(8, Message()
+            .addVarint(1, sessionHeartRateTotal / exerciseCount)
+            .addVarint(2, sessionMaxHeartRate))
+        .addMessage(11, Message().addString(1, QLatin1String("Synthetic")))
+        .addMessage(18, Message().addVarint(1, sportRunning)));
+
+    #undef WRITE_FILE
+    return fileNames;
+}
+
+/**
+ * @brief Get the base name of a generated exercise.
+ *
+ * Exercise IDs are fixed-width, so they sort in the order generated.
+ */
+QString SessionGenerator::exerciseBaseName(const QString &baseName, const int index)
+{
+    return QString::fromLatin1("%1-exercises-%2").arg(baseName).arg(1000001 + index);
+}
+
+bool SessionGenerator::writeFile(const QString &fileName, const QByteArray &data) const
+{
+    const QByteArray contents = gzipped ? gzip(data) : data;
+    if (contents.isEmpty() && !data.isEmpty()) {
+        return false;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+        qWarning() << "Failed to open" << fileName << file.errorString();
+        return false;
+    }
+    if (file.write(contents) != contents.size()) {
+        qWarning() << "Failed to write" << fileName << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+}
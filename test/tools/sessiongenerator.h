@@ -0,0 +1,75 @@
+/*
+    Copyright 2014 Paul Colby
+
+    This file is part of Bipolar.
+
+    Bipolar is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Biplar is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bipolar.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __TOOLS_SESSION_GENERATOR_H__
+#define __TOOLS_SESSION_GENERATOR_H__
+
+#include <QDateTime>
+#include <QStringList>
+
+namespace tools {
+
+/**
+ * @brief Writes synthetic, but valid, Polar v2 training session files.
+ *
+ * Generated sessions have smoothly varying heart rate, cadence, speed,
+ * altitude and temperature samples, a 1 Hz GPS route, R-R intervals, manual
+ * and automatic laps, statistics and zones, so that sessions of any size
+ * (such as ultra-distance events and 24-hour recordings) can be converted
+ * without needing real captures of that size.
+ */
+class SessionGenerator {
+
+public:
+    SessionGenerator();
+
+    void setDuration(const int seconds);
+    void setExerciseCount(const int count);
+    void setGzipped(const bool gzipped);
+    void setLapCount(const int count);
+    void setOfflineRanges(const int count, const int length);
+    void setRoute(const bool enabled);
+    void setRrSamples(const bool enabled);
+    void setSampleInterval(const int msec);
+    void setStartTime(const QDateTime &startTime, const int utcOffset);
+
+    QStringList write(const QString &baseName) const;
+
+    static QString exerciseBaseName(const QString &baseName, const int index);
+
+protected:
+    int duration;
+    int exerciseCount;
+    bool gzipped;
+    int lapCount;
+    int offlineCount;
+    int offlineLength;
+    bool route;
+    bool rrSamples;
+    int sampleInterval;
+    QDateTime startTime;
+    int utcOffset;
+
+    bool writeFile(const QString &fileName, const QByteArray &data) const;
+
+};
+
+}
+
+#endif // __TOOLS_SESSION_GENERATOR_H__
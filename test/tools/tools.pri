@@ -1,3 +1,3 @@
 VPATH += $$PWD
-HEADERS += variant.h
-SOURCES += variant.cpp
+HEADERS += sessiongenerator.h   variant.h
+SOURCES += sessiongenerator.cpp variant.cpp